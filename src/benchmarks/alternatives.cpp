@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "synthetic.h"
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+// layout of the alternatives before they were kept inline: a vector of origin, archive name and
+// archive order per file
+typedef std::vector<std::pair<int, std::pair<std::wstring, int>>> VectorAlternatives;
+
+static const FILETIME FILE_TIME = { 0x12345678, 0x01d00000 };
+
+// number of neighbouring mods a shared file is spread over. Most conflicts are between a mod and
+// one or two patches, a few files (body textures, common meshes) are replaced by many mods
+static const int GROUP_SIZES[] = { 2, 2, 2, 3, 3, 4, 6, 12 };
+static const int NUM_GROUP_SIZES = 8;
+
+static unsigned int mix(unsigned int a, unsigned int b, unsigned int c)
+{
+  unsigned int hash = a * 0x9e3779b1U ^ b * 0x85ebca77U ^ c * 0xc2b2ae3dU;
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6dU;
+  hash ^= hash >> 12;
+  return hash;
+}
+
+// unlike the shared files of SyntheticSetup, which every mod may provide, a shared file here is
+// only provided by mods of the same group so the number of alternatives per file is realistic
+static OriginScan scanGroupedMod(const SyntheticSetup &setup, int mod)
+{
+  std::vector<OriginScan::Entry> entries;
+  entries.push_back({ OriginScan::ENTRY_DIRECTORY, L"textures", FILE_TIME });
+  for (int directory = 0; directory < setup.directoriesPerMod; ++directory) {
+    std::wostringstream directoryName;
+    directoryName << L"group" << directory;
+    entries.push_back({ OriginScan::ENTRY_DIRECTORY, directoryName.str(), FILE_TIME });
+    for (int file = 0; file < setup.filesPerDirectory; ++file) {
+      std::wostringstream name;
+      if (static_cast<int>(mix(mod, directory, file) % 100) < setup.overlap) {
+        int groupSize = GROUP_SIZES[mix(directory, file, 0) % NUM_GROUP_SIZES];
+        name << L"Shared" << groupSize << L"_" << (mod / groupSize) << L"_" << file << L".dds";
+      } else {
+        name << L"Mod" << mod << L"_" << file << L".dds";
+      }
+      entries.push_back({ OriginScan::ENTRY_FILE, name.str(), FILE_TIME });
+    }
+    entries.push_back({ OriginScan::ENTRY_END_DIRECTORY, std::wstring(), FILE_TIME });
+  }
+  entries.push_back({ OriginScan::ENTRY_END_DIRECTORY, std::wstring(), FILE_TIME });
+
+  OriginScan result;
+  result.restore(false, FILE_TIME, 0, std::move(entries));
+  return result;
+}
+
+
+MO_BENCHMARK(file_alternatives)
+{
+  // a large texture heavy setup, half of the files are replaced by other mods
+  SyntheticSetup setup(scaled(1000), 20, 100, 50);
+  std::unique_ptr<DirectoryEntry> structure(new DirectoryEntry(L"data", nullptr, 0));
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    structure->addFromOrigin(modName(mod), L"C:\\mods\\" + modName(mod), mod + 1, scanGroupedMod(setup, mod));
+  }
+
+  std::vector<Span<FileEntry::AlternativeInfo>> alternatives;
+  size_t conflicted = 0;
+  size_t severalAlternatives = 0;
+  structure->forEachFileRecursive([&] (const FileEntry &file) {
+    FileEntry::Alternatives list = file.getAlternatives();
+    alternatives.push_back(list);
+    if (list.size() > 0) {
+      ++conflicted;
+    }
+    if (list.size() > 1) {
+      ++severalAlternatives;
+    }
+    return true;
+  });
+
+  std::string prefix = "  " + std::to_string(alternatives.size()) + " files, "
+                     + std::to_string(conflicted) + " with alternatives, "
+                     + std::to_string(severalAlternatives) + " with several, ";
+
+  // both containers are filled from the same lists, the outer vector accounts for the part of
+  // the container that is embedded in each FileEntry
+  size_t allocatedBefore = allocatedBytes();
+  {
+    std::vector<FileEntry::AlternativeList> inlineLists(alternatives.size());
+    for (size_t i = 0; i < alternatives.size(); ++i) {
+      for (const FileEntry::AlternativeInfo &alternative : alternatives[i]) {
+        inlineLists[i].push_back(alternative);
+      }
+    }
+    size_t allocated = allocatedBytes() - allocatedBefore;
+    report(prefix + "inline", static_cast<double>(allocated) / alternatives.size(), "bytes/file");
+  }
+
+  allocatedBefore = allocatedBytes();
+  {
+    std::vector<VectorAlternatives> vectorLists(alternatives.size());
+    for (size_t i = 0; i < alternatives.size(); ++i) {
+      for (const FileEntry::AlternativeInfo &alternative : alternatives[i]) {
+        std::wstring archive = structure->getStringPool().get(alternative.second.first);
+        vectorLists[i].push_back(std::make_pair(alternative.first,
+                                                std::make_pair(archive, alternative.second.second)));
+      }
+    }
+    size_t allocated = allocatedBytes() - allocatedBefore;
+    report(prefix + "vector", static_cast<double>(allocated) / alternatives.size(), "bytes/file");
+  }
+}
@@ -0,0 +1,37 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include <QCoreApplication>
+
+
+namespace MOBenchmark {
+
+
+void createApplication()
+{
+  if (QCoreApplication::instance() == nullptr) {
+    static int argc = 1;
+    static char name[] = "benchmarks";
+    static char *argv[] = { name, nullptr };
+    new QCoreApplication(argc, argv);
+  }
+}
+
+
+} // namespace MOBenchmark
@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "synthetic.h"
+#include "modinfo.h"
+#include <utility.h>
+#include <QDir>
+#include <sstream>
+
+
+using namespace MOBase;
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int REPEAT = 3;
+
+
+// how ModInfoRegular::archives() listed the mod directory on every call before the list was cached
+static QStringList listArchives(const QString &path)
+{
+  QStringList result;
+  QDir dir(path);
+  for (const QString &archive : dir.entryList(QStringList({ "*.bsa", "*.ba2" }))) {
+    result.append(path + "/" + archive);
+  }
+  return result;
+}
+
+static size_t countArchives(const std::vector<ModInfo::Ptr> &mods)
+{
+  size_t result = 0;
+  for (const ModInfo::Ptr &mod : mods) {
+    result += mod->archives().size();
+  }
+  return result;
+}
+
+
+MO_BENCHMARK(archive_listing)
+{
+  // the nexus interface the mods create reads the version of the running executable
+  createApplication();
+
+  // DirectoryRefresher::setMods asks every active mod for its archives before each refresh
+  SyntheticSetup setup(scaled(2000), 4, 5, 30, 10);
+  std::vector<std::wstring> modDirectories = writeSetup(setup, tempDirectory());
+  QStringList directories;
+  for (const std::wstring &directory : modDirectories) {
+    directories.append(QDir::fromNativeSeparators(ToQString(directory)));
+  }
+
+  std::ostringstream prefix;
+  prefix << "  " << setup.mods << " mods with archives, ";
+
+  size_t listed = 0;
+  report(prefix.str() + "list every mod", fastestOf(REPEAT, [&] () {
+    listed = 0;
+    for (const QString &directory : directories) {
+      listed += listArchives(directory).size();
+    }
+  }), "ms");
+
+  // the first call lists the directory, later ones only check its modification time. A refresh
+  // records the archives it found in the scan, so setMods usually gets the cached list
+  double first = 0.0;
+  for (int i = 0; i < REPEAT; ++i) {
+    MOShared::DirectoryEntry *structure = nullptr;
+    std::vector<ModInfo::Ptr> mods = ModInfo::createFromDirectories(nullptr, "Skyrim", directories, &structure);
+    Timer timer;
+    size_t archives = countArchives(mods);
+    double elapsed = timer.elapsedMs();
+    first = (i == 0) ? elapsed : std::min(first, elapsed);
+    if (archives != listed) {
+      fail("found " + std::to_string(archives) + " archives, the listing has " + std::to_string(listed));
+    }
+  }
+  report(prefix.str() + "archives(), first call", first, "ms");
+
+  MOShared::DirectoryEntry *structure = nullptr;
+  std::vector<ModInfo::Ptr> mods = ModInfo::createFromDirectories(nullptr, "Skyrim", directories, &structure);
+  countArchives(mods);
+  report(prefix.str() + "archives(), cached", fastestOf(REPEAT, [&] () { countArchives(mods); }), "ms");
+}
@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include <cstdio>
+
+
+namespace MOBenchmark {
+
+
+Benchmark::Benchmark(const char *name, Function function)
+  : m_Name(name), m_Function(function)
+{
+  registry().push_back(this);
+}
+
+std::vector<const Benchmark*> &Benchmark::registry()
+{
+  // function local so registering from static initializers in other files is safe
+  static std::vector<const Benchmark*> benchmarks;
+  return benchmarks;
+}
+
+const std::vector<const Benchmark*> &Benchmark::all()
+{
+  return registry();
+}
+
+int scaled(int count)
+{
+  return std::max(1, static_cast<int>(count * scale()));
+}
+
+void report(const std::string &name, double value, const char *unit)
+{
+  printf("%-48s %14.3f %s\n", name.c_str(), value, unit);
+  fflush(stdout);
+}
+
+
+} // namespace MOBenchmark
@@ -0,0 +1,132 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+namespace MOBenchmark {
+
+
+/**
+ * @brief a named measurement. Benchmarks register themselves through MO_BENCHMARK and are
+ *        selected by name on the command line (see main.cpp)
+ */
+class Benchmark
+{
+
+public:
+
+  typedef void (*Function)();
+
+public:
+
+  Benchmark(const char *name, Function function);
+
+  static const std::vector<const Benchmark*> &all();
+
+  const char *name() const { return m_Name; }
+  void run() const { m_Function(); }
+
+private:
+
+  static std::vector<const Benchmark*> &registry();
+
+private:
+
+  const char *m_Name;
+  Function m_Function;
+
+};
+
+
+#define MO_BENCHMARK(name) \
+  static void benchmark_##name(); \
+  static const MOBenchmark::Benchmark benchmark_##name##_registration(#name, &benchmark_##name); \
+  static void benchmark_##name()
+
+
+class Timer
+{
+
+public:
+
+  Timer() : m_Start(std::chrono::steady_clock::now()) {}
+
+  double elapsedMs() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+  }
+
+private:
+
+  std::chrono::steady_clock::time_point m_Start;
+
+};
+
+
+/**
+ * @brief run a function several times
+ * @return duration of the fastest run in milliseconds
+ */
+template <typename Func>
+double fastestOf(int repeat, Func func)
+{
+  double result = 0.0;
+  for (int i = 0; i < repeat; ++i) {
+    Timer timer;
+    func();
+    double elapsed = timer.elapsedMs();
+    result = (i == 0) ? elapsed : std::min(result, elapsed);
+  }
+  return result;
+}
+
+
+// bytes currently allocated through operator new
+size_t allocatedBytes();
+
+// factor the default problem sizes are multiplied with, set with --scale
+double scale();
+int scaled(int count);
+
+// number of worker threads to compare against a single thread, set with --threads
+int threadCount();
+
+// directory the benchmarks may create files in, set with --temp
+std::wstring tempDirectory();
+
+// print a result line
+void report(const std::string &name, double value, const char *unit);
+
+// print a failed check. The program exits with an error if any check failed
+void fail(const std::string &message);
+
+// create the Qt application object unless there is one, for benchmarks that use organizer classes
+void createApplication();
+
+
+} // namespace MOBenchmark
+
+#endif // BENCHMARK_H
@@ -0,0 +1,314 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "synthetic.h"
+#include "casefold.h"
+#include "util.h"
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+#include <locale>
+#include <random>
+#include <sstream>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int MAX_FAILURES = 10;
+
+
+// folding the way util.cpp did it before the table: std::tolower with the user's locale for
+// every character
+static const std::locale &referenceLocale()
+{
+  static const std::locale locale("");
+  return locale;
+}
+
+static wchar_t referenceFold(wchar_t ch)
+{
+  return std::tolower(ch, referenceLocale());
+}
+
+static std::wstring referenceToLower(const std::wstring &text)
+{
+  std::wstring result(text);
+  std::transform(result.begin(), result.end(), result.begin(), referenceFold);
+  return result;
+}
+
+static bool referenceEqual(const std::wstring &lhs, const std::wstring &rhs)
+{
+  return (lhs.length() == rhs.length())
+      && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [] (wchar_t l, wchar_t r) {
+           return referenceFold(l) == referenceFold(r);
+         });
+}
+
+static unsigned long long referenceHash(const std::wstring &text)
+{
+  unsigned long long state = CaseInsensitiveHashSeed;
+  for (wchar_t ch : referenceToLower(text)) {
+    state ^= static_cast<unsigned long long>(ch);
+    state *= 1099511628211ULL;
+  }
+  return state;
+}
+
+static int sign(int value)
+{
+  return (value > 0) - (value < 0);
+}
+
+static std::string dump(const std::wstring &text)
+{
+  std::ostringstream stream;
+  stream << "\"";
+  for (wchar_t ch : text) {
+    stream << "\\x" << std::hex << static_cast<unsigned int>(ch);
+  }
+  stream << "\"";
+  return stream.str();
+}
+
+
+namespace {
+
+// strings with the mix of characters file names have: mostly ascii, some latin-1, greek and
+// cyrillic letters and occasionally anything else in the BMP, including lone surrogates
+class RandomText
+{
+
+public:
+
+  explicit RandomText(unsigned int seed) : m_Random(seed) {}
+
+  wchar_t character()
+  {
+    unsigned int kind = m_Random() % 100;
+    if (kind < 60) {
+      return static_cast<wchar_t>(0x20 + m_Random() % 0x5F);
+    } else if (kind < 75) {
+      return static_cast<wchar_t>(0xC0 + m_Random() % 0x40);
+    } else if (kind < 85) {
+      return static_cast<wchar_t>((m_Random() % 2 == 0) ? 0x391 + m_Random() % 0x39 : 0x400 + m_Random() % 0x60);
+    } else if (kind < 95) {
+      return static_cast<wchar_t>(1 + m_Random() % 0xFFFF);
+    } else {
+      return static_cast<wchar_t>(0xD800 + m_Random() % 0x800);
+    }
+  }
+
+  std::wstring text()
+  {
+    // lengths around the 8 character blocks the vectorized path processes
+    std::wstring result(m_Random() % 41, L' ');
+    for (wchar_t &ch : result) {
+      ch = character();
+    }
+    return result;
+  }
+
+  // a string that is often, but not always, equal to the source after folding
+  std::wstring variant(const std::wstring &source)
+  {
+    std::wstring result = source;
+    switch (m_Random() % 4) {
+      case 0:
+      case 1: {
+        for (wchar_t &ch : result) {
+          if (m_Random() % 2 == 0) {
+            ch = std::toupper(ch, referenceLocale());
+          }
+        }
+      } break;
+      case 2: {
+        if (!result.empty()) {
+          result[m_Random() % result.length()] = character();
+        }
+      } break;
+      case 3: {
+        result = text();
+      } break;
+    }
+    return result;
+  }
+
+  bool ascii(const std::wstring &text) const
+  {
+    return std::all_of(text.begin(), text.end(), [] (wchar_t ch) { return ch < 0x80; });
+  }
+
+private:
+
+  std::mt19937 m_Random;
+
+};
+
+}
+
+
+MO_BENCHMARK(casefold_fuzz)
+{
+  int failures = 0;
+  auto check = [&] (bool condition, const std::string &what) {
+    if (!condition && (failures++ < MAX_FAILURES)) {
+      fail(what);
+    }
+  };
+
+  // every character of the BMP
+  for (unsigned int ch = 1; ch < 0x10000; ++ch) {
+    check(FoldCase(static_cast<wchar_t>(ch)) == referenceFold(static_cast<wchar_t>(ch)),
+          "FoldCase(" + dump(std::wstring(1, static_cast<wchar_t>(ch))) + ")");
+  }
+
+  RandomText random(42);
+  int numCases = scaled(200000);
+  int numEqual = 0;
+  int numASCII = 0;
+  for (int i = 0; i < numCases; ++i) {
+    std::wstring lhs = random.text();
+    std::wstring rhs = random.variant(lhs);
+    std::wstring lhsLower = referenceToLower(lhs);
+    std::wstring rhsLower = referenceToLower(rhs);
+    std::string pair = dump(lhs) + ", " + dump(rhs);
+
+    std::wstring folded = lhs;
+    if (!folded.empty()) {
+      FoldCase(&folded[0], folded.length());
+    }
+    check(folded == lhsLower, "FoldCase(" + dump(lhs) + ")");
+    // a copy, ToLower of a non-const string folds it in place
+    std::wstring lowered = lhs;
+    check(ToLower(lowered) == lhsLower, "ToLower(" + dump(lhs) + ")");
+
+    bool equal = referenceEqual(lhs, rhs);
+    numEqual += equal ? 1 : 0;
+    if (lhs.length() == rhs.length()) {
+      check(FoldedEqual(lhs.c_str(), rhs.c_str(), lhs.length()) == equal, "FoldedEqual(" + pair + ")");
+    }
+    check(CaseInsensitiveEqual(lhs, rhs) == equal, "CaseInsensitiveEqual(" + pair + ")");
+    check(sign(FoldedCompare(lhs.c_str(), lhs.length(), rhs.c_str(), rhs.length())) == sign(lhsLower.compare(rhsLower)),
+          "FoldedCompare(" + pair + ")");
+
+    check(FoldedHashAppend(CaseInsensitiveHashSeed, lhs.c_str(), lhs.length()) == referenceHash(lhs),
+          "FoldedHashAppend(" + dump(lhs) + ")");
+    if (equal) {
+      check(CaseInsensitiveHash(lhs.c_str(), lhs.length()) == CaseInsensitiveHash(rhs.c_str(), rhs.length()),
+            "CaseInsensitiveHash(" + pair + ")");
+    }
+
+    // the C runtime folds only A-Z in the default locale, so it is only consulted for ascii names
+    if (random.ascii(lhs) && random.ascii(rhs)) {
+      ++numASCII;
+      check(sign(FoldedCompare(lhs.c_str(), lhs.length(), rhs.c_str(), rhs.length()))
+              == sign(_wcsicmp(lhs.c_str(), rhs.c_str())),
+            "_wcsicmp(" + pair + ")");
+    }
+  }
+
+  report("  random pairs compared with the locale", numCases, "pairs");
+  report("  pairs equal after folding", numEqual, "pairs");
+  report("  ascii pairs compared with _wcsicmp", numASCII, "pairs");
+}
+
+
+static double mCharsPerSecond(size_t characters, double ms)
+{
+  return characters / (ms * 1000.0);
+}
+
+static void reportThroughput(const std::string &prefix, const std::vector<std::wstring> &names)
+{
+  size_t characters = 0;
+  std::vector<std::wstring> upperNames;
+  for (const std::wstring &name : names) {
+    characters += name.length();
+    std::wstring upperName = name;
+    for (wchar_t &ch : upperName) {
+      ch = towupper(ch);
+    }
+    upperNames.push_back(upperName);
+  }
+
+  size_t sink = 0;
+  report(prefix + "lower case copy, locale",
+         mCharsPerSecond(characters, fastestOf(5, [&] () {
+           for (const std::wstring &name : names) {
+             sink += referenceToLower(name).length();
+           }
+         })), "M chars/s");
+  report(prefix + "lower case copy, table",
+         mCharsPerSecond(characters, fastestOf(5, [&] () {
+           for (const std::wstring &name : names) {
+             sink += ToLower(name).length();
+           }
+         })), "M chars/s");
+  report(prefix + "equal, locale",
+         mCharsPerSecond(characters, fastestOf(5, [&] () {
+           for (size_t i = 0; i < names.size(); ++i) {
+             sink += referenceEqual(names[i], upperNames[i]) ? 1 : 0;
+           }
+         })), "M chars/s");
+  report(prefix + "equal, table",
+         mCharsPerSecond(characters, fastestOf(5, [&] () {
+           for (size_t i = 0; i < names.size(); ++i) {
+             sink += CaseInsensitiveEqual(names[i], upperNames[i]) ? 1 : 0;
+           }
+         })), "M chars/s");
+  report(prefix + "hash, lower case copy",
+         mCharsPerSecond(characters, fastestOf(5, [&] () {
+           for (const std::wstring &name : names) {
+             sink += static_cast<size_t>(referenceHash(name));
+           }
+         })), "M chars/s");
+  report(prefix + "hash while folding",
+         mCharsPerSecond(characters, fastestOf(5, [&] () {
+           for (const std::wstring &name : names) {
+             sink += CaseInsensitiveHash(name.c_str(), name.length());
+           }
+         })), "M chars/s");
+  if (sink == 0) {
+    fail("nothing was folded");
+  }
+}
+
+
+MO_BENCHMARK(casefold_throughput)
+{
+  SyntheticSetup setup(100, 20, 100);
+  std::vector<std::wstring> paths = samplePaths(setup, scaled(200000), true);
+  reportThroughput("  ascii paths, ", paths);
+
+  // some characters of every path replaced by accented letters, the way translated mods name files
+  static const wchar_t ACCENTED[] = { 0xC4, 0xE9, 0xF6, 0xDC, 0x436, 0x3A3 };
+  std::vector<std::wstring> accented = paths;
+  for (size_t i = 0; i < accented.size(); ++i) {
+    for (size_t pos = i % 5; pos < accented[i].length(); pos += 7) {
+      if (accented[i][pos] != L'\\') {
+        accented[i][pos] = ACCENTED[(i + pos) % 6];
+      }
+    }
+  }
+  reportThroughput("  accented paths, ", accented);
+}
@@ -0,0 +1,140 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "synthetic.h"
+#include "modinfo.h"
+#include <utility.h>
+#include <QDir>
+#include <algorithm>
+#include <memory>
+#include <sstream>
+
+
+using namespace MOBase;
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+// how ModListSortProxy::lessThan compared the contents before it used the masks
+static bool contentLess(const std::vector<ModInfo::EContent> &lContent, const std::vector<ModInfo::EContent> &rContent)
+{
+  int lValue = 0;
+  int rValue = 0;
+  for (ModInfo::EContent content : lContent) {
+    lValue += 2 << (unsigned int)content;
+  }
+  for (ModInfo::EContent content : rContent) {
+    rValue += 2 << (unsigned int)content;
+  }
+  return lValue < rValue;
+}
+
+// how ModInfoRegular::getContents found the contents before they were taken from the directory
+// structure. The script extender check is left out, it needs the game plugin
+static std::vector<ModInfo::EContent> probeContents(const QString &path)
+{
+  std::vector<ModInfo::EContent> result;
+  QDir dir(path);
+  if (dir.entryList(QStringList() << "*.esp" << "*.esm" << "*.esl").size() > 0) {
+    result.push_back(ModInfo::CONTENT_PLUGIN);
+  }
+  if (dir.entryList(QStringList() << "*.bsa" << "*.ba2").size() > 0) {
+    result.push_back(ModInfo::CONTENT_BSA);
+  }
+  if (dir.exists("textures"))
+    result.push_back(ModInfo::CONTENT_TEXTURE);
+  if (dir.exists("meshes"))
+    result.push_back(ModInfo::CONTENT_MESH);
+  if (dir.exists("interface") || dir.exists("menus"))
+    result.push_back(ModInfo::CONTENT_INTERFACE);
+  if (dir.exists("music") || dir.exists("sound"))
+    result.push_back(ModInfo::CONTENT_SOUND);
+  if (dir.exists("scripts"))
+    result.push_back(ModInfo::CONTENT_SCRIPT);
+  if (dir.exists("SkyProc Patchers"))
+    result.push_back(ModInfo::CONTENT_SKYPROC);
+  if (dir.exists("MCM"))
+    result.push_back(ModInfo::CONTENT_MCM);
+  return result;
+}
+
+
+MO_BENCHMARK(content_sort)
+{
+  // the nexus interface the mods create reads the version of the running executable
+  createApplication();
+
+  SyntheticSetup setup(scaled(2000), 4, 5);
+  std::vector<std::wstring> modDirectories = writeSetup(setup, tempDirectory());
+  QStringList directories;
+  for (const std::wstring &directory : modDirectories) {
+    directories.append(QDir::fromNativeSeparators(ToQString(directory)));
+  }
+
+  // the structure a refresh produces, with the contents recorded on the origins
+  std::unique_ptr<DirectoryEntry> structure(new DirectoryEntry(L"data", nullptr, 0));
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    OriginScan scan = scanMod(setup, mod);
+    structure->addFromOrigin(modName(mod), modDirectories[mod], mod + 1, scan);
+    structure->getOriginByName(modName(mod)).setContents(ModInfo::classifyContents(scan, QString()));
+  }
+  DirectoryEntry *structurePointer = structure.get();
+  std::vector<ModInfo::Ptr> mods = ModInfo::createFromDirectories(nullptr, "Skyrim", directories, &structurePointer);
+
+  std::ostringstream prefix;
+  prefix << "  " << setup.mods << " mods, ";
+
+  // before, the contents of every mod were probed on disk once a minute, the first sort after that
+  // paid for all of them. Sorting the cached lists is measured along with it
+  report(prefix.str() + "probe on disk and sort", fastestOf(3, [&] () {
+    std::vector<std::pair<std::vector<ModInfo::EContent>, ModInfo::Ptr> > probed;
+    for (const ModInfo::Ptr &mod : mods) {
+      probed.push_back(std::make_pair(probeContents(mod->absolutePath()), mod));
+    }
+    std::stable_sort(probed.begin(), probed.end(), [] (const std::pair<std::vector<ModInfo::EContent>, ModInfo::Ptr> &lhs,
+                                                       const std::pair<std::vector<ModInfo::EContent>, ModInfo::Ptr> &rhs) {
+      return contentLess(lhs.first, rhs.first);
+    });
+  }), "ms");
+
+  // the contents are read back from the origins, building the lists for every comparison
+  std::vector<ModInfo::Ptr> sorted;
+  report(prefix.str() + "sort content lists from the structure", fastestOf(3, [&] () {
+    sorted = mods;
+    std::stable_sort(sorted.begin(), sorted.end(), [] (const ModInfo::Ptr &lhs, const ModInfo::Ptr &rhs) {
+      return contentLess(lhs->getContents(), rhs->getContents());
+    });
+  }), "ms");
+
+  // what the proxy does now. The origins are looked up once per mod after the caches are cleared
+  for (const ModInfo::Ptr &mod : mods) {
+    mod->clearCaches();
+  }
+  std::vector<ModInfo::Ptr> masked;
+  report(prefix.str() + "sort content masks", fastestOf(3, [&] () {
+    masked = mods;
+    std::stable_sort(masked.begin(), masked.end(), [] (const ModInfo::Ptr &lhs, const ModInfo::Ptr &rhs) {
+      return lhs->getContentsMask() < rhs->getContentsMask();
+    });
+  }), "ms");
+
+  if (masked != sorted) {
+    fail("sorting by mask gives a different order than sorting the content lists");
+  }
+}
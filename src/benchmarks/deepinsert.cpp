@@ -0,0 +1,111 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "directoryentry.h"
+#include <memory>
+#include <sstream>
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int DEPTH = 32;
+static const int FILES_PER_LEVEL = 20;
+static const FILETIME FILE_TIME = { 0x12345678, 0x01d00000 };
+
+
+static std::wstring levelName(int level)
+{
+  std::wostringstream name;
+  name << L"level" << level;
+  return name.str();
+}
+
+// a single chain of nested directories with files at every level, e.g. deeply nested interface or
+// script sources. All mods share the chain, the file names are per mod
+static OriginScan scanDeepMod(int mod)
+{
+  std::vector<OriginScan::Entry> entries;
+  for (int level = 0; level < DEPTH; ++level) {
+    entries.push_back({ OriginScan::ENTRY_DIRECTORY, levelName(level), FILE_TIME });
+    for (int file = 0; file < FILES_PER_LEVEL; ++file) {
+      std::wostringstream name;
+      name << L"mod" << mod << L"_file" << file << L".txt";
+      entries.push_back({ OriginScan::ENTRY_FILE, name.str(), FILE_TIME });
+    }
+  }
+  for (int level = 0; level < DEPTH; ++level) {
+    entries.push_back({ OriginScan::ENTRY_END_DIRECTORY, std::wstring(), FILE_TIME });
+  }
+  OriginScan result;
+  result.restore(false, FILE_TIME, 0, std::move(entries));
+  return result;
+}
+
+static std::wstring deepModName(int mod)
+{
+  std::wostringstream name;
+  name << L"deep mod " << mod;
+  return name.str();
+}
+
+/**
+ * add all mods to a new tree
+ * @param walkPerFile if true every file also walks from its directory to the root to record its
+ *                    origin there, which is what adding a file did before addFiles recorded the
+ *                    origin once per directory
+ */
+static size_t build(const std::vector<OriginScan> &scans, bool walkPerFile)
+{
+  std::unique_ptr<DirectoryEntry> structure(new DirectoryEntry(L"data", nullptr, 0));
+  for (size_t mod = 0; mod < scans.size(); ++mod) {
+    structure->addFromOrigin(deepModName(static_cast<int>(mod)), L"C:\\mods\\deep", static_cast<int>(mod) + 1,
+                             scans[mod]);
+    if (walkPerFile) {
+      int originID = structure->getOriginByName(deepModName(static_cast<int>(mod))).getID();
+      DirectoryEntry *directory = structure.get();
+      for (int level = 0; level < DEPTH; ++level) {
+        directory = directory->findSubDirectoryRecursive(levelName(level));
+        for (int file = 0; file < FILES_PER_LEVEL; ++file) {
+          directory->propagateOrigin(originID);
+        }
+      }
+    }
+  }
+  return structure->getFileRegister()->size();
+}
+
+
+MO_BENCHMARK(deep_insert)
+{
+  std::vector<OriginScan> scans;
+  for (int mod = 0; mod < scaled(200); ++mod) {
+    scans.push_back(scanDeepMod(mod));
+  }
+
+  size_t files = 0;
+  std::ostringstream prefix;
+  double walk = fastestOf(3, [&] () { files = build(scans, true); });
+  prefix << "  " << scans.size() << " mods, " << DEPTH << " levels, " << files << " files, ";
+  report(prefix.str() + "origin walk per file", walk, "ms");
+  report(prefix.str() + "origin per directory", fastestOf(3, [&] () { build(scans, false); }), "ms");
+}
@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "synthetic.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const size_t NUM_LOOKUPS = 1000000;
+
+
+MO_BENCHMARK(file_register)
+{
+  // about two million files, the size of large setups with many texture packs
+  SyntheticSetup setup(scaled(1430), 20, 100);
+
+  size_t allocatedBefore = allocatedBytes();
+  Timer timer;
+  std::unique_ptr<DirectoryEntry> structure(buildStructure(setup));
+  double buildDuration = timer.elapsedMs();
+  size_t allocated = allocatedBytes() - allocatedBefore;
+
+  const FileRegister &files = *structure->getFileRegister();
+  std::string prefix = "  " + std::to_string(files.size()) + " files, ";
+  report(prefix + "build", buildDuration, "ms");
+  report(prefix + "memory", allocated / (1024.0 * 1024.0), "MB");
+  report(prefix + "memory per file", static_cast<double>(allocated) / files.size(), "bytes");
+
+  // resolve indices the way origins and directories do, in random order so the slab isn't walked
+  std::vector<FileEntry::Index> indices;
+  structure->forEachFileRecursive([&] (const FileEntry &file) {
+    indices.push_back(file.getIndex());
+    return true;
+  });
+  std::shuffle(indices.begin(), indices.end(), std::mt19937(42));
+  indices.resize(std::min(indices.size(), NUM_LOOKUPS));
+
+  size_t found = 0;
+  double duration = fastestOf(5, [&] () {
+    found = 0;
+    for (FileEntry::Index index : indices) {
+      if (files.getFile(index).get() != nullptr) {
+        ++found;
+      }
+    }
+  });
+  report(prefix + "getFile", duration * 1000000.0 / indices.size(), "ns/lookup");
+}
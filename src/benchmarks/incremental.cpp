@@ -0,0 +1,71 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "randomsetup.h"
+#include <memory>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int NUM_MODS = 12;
+static const int UPDATES_PER_SETUP = 20;
+
+
+// same steps as DirectoryRefresher::applyIncrementalUpdate: remove all changed mods, then add
+// them back in priority order
+static void applyUpdate(const RandomSetup &setup, const std::vector<int> &changed, DirectoryEntry *structure)
+{
+  for (int mod : changed) {
+    const std::wstring &name = setup.mods()[mod].name;
+    if (structure->originExists(name)) {
+      FilesOrigin &origin = structure->getOriginByName(name);
+      origin.enable(false);
+      structure->pruneOrigin(origin.getID());
+    }
+  }
+  for (int mod : changed) {
+    setup.addMod(structure, mod, mod + 1);
+  }
+}
+
+
+MO_BENCHMARK(incremental_update)
+{
+  int numSetups = scaled(50);
+  int numUpdates = 0;
+  for (int seed = 0; seed < numSetups; ++seed) {
+    RandomSetup setup(NUM_MODS, seed);
+    std::unique_ptr<DirectoryEntry> structure(setup.build());
+    for (int update = 0; update < UPDATES_PER_SETUP; ++update) {
+      std::vector<int> changed = setup.mutate();
+      applyUpdate(setup, changed, structure.get());
+      ++numUpdates;
+
+      std::unique_ptr<DirectoryEntry> expected(setup.build());
+      std::string context = "seed " + std::to_string(seed) + ", update " + std::to_string(update);
+      if (!compareStructures(*expected, *structure, setup.modNames(), context)) {
+        break;
+      }
+    }
+  }
+  report("  updates compared with a full build", numUpdates, "updates");
+}
@@ -0,0 +1,199 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "synthetic.h"
+#include "util.h"
+#include <map>
+#include <memory>
+#include <cwctype>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const size_t NUM_LOOKUPS = 500000;
+
+// the linear scan is so slow only every n-th lookup is done with it
+static const size_t LINEAR_STRIDE = 50;
+
+
+// the game asks for files in whatever case the plugins use
+static std::wstring upper(std::wstring text)
+{
+  for (wchar_t &ch : text) {
+    ch = towupper(ch);
+  }
+  return text;
+}
+
+
+/**
+ * the children of a directory the way they were stored before the index: files in a map keyed by
+ * the lower case name, subdirectories in a list that was searched with CaseInsensitiveEqual
+ */
+template <typename Value>
+struct Baseline {
+  std::map<std::wstring, Value> byLowerName;
+  std::vector<std::pair<std::wstring, Value>> list;
+
+  void add(const std::wstring &name, Value value) {
+    byLowerName[ToLower(name)] = value;
+    list.push_back(std::make_pair(name, value));
+  }
+
+  bool findMap(const std::wstring &name) const {
+    return byLowerName.find(ToLower(name)) != byLowerName.end();
+  }
+
+  bool findLinear(const std::wstring &name) const {
+    for (const auto &entry : list) {
+      if (CaseInsensitiveEqual(entry.first, name)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+
+/**
+ * time lookups, every stride-th one
+ * @return duration per lookup in nanoseconds
+ */
+template <typename Lookup, typename Find>
+static double nsPerLookup(const std::vector<Lookup> &lookups, size_t stride, Find find)
+{
+  size_t found = 0;
+  double duration = fastestOf(5, [&] () {
+    found = 0;
+    for (size_t i = 0; i < lookups.size(); i += stride) {
+      if (find(lookups[i])) {
+        ++found;
+      }
+    }
+  });
+  return duration * 1000000.0 / ((lookups.size() + stride - 1) / stride);
+}
+
+
+template <typename Lookup, typename Find, typename Value>
+static void reportVariants(const std::string &prefix, const std::vector<Lookup> &lookups, Find find,
+                           const Baseline<Value> &(*baseline)(const Lookup &))
+{
+  report(prefix + "index", nsPerLookup(lookups, 1, find), "ns/lookup");
+  report(prefix + "map, ToLower",
+         nsPerLookup(lookups, 1, [&] (const Lookup &lookup) {
+           return baseline(lookup).findMap(lookup.name);
+         }), "ns/lookup");
+  report(prefix + "linear, CaseInsensitiveEqual",
+         nsPerLookup(lookups, LINEAR_STRIDE, [&] (const Lookup &lookup) {
+           return baseline(lookup).findLinear(lookup.name);
+         }), "ns/lookup");
+}
+
+
+namespace {
+
+struct FileLookup {
+  DirectoryEntry *directory;
+  const Baseline<FileEntry::Index> *baseline;
+  std::wstring name;
+};
+
+struct DirectoryLookup {
+  const Baseline<DirectoryEntry*> *baseline;
+  std::wstring name;
+};
+
+}
+
+static const Baseline<FileEntry::Index> &fileBaseline(const FileLookup &lookup)
+{
+  return *lookup.baseline;
+}
+
+static const Baseline<DirectoryEntry*> &directoryBaseline(const DirectoryLookup &lookup)
+{
+  return *lookup.baseline;
+}
+
+
+MO_BENCHMARK(directory_lookup)
+{
+  // few directories with many files each, the way texture and mesh directories of large setups are
+  SyntheticSetup setup(scaled(100), 8, 500);
+  std::unique_ptr<DirectoryEntry> structure(buildStructure(setup));
+
+  std::map<DirectoryEntry*, Baseline<FileEntry::Index>> baselines;
+  for (int directory = 0; directory < setup.directoriesPerMod; ++directory) {
+    DirectoryEntry *entry = structure->findSubDirectoryRecursive(directoryName(directory));
+    Baseline<FileEntry::Index> &baseline = baselines[entry];
+    entry->forEachFile([&] (const FileEntry &file) {
+      baseline.add(file.getName(), file.getIndex());
+      return true;
+    });
+  }
+
+  // the paths are split up front, only finding the child in its directory is measured
+  auto prepare = [&] (bool existing, bool upperCase) {
+    std::vector<FileLookup> result;
+    for (const std::wstring &path : samplePaths(setup, NUM_LOOKUPS, existing)) {
+      size_t separator = path.find_last_of(L'\\');
+      std::wstring name = path.substr(separator + 1);
+      DirectoryEntry *directory = structure->findSubDirectoryRecursive(path.substr(0, separator));
+      result.push_back({ directory, &baselines[directory], upperCase ? upper(name) : name });
+    }
+    return result;
+  };
+
+  auto findFile = [] (const FileLookup &lookup) {
+    return lookup.directory->findFile(lookup.name).get() != nullptr;
+  };
+
+  size_t perDirectory = structure->getFileRegister()->size() / setup.directoriesPerMod;
+  std::string prefix = "  files, ~" + std::to_string(perDirectory) + " per directory, ";
+  reportVariants(prefix + "hit, ", prepare(true, false), findFile, &fileBaseline);
+  reportVariants(prefix + "hit, other case, ", prepare(true, true), findFile, &fileBaseline);
+  reportVariants(prefix + "miss, ", prepare(false, false), findFile, &fileBaseline);
+
+  // many subdirectories in one directory
+  SyntheticSetup wide(10, scaled(4000), 2);
+  std::unique_ptr<DirectoryEntry> wideStructure(buildStructure(wide));
+  DirectoryEntry *textures = wideStructure->findSubDirectory(L"textures");
+
+  Baseline<DirectoryEntry*> subDirectories;
+  for (DirectoryEntry *directory : textures->getSubDirectories()) {
+    subDirectories.add(directory->getName(), directory);
+  }
+
+  std::vector<DirectoryLookup> names;
+  for (size_t i = 0; i < NUM_LOOKUPS; ++i) {
+    // spread the lookups over all directories, unsigned so the product can't overflow
+    std::wstring path = directoryName(static_cast<int>((i * 7919U) % wide.directoriesPerMod));
+    if (path.compare(0, 9, L"textures\\") == 0) {
+      names.push_back({ &subDirectories, upper(path.substr(9)) });
+    }
+  }
+  reportVariants("  subdirectories, " + std::to_string(wide.directoriesPerMod / 4) + " in the directory, ",
+                 names,
+                 [&] (const DirectoryLookup &lookup) { return textures->findSubDirectory(lookup.name) != nullptr; },
+                 &directoryBaseline);
+}
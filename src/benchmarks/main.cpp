@@ -0,0 +1,149 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Measurements of the virtual directory structure on synthetic mod setups.
+ *
+ * usage: benchmarks [--scale=<factor>] [--threads=<count>] [--temp=<directory>] [name...]
+ *
+ * Without names all benchmarks run, otherwise those whose name contains one of the names.
+ * Benchmarks that need files on disk create them below the temp directory once and reuse them
+ * on later runs. Some entries are randomized checks that compare two ways of producing the same
+ * structure instead of measuring, if one of them fails the exit code is 1.
+ */
+
+#include "benchmark.h"
+#include "util.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <thread>
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+
+static std::atomic<size_t> s_Allocated(0);
+static double s_Scale = 1.0;
+static int s_Threads = 0;
+static std::wstring s_Temp;
+static int s_Failures = 0;
+
+// allocations are prefixed with their size so the live total can be tracked
+static const size_t HEADER_SIZE = sizeof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+  char *block = static_cast<char*>(malloc(size + HEADER_SIZE));
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(block) = size;
+  s_Allocated += size;
+  return block + HEADER_SIZE;
+}
+
+void operator delete(void *pointer) noexcept
+{
+  if (pointer != nullptr) {
+    char *block = static_cast<char*>(pointer) - HEADER_SIZE;
+    s_Allocated -= *reinterpret_cast<size_t*>(block);
+    free(block);
+  }
+}
+
+
+namespace MOBenchmark {
+
+size_t allocatedBytes()
+{
+  return s_Allocated;
+}
+
+double scale()
+{
+  return s_Scale;
+}
+
+int threadCount()
+{
+  return s_Threads;
+}
+
+std::wstring tempDirectory()
+{
+  return s_Temp;
+}
+
+void fail(const std::string &message)
+{
+  printf("  FAILED: %s\n", message.c_str());
+  fflush(stdout);
+  ++s_Failures;
+}
+
+} // namespace MOBenchmark
+
+
+int main(int argc, char *argv[])
+{
+  using namespace MOBenchmark;
+
+  std::vector<const char*> names;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--scale=", 8) == 0) {
+      s_Scale = atof(argv[i] + 8);
+    } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+      s_Threads = atoi(argv[i] + 10);
+    } else if (strncmp(argv[i], "--temp=", 7) == 0) {
+      s_Temp = MOShared::ToWString(argv[i] + 7, false);
+    } else if (argv[i][0] == '-') {
+      printf("usage: %s [--scale=<factor>] [--threads=<count>] [--temp=<directory>] [name...]\n", argv[0]);
+      return 1;
+    } else {
+      names.push_back(argv[i]);
+    }
+  }
+
+  if (s_Threads <= 0) {
+    s_Threads = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  if (s_Temp.empty()) {
+    wchar_t buffer[MAX_PATH];
+    DWORD length = ::GetTempPathW(MAX_PATH, buffer);
+    s_Temp.assign(buffer, length);
+    while (!s_Temp.empty() && ((s_Temp.back() == L'\\') || (s_Temp.back() == L'/'))) {
+      s_Temp.pop_back();
+    }
+  }
+
+  for (const Benchmark *benchmark : Benchmark::all()) {
+    bool selected = names.empty();
+    for (const char *name : names) {
+      selected = selected || (strstr(benchmark->name(), name) != nullptr);
+    }
+    if (selected) {
+      printf("%s\n", benchmark->name());
+      benchmark->run();
+    }
+  }
+  return (s_Failures > 0) ? 1 : 0;
+}
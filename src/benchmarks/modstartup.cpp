@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "synthetic.h"
+#include "modinfo.h"
+#include <utility.h>
+#include <QDir>
+#include <QFile>
+#include <sstream>
+
+
+using namespace MOBase;
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int REPEAT = 3;
+
+
+// meta.ini of a mod installed from a download, written unless the mod has one already
+static void writeMeta(const std::wstring &modDirectory, int mod)
+{
+  QFile file(QDir::fromNativeSeparators(ToQString(modDirectory)) + "/meta.ini");
+  if (file.exists()) {
+    return;
+  }
+  if (!file.open(QIODevice::WriteOnly)) {
+    throw std::runtime_error("failed to create " + file.fileName().toStdString());
+  }
+  int modID = 1000 + mod;
+  QString description;
+  for (int paragraph = 0; paragraph < 20; ++paragraph) {
+    description += QString("<p>Paragraph %1 of the description of mod %2, as cached from the nexus.</p>")
+                   .arg(paragraph).arg(modID);
+  }
+  QString contents = QString("[General]\r\n"
+                             "gameName=Skyrim\r\n"
+                             "modid=%1\r\n"
+                             "version=1.%2.0\r\n"
+                             "newestVersion=1.%2.0\r\n"
+                             "ignoredVersion=\r\n"
+                             "category=\"%3,\"\r\n"
+                             "installationFile=Mod %1-%1-1-%2.7z\r\n"
+                             "repository=Nexus\r\n"
+                             "notes=\r\n"
+                             "nexusDescription=\"%4\"\r\n"
+                             "url=\r\n"
+                             "lastNexusQuery=2018-03-01T12:00:00\r\n"
+                             "endorsed=0\r\n"
+                             "\r\n"
+                             "[installedFiles]\r\n"
+                             "size=1\r\n"
+                             "1\\modid=%1\r\n"
+                             "1\\fileid=%5\r\n")
+                     .arg(modID).arg(mod % 10).arg(mod % 60 + 1).arg(description).arg(modID * 3);
+  file.write(contents.toUtf8());
+}
+
+static double createMods(const QStringList &directories, int threadCount)
+{
+  double result = 0.0;
+  for (int i = 0; i < REPEAT; ++i) {
+    MOShared::DirectoryEntry *structure = nullptr;
+    Timer timer;
+    std::vector<ModInfo::Ptr> mods = ModInfo::createFromDirectories(nullptr, "Skyrim", directories, &structure,
+                                                                    threadCount);
+    double elapsed = timer.elapsedMs();
+    result = (i == 0) ? elapsed : std::min(result, elapsed);
+    if (mods.size() != static_cast<size_t>(directories.size())) {
+      fail("created " + std::to_string(mods.size()) + " of " + std::to_string(directories.size()) + " mods");
+    }
+  }
+  return result;
+}
+
+
+MO_BENCHMARK(mod_startup)
+{
+  // the nexus interface the mods create reads the version of the running executable
+  createApplication();
+
+  SyntheticSetup setup(scaled(2000), 4, 5);
+  std::vector<std::wstring> modDirectories = writeSetup(setup, tempDirectory());
+  QStringList directories;
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    writeMeta(modDirectories[mod], mod);
+    directories.append(QDir::fromNativeSeparators(ToQString(modDirectories[mod])));
+  }
+
+  // warm up the file system cache, the measurements compare the processing, not the disk
+  createMods(directories, 1);
+
+  std::ostringstream prefix;
+  prefix << "  " << setup.mods << " mods, ";
+  std::ostringstream parallel;
+  parallel << threadCount() << " threads";
+  report(prefix.str() + "1 thread", createMods(directories, 1), "ms");
+  report(prefix.str() + parallel.str(), createMods(directories, threadCount()), "ms");
+}
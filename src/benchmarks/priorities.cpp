@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "randomsetup.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int NUM_MODS = 12;
+static const int CHANGES_PER_SETUP = 20;
+
+
+// new priorities the way the mod list produces them: mostly a single mod dragged to a new place,
+// sometimes a block of mods or a completely different order
+static std::vector<int> reorder(const std::vector<int> &priorities, std::mt19937 &random)
+{
+  // mods in their current order
+  std::vector<int> order(priorities.size());
+  for (size_t mod = 0; mod < priorities.size(); ++mod) {
+    order[mod] = static_cast<int>(mod);
+  }
+  std::sort(order.begin(), order.end(), [&] (int lhs, int rhs) { return priorities[lhs] < priorities[rhs]; });
+
+  std::uniform_int_distribution<size_t> position(0, order.size() - 1);
+  switch (std::uniform_int_distribution<int>(0, 3)(random)) {
+    case 0: {
+      std::shuffle(order.begin(), order.end(), random);
+    } break;
+    case 1: {
+      size_t first = position(random);
+      size_t last = std::min(order.size(), first + 1 + position(random) % 4);
+      std::vector<int> block(order.begin() + first, order.begin() + last);
+      order.erase(order.begin() + first, order.begin() + last);
+      size_t target = std::uniform_int_distribution<size_t>(0, order.size())(random);
+      order.insert(order.begin() + target, block.begin(), block.end());
+    } break;
+    default: {
+      int mod = order[position(random)];
+      order.erase(std::find(order.begin(), order.end(), mod));
+      order.insert(order.begin() + position(random), mod);
+    } break;
+  }
+
+  std::vector<int> result(priorities.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    result[order[i]] = static_cast<int>(i) + 1;
+  }
+  return result;
+}
+
+/**
+ * the changes setOriginPriorities is called with
+ * @param all if false only the mods whose priority changed are included, otherwise all of them
+ */
+static std::map<int, int> priorityChanges(const RandomSetup &setup, const DirectoryEntry &structure,
+                                          const std::vector<int> &previous, const std::vector<int> &priorities,
+                                          bool all)
+{
+  std::map<int, int> result;
+  for (size_t mod = 0; mod < priorities.size(); ++mod) {
+    if (all || (priorities[mod] != previous[mod])) {
+      result[structure.getOriginByName(setup.mods()[mod].name).getID()] = priorities[mod];
+    }
+  }
+  return result;
+}
+
+
+// the conflicts of an origin with the origin names in place of the ids
+static std::vector<std::pair<std::wstring, std::vector<unsigned int> > > conflicts(DirectoryEntry &structure,
+                                                                                 const std::wstring &name)
+{
+  std::vector<std::pair<std::wstring, std::vector<unsigned int> > > result;
+  const ConflictGraph::Node *node
+      = structure.getFileRegister()->conflictGraph().node(structure.getOriginByName(name).getID());
+  if (node == nullptr) {
+    return result;
+  }
+  result.push_back(std::make_pair(std::wstring(), std::vector<unsigned int>{
+      node->numFiles, node->numProvided, node->numPrimary, node->numOverwrite, node->numOverwritten,
+      node->numArchiveOverwrite, node->numArchiveOverwritten }));
+  for (const ConflictGraph::Edge &edge : node->edges) {
+    result.push_back(std::make_pair(structure.getOriginByID(edge.origin).getName(), std::vector<unsigned int>{
+        edge.counts.overwrite, edge.counts.overwritten, edge.counts.archiveOverwrite, edge.counts.archiveOverwritten }));
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+
+MO_BENCHMARK(priority_change)
+{
+  // setOriginPriorities only re-sorts the files of the origins outside the longest run that kept
+  // its order. Its result is compared with a build that inserted the origins with the new
+  // priorities from the start, and with re-sorting the origins of every file the way a priority
+  // change did before
+  int numSetups = scaled(50);
+  int numChanges = 0;
+  size_t numMoved = 0;
+  for (int seed = 0; seed < numSetups; ++seed) {
+    RandomSetup setup(NUM_MODS, seed);
+    std::mt19937 random(seed);
+    std::vector<int> priorities;
+    for (int mod = 0; mod < NUM_MODS; ++mod) {
+      priorities.push_back(mod + 1);
+    }
+    std::unique_ptr<DirectoryEntry> structure(setup.build());
+    // built up front so the priority changes update it instead of leaving it to be rebuilt
+    structure->getFileRegister()->conflictGraph();
+    for (int change = 0; change < CHANGES_PER_SETUP; ++change) {
+      std::vector<int> previous = priorities;
+      priorities = reorder(priorities, random);
+      bool all = (change % 2) == 1;
+      std::vector<int> moved = structure->setOriginPriorities(
+            priorityChanges(setup, *structure, previous, priorities, all));
+      numMoved += moved.size();
+      ++numChanges;
+
+      std::unique_ptr<DirectoryEntry> sorted(setup.build(previous));
+      sorted->setOriginPriorities(priorityChanges(setup, *sorted, previous, priorities, all));
+      std::vector<int> origins;
+      for (const std::wstring &name : setup.modNames()) {
+        origins.push_back(sorted->getOriginByName(name).getID());
+      }
+      sorted->getFileRegister()->sortOrigins(origins);
+
+      std::unique_ptr<DirectoryEntry> expected(setup.build(priorities));
+      std::string context = "seed " + std::to_string(seed) + ", change " + std::to_string(change);
+      if (!compareStructures(*expected, *sorted, setup.modNames(), context + ", every file sorted")
+          || !compareStructures(*expected, *structure, setup.modNames(), context)) {
+        break;
+      }
+      for (const std::wstring &name : setup.modNames()) {
+        if (conflicts(*expected, name) != conflicts(*structure, name)) {
+          fail(context + ": the updated conflict graph differs from a new one for "
+               + ToString(name, true));
+        }
+      }
+    }
+  }
+  report("  priority changes compared with a full build", numChanges, "changes");
+  report("  origins re-sorted per change", static_cast<double>(numMoved) / numChanges, "origins");
+}
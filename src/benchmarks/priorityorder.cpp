@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "synthetic.h"
+#include <map>
+#include <memory>
+#include <sstream>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+// the pass over every file a refresh and a priority change ran before origins were kept sorted on
+// insert and before priority changes only re-sorted the files of the moved origins
+static void sortAllFiles(DirectoryEntry &structure)
+{
+  boost::shared_ptr<FileRegister> files = structure.getFileRegister();
+  structure.forEachFileRecursive([&] (const FileEntry &file) -> bool {
+    files->getFile(file.getIndex())->sortOrigins();
+    return true;
+  });
+}
+
+
+MO_BENCHMARK(priority_order)
+{
+  SyntheticSetup setup(scaled(1000), 10, 20, 10);
+  std::unique_ptr<DirectoryEntry> structure;
+
+  std::ostringstream prefix;
+  prefix << "  " << setup.mods << " mods, " << setup.fileCount() << " files, ";
+
+  // building the tree in memory, without scanning the mods
+  report(prefix.str() + "build with sorted insert",
+         fastestOf(3, [&] () { structure.reset(buildStructure(setup)); }), "ms");
+  report(prefix.str() + "build and sort every file",
+         fastestOf(3, [&] () { structure.reset(buildStructure(setup)); sortAllFiles(*structure); }), "ms");
+
+  // drag the lowest mod to the top and back, every run moves it once. The priorities of the other
+  // mods are unchanged so only that mod moves relative to them
+  int originID = structure->getOriginByName(modName(0)).getID();
+  bool top = false;
+  auto move = [&] () -> std::map<int, int> {
+    std::map<int, int> priorities;
+    top = !top;
+    priorities[originID] = top ? setup.mods + 1 : 1;
+    return priorities;
+  };
+
+  size_t moved = 0;
+  report(prefix.str() + "move one mod, setOriginPriorities",
+         fastestOf(5, [&] () { moved = structure->setOriginPriorities(move()).size(); }), "ms");
+  if (moved != 1) {
+    fail("moving one mod re-sorted the files of " + std::to_string(moved) + " origins");
+  }
+  report(prefix.str() + "move one mod, sort every file",
+         fastestOf(5, [&] () { structure->setOriginPriorities(move()); sortAllFiles(*structure); }), "ms");
+
+  // updateModPriorities reads the conflict graph after every move. The graph is updated with the
+  // files of the moved mod, before it was rebuilt from all files
+  boost::shared_ptr<FileRegister> files = structure->getFileRegister();
+  files->conflictGraph();
+  report(prefix.str() + "move one mod, update the conflict graph",
+         fastestOf(5, [&] () { structure->setOriginPriorities(move()); files->conflictGraph(); }), "ms");
+  report(prefix.str() + "move one mod, rebuild the conflict graph",
+         fastestOf(5, [&] () { structure->setOriginPriorities(move()); files->touch(); files->conflictGraph(); }), "ms");
+}
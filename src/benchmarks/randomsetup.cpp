@@ -0,0 +1,371 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "randomsetup.h"
+#include "benchmark.h"
+#include "casefold.h"
+#include "util.h"
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+
+using namespace MOShared;
+
+
+namespace MOBenchmark {
+
+
+static const wchar_t *DIRECTORIES[] = {
+  L"textures", L"textures\\armor", L"textures\\armor\\iron", L"meshes", L"meshes\\clutter",
+  L"scripts", L"sound\\fx"
+};
+static const int NUM_DIRECTORIES = 7;
+static const int NUM_FILE_NAMES = 24;
+
+static const FILETIME DIRECTORY_TIME = { 0x12345678, 0x01d00000 };
+
+
+bool FoldedLess::operator()(const std::wstring &lhs, const std::wstring &rhs) const
+{
+  return FoldedCompare(lhs.c_str(), lhs.length(), rhs.c_str(), rhs.length()) < 0;
+}
+
+
+static std::wstring folded(std::wstring text)
+{
+  FoldCase(&text[0], text.length());
+  return text;
+}
+
+static bool foldedEqual(const std::wstring &lhs, const std::wstring &rhs)
+{
+  return (lhs.length() == rhs.length()) && FoldedEqual(lhs.c_str(), rhs.c_str(), lhs.length());
+}
+
+static std::wstring parentOf(const std::wstring &path)
+{
+  size_t pos = path.find_last_of(L'\\');
+  return pos != std::wstring::npos ? path.substr(0, pos) : std::wstring();
+}
+
+static std::wstring lastComponent(const std::wstring &path)
+{
+  size_t pos = path.find_last_of(L'\\');
+  return pos != std::wstring::npos ? path.substr(pos + 1) : path;
+}
+
+
+RandomSetup::RandomSetup(int mods, unsigned int seed)
+  : m_Random(seed)
+{
+  for (int i = 0; i < mods; ++i) {
+    RandomMod mod;
+    mod.name = L"Mod " + std::to_wstring(i);
+    mod.files[std::wstring()];
+    int numFiles = std::uniform_int_distribution<int>(0, 30)(m_Random);
+    for (int file = 0; file < numFiles; ++file) {
+      addFile(mod.files, false);
+    }
+    if (m_Random() % 4 == 0) {
+      // a folder without files, e.g. left over from an installer
+      addDirectory(mod.files, randomCase(DIRECTORIES[m_Random() % NUM_DIRECTORIES]));
+    }
+    mod.hasArchive = m_Random() % 3 == 0;
+    if (mod.hasArchive) {
+      fillArchive(mod);
+    }
+    m_Mods.push_back(mod);
+  }
+}
+
+std::vector<std::wstring> RandomSetup::modNames() const
+{
+  std::vector<std::wstring> result;
+  for (const RandomMod &mod : m_Mods) {
+    result.push_back(mod.name);
+  }
+  return result;
+}
+
+std::wstring RandomSetup::randomCase(const std::wstring &name)
+{
+  std::wstring result = name;
+  if (m_Random() % 4 == 0) {
+    for (wchar_t &ch : result) {
+      if ((ch >= L'a') && (ch <= L'z') && (m_Random() % 2 == 0)) {
+        ch = ch - L'a' + L'A';
+      }
+    }
+  }
+  return result;
+}
+
+FILETIME RandomSetup::randomTime()
+{
+  FILETIME result = { static_cast<DWORD>(m_Random()), static_cast<DWORD>(0x01d00000 + m_Random() % 16) };
+  return result;
+}
+
+void RandomSetup::addDirectory(RandomMod::Listing &listing, const std::wstring &path)
+{
+  for (size_t pos = path.find(L'\\'); pos != std::wstring::npos; pos = path.find(L'\\', pos + 1)) {
+    listing[path.substr(0, pos)];
+  }
+  listing[path];
+}
+
+void RandomSetup::addFile(RandomMod::Listing &listing, bool archive)
+{
+  // loose files are occasionally put directly into the data directory, archives always use folders
+  std::wstring directory;
+  if (archive || (m_Random() % 8 != 0)) {
+    directory = randomCase(DIRECTORIES[m_Random() % NUM_DIRECTORIES]);
+    addDirectory(listing, directory);
+  }
+  std::wstring name = randomCase(L"file" + std::to_wstring(m_Random() % NUM_FILE_NAMES) + L".dds");
+  listing[directory][name] = randomTime();
+}
+
+void RandomSetup::fillArchive(RandomMod &mod)
+{
+  mod.archive.clear();
+  int numFiles = std::uniform_int_distribution<int>(1, 15)(m_Random);
+  for (int file = 0; file < numFiles; ++file) {
+    addFile(mod.archive, true);
+  }
+}
+
+void RandomSetup::changeMod(RandomMod &mod)
+{
+  std::vector<std::pair<std::wstring, std::wstring>> files;
+  for (const auto &directory : mod.files) {
+    for (const auto &file : directory.second) {
+      files.push_back(std::make_pair(directory.first, file.first));
+    }
+  }
+
+  switch (m_Random() % 7) {
+    case 0: {
+      if (!files.empty()) {
+        const auto &file = files[m_Random() % files.size()];
+        mod.files[file.first].erase(file.second);
+      }
+    } break;
+    case 1: {
+      addFile(mod.files, false);
+    } break;
+    case 2: {
+      if (!files.empty()) {
+        const auto &file = files[m_Random() % files.size()];
+        mod.files[file.first][file.second] = randomTime();
+      }
+    } break;
+    case 3: {
+      mod.hasArchive = !mod.hasArchive;
+      if (mod.hasArchive) {
+        fillArchive(mod);
+      } else {
+        mod.archive.clear();
+      }
+    } break;
+    case 4: {
+      if (mod.hasArchive) {
+        addFile(mod.archive, true);
+      }
+    } break;
+    case 5: {
+      // remove a directory with everything below it
+      if (mod.files.size() > 1) {
+        auto directory = std::next(mod.files.begin(), 1 + m_Random() % (mod.files.size() - 1));
+        std::wstring prefix = directory->first + L"\\";
+        for (auto iter = mod.files.begin(); iter != mod.files.end();) {
+          if ((iter->first.length() >= prefix.length())
+              && FoldedEqual(iter->first.c_str(), prefix.c_str(), prefix.length())) {
+            iter = mod.files.erase(iter);
+          } else {
+            ++iter;
+          }
+        }
+        mod.files.erase(directory);
+      }
+    } break;
+    case 6: {
+      addDirectory(mod.files, randomCase(DIRECTORIES[m_Random() % NUM_DIRECTORIES]));
+    } break;
+  }
+}
+
+std::vector<int> RandomSetup::mutate()
+{
+  std::vector<int> result;
+  int numChanged = std::uniform_int_distribution<int>(1, 3)(m_Random);
+  for (int i = 0; i < numChanged; ++i) {
+    result.push_back(m_Random() % m_Mods.size());
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+
+  for (int mod : result) {
+    int numChanges = std::uniform_int_distribution<int>(1, 4)(m_Random);
+    for (int i = 0; i < numChanges; ++i) {
+      changeMod(m_Mods[mod]);
+    }
+  }
+  return result;
+}
+
+// entries of a directory and all directories below it, in the order a directory scan lists them
+static void scanListing(const RandomMod::Listing &listing, const std::wstring &path,
+                        std::vector<OriginScan::Entry> &entries)
+{
+  for (const auto &file : listing.find(path)->second) {
+    entries.push_back({ OriginScan::ENTRY_FILE, file.first, file.second });
+  }
+  for (const auto &directory : listing) {
+    if (!directory.first.empty() && foldedEqual(parentOf(directory.first), path)) {
+      entries.push_back({ OriginScan::ENTRY_DIRECTORY, lastComponent(directory.first), DIRECTORY_TIME });
+      scanListing(listing, directory.first, entries);
+      entries.push_back({ OriginScan::ENTRY_END_DIRECTORY, std::wstring(), DIRECTORY_TIME });
+    }
+  }
+}
+
+OriginScan RandomSetup::scanFiles(int mod) const
+{
+  std::vector<OriginScan::Entry> entries;
+  scanListing(m_Mods[mod].files, std::wstring(), entries);
+  OriginScan result;
+  result.restore(false, DIRECTORY_TIME, 0, std::move(entries));
+  return result;
+}
+
+OriginScan RandomSetup::scanArchive(int mod) const
+{
+  // folders in archives aren't nested, each one holds its full path
+  std::vector<OriginScan::Entry> entries;
+  for (const auto &directory : m_Mods[mod].archive) {
+    if (!directory.second.empty()) {
+      entries.push_back({ OriginScan::ENTRY_DIRECTORY, directory.first, DIRECTORY_TIME });
+      for (const auto &file : directory.second) {
+        entries.push_back({ OriginScan::ENTRY_FILE, file.first, file.second });
+      }
+      entries.push_back({ OriginScan::ENTRY_END_DIRECTORY, std::wstring(), DIRECTORY_TIME });
+    }
+  }
+  OriginScan result;
+  result.restore(true, DIRECTORY_TIME, 0, std::move(entries));
+  return result;
+}
+
+void RandomSetup::addMod(DirectoryEntry *structure, int mod, int priority) const
+{
+  std::wstring directory = L"C:\\mods\\" + m_Mods[mod].name;
+  structure->addFromOrigin(m_Mods[mod].name, directory, priority, scanFiles(mod));
+  if (m_Mods[mod].hasArchive) {
+    structure->addFromBSA(m_Mods[mod].name, directory, directory + L"\\" + m_Mods[mod].name + L".bsa",
+                          priority, mod, scanArchive(mod));
+  }
+}
+
+DirectoryEntry *RandomSetup::build() const
+{
+  std::vector<int> priorities;
+  for (int mod = 0; mod < static_cast<int>(m_Mods.size()); ++mod) {
+    priorities.push_back(mod + 1);
+  }
+  return build(priorities);
+}
+
+DirectoryEntry *RandomSetup::build(const std::vector<int> &priorities) const
+{
+  // the data directory is origin 0 as in DirectoryRefresher, it doesn't provide any files here
+  DirectoryEntry *result = new DirectoryEntry(L"data", nullptr, 0);
+  result->addFromOrigin(L"data", std::wstring(), 0, OriginScan());
+  for (int mod = 0; mod < static_cast<int>(m_Mods.size()); ++mod) {
+    addMod(result, mod, priorities[mod]);
+  }
+  return result;
+}
+
+
+static std::wstring describeOrigin(const DirectoryEntry &structure, int origin,
+                                   const FileEntry::ArchiveInfo &archive, FILETIME fileTime)
+{
+  std::wostringstream stream;
+  stream << structure.getOriginByID(origin).getName();
+  if (archive.first != StringPool::EMPTY) {
+    stream << L" in " << folded(structure.getStringPool().get(archive.first)) << L" (" << archive.second << L")";
+  }
+  stream << L" at " << ((static_cast<unsigned long long>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime);
+  return stream.str();
+}
+
+// one line per directory and file, sorted
+static void describe(const DirectoryEntry &structure, const DirectoryEntry &directory, const std::wstring &path,
+                     const std::vector<std::wstring> &modNames, std::vector<std::wstring> &lines)
+{
+  // folders created from archive paths may also record -1, depending on which origin created the
+  // folder first. It doesn't stand for an origin and isn't compared
+  std::wstring line = L"directory " + folded(path) + L":";
+  for (const std::wstring &name : modNames) {
+    if (structure.originExists(name) && directory.hasContentsFromOrigin(structure.getOriginByName(name).getID())) {
+      line += L" " + name;
+    }
+  }
+  lines.push_back(line);
+
+  directory.forEachFile([&] (const FileEntry &file) -> bool {
+    std::wstring line = L"file " + folded(path + L"\\" + file.getName().str()) + L": "
+                      + describeOrigin(structure, file.getOrigin(), file.getArchive(), file.getFileTime());
+    for (const FileEntry::AlternativeInfo &alternative : file.getAlternatives()) {
+      line += L", over " + describeOrigin(structure, alternative.first, alternative.second, alternative.fileTime);
+    }
+    lines.push_back(line);
+    return true;
+  });
+
+  directory.forEachSubDirectory([&] (const DirectoryEntry &subDirectory) -> bool {
+    describe(structure, subDirectory, path + L"\\" + subDirectory.getName().str(), modNames, lines);
+    return true;
+  });
+}
+
+bool compareStructures(const DirectoryEntry &expected, const DirectoryEntry &actual,
+                       const std::vector<std::wstring> &modNames, const std::string &context)
+{
+  std::vector<std::wstring> expectedLines;
+  describe(expected, expected, std::wstring(), modNames, expectedLines);
+  std::sort(expectedLines.begin(), expectedLines.end());
+  std::vector<std::wstring> actualLines;
+  describe(actual, actual, std::wstring(), modNames, actualLines);
+  std::sort(actualLines.begin(), actualLines.end());
+
+  auto mismatch = std::mismatch(expectedLines.begin(), expectedLines.end(), actualLines.begin(), actualLines.end());
+  if (mismatch.first == expectedLines.end() && mismatch.second == actualLines.end()) {
+    return true;
+  }
+  std::string expectedLine = mismatch.first != expectedLines.end() ? ToString(*mismatch.first, true) : "nothing";
+  std::string actualLine = mismatch.second != actualLines.end() ? ToString(*mismatch.second, true) : "nothing";
+  fail(context + ": expected \"" + expectedLine + "\", got \"" + actualLine + "\"");
+  return false;
+}
+
+
+} // namespace MOBenchmark
@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RANDOMSETUP_H
+#define RANDOMSETUP_H
+
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "directoryentry.h"
+
+
+namespace MOBenchmark {
+
+
+// orders names the way the directory structure compares them
+struct FoldedLess
+{
+  bool operator()(const std::wstring &lhs, const std::wstring &rhs) const;
+};
+
+
+/**
+ * @brief files of a mod in the randomized checks. Files and directories are drawn from a small
+ *        set of names so most of them conflict, and the case of the names varies between mods
+ */
+struct RandomMod
+{
+  typedef std::map<std::wstring, FILETIME, FoldedLess> Files;
+  // relative path of a directory ("" for the top level) to the files in it. Directories on the way
+  // to a listed directory are listed as well, possibly without files
+  typedef std::map<std::wstring, Files, FoldedLess> Listing;
+
+  std::wstring name;
+  Listing files;
+  bool hasArchive;
+  // contents of the archive of the mod, the archive is named after the mod
+  Listing archive;
+};
+
+
+/**
+ * @brief a list of mods with random contents, for checks that compare ways of producing the same
+ *        directory structure. The same seed always produces the same setup and changes
+ */
+class RandomSetup
+{
+
+public:
+
+  RandomSetup(int mods, unsigned int seed);
+
+  const std::vector<RandomMod> &mods() const { return m_Mods; }
+  std::vector<std::wstring> modNames() const;
+
+  /**
+   * @brief change a few mods: add, remove and touch files, add or remove archives and directories
+   * @return indices of the changed mods, ascending
+   */
+  std::vector<int> mutate();
+
+  // listing of the loose files of a mod, as if the mod directory had been scanned
+  MOShared::OriginScan scanFiles(int mod) const;
+  // listing of the archive of a mod
+  MOShared::OriginScan scanArchive(int mod) const;
+
+  // add the loose files and the archive of a mod the way DirectoryRefresher does
+  void addMod(MOShared::DirectoryEntry *structure, int mod, int priority) const;
+
+  // build a new structure from all mods, the first mod has the lowest priority
+  MOShared::DirectoryEntry *build() const;
+
+  // build a new structure from all mods, with the priority of each mod given by index. The mods are
+  // still added in the order of their index
+  MOShared::DirectoryEntry *build(const std::vector<int> &priorities) const;
+
+private:
+
+  std::wstring randomCase(const std::wstring &name);
+  FILETIME randomTime();
+  void addDirectory(RandomMod::Listing &listing, const std::wstring &path);
+  void addFile(RandomMod::Listing &listing, bool archive);
+  void fillArchive(RandomMod &mod);
+  void changeMod(RandomMod &mod);
+
+private:
+
+  std::mt19937 m_Random;
+  std::vector<RandomMod> m_Mods;
+
+};
+
+
+/**
+ * @brief compare two structures: directories with the origins that provide them and files with
+ *        all their origins, archives and file times. Names are compared without regard to case
+ *        and origins by name, so the structures may have been built in different ways
+ * @param modNames names of all origins that may be in the structures
+ * @param context printed with the first difference if there is one
+ * @return true if the structures are equal, otherwise the difference is reported with fail()
+ */
+bool compareStructures(const MOShared::DirectoryEntry &expected, const MOShared::DirectoryEntry &actual,
+                       const std::vector<std::wstring> &modNames, const std::string &context);
+
+
+} // namespace MOBenchmark
+
+#endif // RANDOMSETUP_H
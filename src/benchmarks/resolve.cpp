@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "synthetic.h"
+#include <cwctype>
+#include <memory>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const size_t NUM_PATHS = 100000;
+
+
+static double nsPerPath(const std::vector<std::wstring> &paths, bool expectFound,
+                        FileEntry::Ptr (*resolve)(const DirectoryEntry &structure, const std::wstring &path),
+                        const DirectoryEntry &structure)
+{
+  size_t found = 0;
+  double duration = fastestOf(5, [&] () {
+    found = 0;
+    for (const std::wstring &path : paths) {
+      if (resolve(structure, path).get() != nullptr) {
+        ++found;
+      }
+    }
+  });
+  if (found != (expectFound ? paths.size() : 0)) {
+    fail("resolved " + std::to_string(found) + " of " + std::to_string(paths.size()) + " paths");
+  }
+  return duration * 1000000.0 / paths.size();
+}
+
+static FileEntry::Ptr searchTree(const DirectoryEntry &structure, const std::wstring &path)
+{
+  return structure.searchFile(path, nullptr);
+}
+
+static FileEntry::Ptr findByPath(const DirectoryEntry &structure, const std::wstring &path)
+{
+  return const_cast<DirectoryEntry&>(structure).getFileRegister()->findByPath(path.c_str(), path.length());
+}
+
+
+MO_BENCHMARK(path_resolve)
+{
+  // about a million files, random paths the way plugins ask for them one by one
+  SyntheticSetup setup(scaled(500), 20, 100);
+  std::unique_ptr<DirectoryEntry> structure(buildStructure(setup));
+  boost::shared_ptr<FileRegister> files = structure->getFileRegister();
+
+  std::vector<std::wstring> hits = samplePaths(setup, NUM_PATHS, true);
+  std::vector<std::wstring> upperHits;
+  for (std::wstring path : hits) {
+    for (wchar_t &ch : path) {
+      ch = towupper(ch);
+    }
+    upperHits.push_back(path);
+  }
+  std::vector<std::wstring> misses = samplePaths(setup, NUM_PATHS, false);
+
+  // searchFile walks the tree one component at a time as long as there is no path index
+  std::string prefix = "  " + std::to_string(NUM_PATHS) + " paths, ";
+  double walkHit = nsPerPath(hits, true, &searchTree, *structure);
+  double walkUpper = nsPerPath(upperHits, true, &searchTree, *structure);
+  double walkMiss = nsPerPath(misses, false, &searchTree, *structure);
+
+  size_t allocatedBefore = allocatedBytes();
+  Timer timer;
+  files->setPathIndexEnabled(true);
+  double indexDuration = timer.elapsedMs();
+  size_t allocated = allocatedBytes() - allocatedBefore;
+
+  std::string filesPrefix = "  " + std::to_string(files->size()) + " files, ";
+  report(filesPrefix + "build path index", indexDuration, "ms");
+  report(filesPrefix + "path index memory per file", static_cast<double>(allocated) / files->size(), "bytes");
+
+  report(prefix + "hit, tree walk", walkHit, "ns/path");
+  report(prefix + "hit, path index", nsPerPath(hits, true, &findByPath, *structure), "ns/path");
+  report(prefix + "hit, other case, tree walk", walkUpper, "ns/path");
+  report(prefix + "hit, other case, path index", nsPerPath(upperHits, true, &findByPath, *structure), "ns/path");
+  report(prefix + "miss, tree walk", walkMiss, "ns/path");
+  report(prefix + "miss, path index", nsPerPath(misses, false, &findByPath, *structure), "ns/path");
+}
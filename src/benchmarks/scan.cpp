@@ -0,0 +1,175 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "synthetic.h"
+#include "randomsetup.h"
+#include "directoryrefresher.h"
+#include <utility.h>
+#include <QDir>
+#include <QFile>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+
+using namespace MOBase;
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+/**
+ * hand the mods of the setup to the refresher
+ * @return the load order of the plugins the archives belong to
+ */
+static QStringList setMods(DirectoryRefresher &refresher, const SyntheticSetup &setup,
+                           const std::vector<std::wstring> &modDirectories)
+{
+  std::vector<std::tuple<QString, QString, QStringList> > mods;
+  std::set<QString> archives;
+  QStringList loadOrder;
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    QString path = QDir::fromNativeSeparators(ToQString(modDirectories[mod]));
+    QStringList modArchives;
+    if (setup.archiveFiles > 0) {
+      modArchives.append(path + "/" + ToQString(archiveName(mod)));
+      archives.insert(ToQString(archiveName(mod)));
+    }
+    mods.push_back(std::make_tuple(ToQString(modName(mod)), path, modArchives));
+    loadOrder.append(ToQString(modName(mod)) + ".esp");
+  }
+  refresher.setMods(mods, archives, QString());
+  return loadOrder;
+}
+
+
+/**
+ * build the structure of the setup with DirectoryRefresher, the way a refresh in the application
+ * does. With one thread the refresher adds the mods one after the other (refreshSerial), otherwise
+ * workers scan while the refresher merges (refreshParallel)
+ * @param snapshot if false the snapshot of the previous run is deleted so every mod and archive
+ *                 is read from disk
+ * @return number of files in the structure
+ */
+static size_t refresh(const SyntheticSetup &setup, const std::vector<std::wstring> &modDirectories,
+                      int threadCount, bool snapshot)
+{
+  QString base = ToQString(setupDirectory(setup, tempDirectory()));
+  QString snapshotPath = base + "/snapshot.dat";
+  if (!snapshot) {
+    QFile::remove(snapshotPath);
+  }
+
+  DirectoryRefresher refresher;
+  QStringList loadOrder = setMods(refresher, setup, modDirectories);
+  refresher.setThreadCount(threadCount);
+  refresher.refresh(setupDirectory(setup, tempDirectory()) + L"\\data", snapshotPath, loadOrder);
+  std::unique_ptr<DirectoryEntry> structure(refresher.getDirectoryStructure());
+  return structure->getFileRegister()->size();
+}
+
+
+MO_BENCHMARK(refresh_scan)
+{
+  SyntheticSetup setup(scaled(200), 20, 25, 30, 200);
+  std::vector<std::wstring> modDirectories = writeSetup(setup, tempDirectory());
+
+  // warm up the file system cache, the measurements compare the processing, not the disk
+  size_t files = refresh(setup, modDirectories, 1, false);
+
+  std::ostringstream prefix;
+  prefix << "  " << setup.mods << " mods with archives, " << files << " files, ";
+  std::ostringstream parallel;
+  parallel << threadCount() << " threads";
+
+  report(prefix.str() + "1 thread",
+         fastestOf(3, [&] () { refresh(setup, modDirectories, 1, false); }), "ms");
+  report(prefix.str() + parallel.str(),
+         fastestOf(3, [&] () { refresh(setup, modDirectories, threadCount(), false); }), "ms");
+
+  // the listings of the previous run are taken from the snapshot
+  report(prefix.str() + "from snapshot, 1 thread",
+         fastestOf(3, [&] () { refresh(setup, modDirectories, 1, true); }), "ms");
+  report(prefix.str() + "from snapshot, " + parallel.str(),
+         fastestOf(3, [&] () { refresh(setup, modDirectories, threadCount(), true); }), "ms");
+}
+
+
+MO_BENCHMARK(refresh_edit_in_place)
+{
+  SyntheticSetup setup(scaled(50), 6, 20, 30, 50);
+  std::vector<std::wstring> modDirectories = writeSetup(setup, tempDirectory());
+  std::wstring dataDirectory = setupDirectory(setup, tempDirectory()) + L"\\data";
+  QString snapshotPath = ToQString(setupDirectory(setup, tempDirectory())) + "/snapshot.dat";
+  QFile::remove(snapshotPath);
+
+  DirectoryRefresher refresher;
+  QStringList loadOrder = setMods(refresher, setup, modDirectories);
+  refresher.refresh(dataDirectory, snapshotPath, loadOrder);
+  std::unique_ptr<DirectoryEntry> structure(refresher.getDirectoryStructure());
+
+  // a file saved in place gets a new modification time, the time of its directory stays the same
+  FILETIME now;
+  ::GetSystemTimeAsFileTime(&now);
+  int edited = 0;
+  for (int mod = 0; mod < setup.mods; mod += 7) {
+    std::wstring path = modDirectories[mod] + L"\\" + directoryName(mod % setup.directoriesPerMod)
+                        + L"\\" + fileName(setup, mod, mod % setup.directoriesPerMod, 0);
+    HANDLE file = ::CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES, 0, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if ((file == INVALID_HANDLE_VALUE) || !::SetFileTime(file, nullptr, nullptr, &now)) {
+      fail("failed to change the time of " + ToString(path, true));
+    }
+    ::CloseHandle(file);
+    ++edited;
+  }
+
+  Timer timer;
+  refresher.refresh(dataDirectory, snapshotPath, loadOrder);
+  std::unique_ptr<DirectoryEntry> rebuilt(refresher.getDirectoryStructure());
+  if (rebuilt.get() != nullptr) {
+    fail("the refresh after editing files built a new structure instead of an update");
+  }
+  DirectoryEntry *updated = nullptr;
+  refresher.applyIncrementalUpdate(structure.get(), updated);
+  double elapsed = timer.elapsedMs();
+  if (updated == nullptr) {
+    fail("the refresh after editing files didn't change the structure");
+  } else {
+    structure.reset(updated);
+  }
+
+  // the same setup read from disk without a snapshot
+  QFile::remove(snapshotPath);
+  DirectoryRefresher fullRefresher;
+  loadOrder = setMods(fullRefresher, setup, modDirectories);
+  fullRefresher.refresh(dataDirectory, snapshotPath, loadOrder);
+  std::unique_ptr<DirectoryEntry> expected(fullRefresher.getDirectoryStructure());
+
+  std::vector<std::wstring> names(1, L"data");
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    names.push_back(modName(mod));
+  }
+  compareStructures(*expected, *structure, names, "files edited in place");
+
+  std::ostringstream label;
+  label << "  " << setup.mods << " mods, " << edited << " files edited, incremental refresh";
+  report(label.str(), elapsed, "ms");
+}
@@ -0,0 +1,127 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "synthetic.h"
+#include "stringpool.h"
+#include "util.h"
+#include <cwchar>
+#include <deque>
+#include <memory>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+namespace {
+
+// the pool the way it was before the names were stored in blocks: each name and its lower case
+// form as separate strings
+class StringPoolBefore
+{
+
+public:
+
+  StringPoolBefore() { m_Entries.push_back(Entry()); }
+
+  StringPool::Handle intern(const std::wstring &name)
+  {
+    const StringPool::Handle *handle = m_Index.findIf(name.c_str(), name.length(), [&] (StringPool::Handle candidate) {
+      return m_Entries[candidate].name == name;
+    });
+    if (handle != nullptr) {
+      return *handle;
+    }
+    StringPool::Handle result = static_cast<StringPool::Handle>(m_Entries.size());
+    m_Entries.push_back(Entry());
+    m_Entries.back().name = name;
+    m_Entries.back().lowered = ToLower(name);
+    m_Index.insert(name.c_str(), name.length(), result);
+    return result;
+  }
+
+private:
+
+  struct Entry {
+    std::wstring name;
+    std::wstring lowered;
+  };
+
+  std::deque<Entry> m_Entries;
+  NameIndex<StringPool::Handle> m_Index;
+
+};
+
+}
+
+
+// memory of a pool containing the names, in bytes
+template <typename Pool>
+static size_t poolMemory(const std::vector<std::wstring> &names, double &duration)
+{
+  size_t before = allocatedBytes();
+  Timer timer;
+  std::unique_ptr<Pool> pool(new Pool);
+  for (const std::wstring &name : names) {
+    pool->intern(name);
+  }
+  duration = timer.elapsedMs();
+  return allocatedBytes() - before;
+}
+
+
+MO_BENCHMARK(string_pool)
+{
+  // the distinct names of a large setup: files, directories and the relative paths of directories
+  SyntheticSetup setup(scaled(1000), 20, 100);
+  std::vector<std::wstring> names;
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    for (int directory = 0; directory < setup.directoriesPerMod; ++directory) {
+      for (int file = 0; file < setup.filesPerDirectory; ++file) {
+        names.push_back(fileName(setup, mod, directory, file));
+      }
+    }
+  }
+  for (int directory = 0; directory < setup.directoriesPerMod; ++directory) {
+    std::wstring path = directoryName(directory);
+    names.push_back(path.substr(path.find(L'\\') + 1));
+    names.push_back(L"\\" + path);
+  }
+
+  StringPool distinct;
+  for (const std::wstring &name : names) {
+    distinct.intern(name);
+  }
+  size_t count = distinct.size();
+  size_t characters = 0;
+  for (StringPool::Handle handle = 0; handle < count; ++handle) {
+    characters += distinct.get(handle).length();
+  }
+
+  std::string prefix = "  " + std::to_string(count) + " names, "
+                     + std::to_string(characters / count) + " characters on average, ";
+  double duration = 0.0;
+  size_t memory = poolMemory<StringPool>(names, duration);
+  report(prefix + "blocks, memory per name", static_cast<double>(memory) / count, "bytes");
+  report(prefix + "blocks, intern", duration * 1000000.0 / names.size(), "ns/name");
+  memory = poolMemory<StringPoolBefore>(names, duration);
+  report(prefix + "two strings, memory per name", static_cast<double>(memory) / count, "bytes");
+  report(prefix + "two strings, intern", duration * 1000000.0 / names.size(), "ns/name");
+}
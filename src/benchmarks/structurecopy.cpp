@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "randomsetup.h"
+#include "synthetic.h"
+#include <memory>
+#include <sstream>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int NUM_MODS = 12;
+static const int UPDATES_PER_SETUP = 5;
+
+
+// the changes the organizer makes to a copy of the published structure, see incremental.cpp
+static void applyUpdate(const RandomSetup &setup, const std::vector<int> &changed, DirectoryEntry *structure)
+{
+  for (int mod : changed) {
+    const std::wstring &name = setup.mods()[mod].name;
+    if (structure->originExists(name)) {
+      FilesOrigin &origin = structure->getOriginByName(name);
+      origin.enable(false);
+      structure->pruneOrigin(origin.getID());
+    }
+  }
+  for (int mod : changed) {
+    setup.addMod(structure, mod, mod + 1);
+  }
+}
+
+
+// every file of the copy has to refer to a directory of the copy, not to the one it was copied from
+static bool parentsInTree(const DirectoryEntry &structure)
+{
+  return structure.walk([] (const DirectoryEntry &directory) -> bool {
+    return directory.forEachFile([&] (const FileEntry &file) -> bool {
+      return file.getParent() == &directory;
+    });
+  });
+}
+
+
+MO_BENCHMARK(structure_copy)
+{
+  // the organizer changes a copy of the structure while other threads may still read the previous
+  // one. Each copy is changed and compared with a new build, the structure it was copied from has
+  // to remain as it was
+  int numSetups = scaled(50);
+  int numCopies = 0;
+  for (int seed = 0; seed < numSetups; ++seed) {
+    RandomSetup setup(NUM_MODS, seed);
+    std::unique_ptr<DirectoryEntry> structure(setup.build());
+    structure->getFileRegister()->conflictGraph();
+    for (int update = 0; update < UPDATES_PER_SETUP; ++update) {
+      std::string context = "seed " + std::to_string(seed) + ", update " + std::to_string(update);
+      std::unique_ptr<DirectoryEntry> copy(structure->clone());
+      ++numCopies;
+      if (!compareStructures(*structure, *copy, setup.modNames(), context + ", copy")) {
+        break;
+      }
+      if (!parentsInTree(*copy)) {
+        fail(context + ": files of the copy refer to the original directories");
+        break;
+      }
+
+      RandomSetup previous = setup;
+      std::vector<int> changed = setup.mutate();
+      applyUpdate(setup, changed, copy.get());
+      std::unique_ptr<DirectoryEntry> expected(setup.build());
+      std::unique_ptr<DirectoryEntry> unchanged(previous.build());
+      if (!compareStructures(*expected, *copy, setup.modNames(), context + ", changed copy")
+          || !compareStructures(*unchanged, *structure, setup.modNames(), context + ", original")) {
+        break;
+      }
+      structure = std::move(copy);
+    }
+  }
+  report("  copies changed and compared with a full build", numCopies, "copies");
+
+  // cost of the copy the first change after a structure was published makes
+  SyntheticSetup synthetic(scaled(1000), 10, 20, 10);
+  std::unique_ptr<DirectoryEntry> built;
+  std::ostringstream prefix;
+  prefix << "  " << synthetic.mods << " mods, " << synthetic.fileCount() << " files, ";
+  report(prefix.str() + "build",
+         fastestOf(3, [&] () { built.reset(buildStructure(synthetic)); }), "ms");
+  built->getFileRegister()->conflictGraph();
+  std::unique_ptr<DirectoryEntry> copy;
+  report(prefix.str() + "copy",
+         fastestOf(3, [&] () { copy.reset(built->clone()); }), "ms");
+}
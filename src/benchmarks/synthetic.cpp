@@ -0,0 +1,329 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "synthetic.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+
+using namespace MOShared;
+
+
+namespace MOBenchmark {
+
+
+static const wchar_t *TOP_LEVEL[] = { L"textures", L"meshes", L"scripts", L"sound" };
+static const wchar_t *EXTENSIONS[] = { L".dds", L".nif", L".pex", L".wav" };
+static const int NUM_TOP_LEVEL = 4;
+
+static const FILETIME FILE_TIME = { 0x12345678, 0x01d00000 };
+
+// cheap deterministic mixing so the setup is the same on every run
+static unsigned int mix(unsigned int a, unsigned int b, unsigned int c)
+{
+  unsigned int hash = a * 0x9e3779b1U ^ b * 0x85ebca77U ^ c * 0xc2b2ae3dU;
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6dU;
+  hash ^= hash >> 12;
+  return hash;
+}
+
+std::wstring modName(int mod)
+{
+  std::wostringstream stream;
+  stream << L"Mod " << mod;
+  return stream.str();
+}
+
+std::wstring directoryName(int directory)
+{
+  std::wostringstream stream;
+  stream << TOP_LEVEL[directory % NUM_TOP_LEVEL] << L"\\group" << directory;
+  return stream.str();
+}
+
+std::wstring fileName(const SyntheticSetup &setup, int mod, int directory, int file)
+{
+  std::wostringstream stream;
+  if (static_cast<int>(mix(mod, directory, file) % 100) < setup.overlap) {
+    stream << L"Shared_" << file;
+  } else {
+    stream << L"Mod" << mod << L"_" << file;
+  }
+  stream << EXTENSIONS[directory % NUM_TOP_LEVEL];
+  return stream.str();
+}
+
+std::wstring archiveName(int mod)
+{
+  return modName(mod) + L".bsa";
+}
+
+// files in the archive of a mod. They are spread over the same directories as the loose files and
+// continue their numbering so shared ones conflict with the archives of other mods
+static std::vector<std::wstring> archiveContents(const SyntheticSetup &setup, int mod)
+{
+  std::vector<std::wstring> result;
+  for (int i = 0; i < setup.archiveFiles; ++i) {
+    int directory = i % setup.directoriesPerMod;
+    int file = setup.filesPerDirectory + i / setup.directoriesPerMod;
+    result.push_back(directoryName(directory) + L"\\" + fileName(setup, mod, directory, file));
+  }
+  return result;
+}
+
+// name hash of the tes4 archive format
+static uint64_t archiveHash(const std::string &name)
+{
+  size_t dot = name.find_last_of('.');
+  std::string root = name.substr(0, dot);
+  std::string extension = dot != std::string::npos ? name.substr(dot) : std::string();
+  size_t length = root.size();
+
+  uint32_t low = 0;
+  if (length > 0) {
+    low = static_cast<unsigned char>(root[length - 1])
+        | ((length > 2) ? static_cast<unsigned char>(root[length - 2]) << 8 : 0)
+        | static_cast<uint32_t>(length) << 16
+        | static_cast<uint32_t>(static_cast<unsigned char>(root[0])) << 24;
+  }
+  if (extension == ".kf") {
+    low |= 0x80;
+  } else if (extension == ".nif") {
+    low |= 0x8000;
+  } else if (extension == ".dds") {
+    low |= 0x8080;
+  } else if (extension == ".wav") {
+    low |= 0x80000000;
+  }
+
+  uint32_t high = 0;
+  for (size_t i = 1; i + 2 < length; ++i) {
+    high = high * 0x1003f + static_cast<unsigned char>(root[i]);
+  }
+  uint32_t extensionHash = 0;
+  for (char ch : extension) {
+    extensionHash = extensionHash * 0x1003f + static_cast<unsigned char>(ch);
+  }
+  high += extensionHash;
+  return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+// write an uncompressed archive (version 104, as used by skyrim) containing empty files
+static void writeArchive(const std::wstring &path, const std::vector<std::wstring> &files)
+{
+  struct File {
+    uint64_t hash;
+    std::string name;
+  };
+  struct Folder {
+    uint64_t hash;
+    std::string name;
+    std::vector<File> files;
+  };
+
+  std::map<std::string, std::vector<File>> byFolder;
+  for (const std::wstring &file : files) {
+    std::string lowered = ToString(file, false);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+    size_t separator = lowered.find_last_of('\\');
+    std::string name = lowered.substr(separator + 1);
+    byFolder[lowered.substr(0, separator)].push_back({ archiveHash(name), name });
+  }
+
+  std::vector<Folder> folders;
+  uint32_t folderNamesLength = 0;
+  uint32_t fileNamesLength = 0;
+  for (auto &folder : byFolder) {
+    std::sort(folder.second.begin(), folder.second.end(),
+              [] (const File &lhs, const File &rhs) { return lhs.hash < rhs.hash; });
+    folderNamesLength += static_cast<uint32_t>(folder.first.size()) + 1;
+    for (const File &file : folder.second) {
+      fileNamesLength += static_cast<uint32_t>(file.name.size()) + 1;
+    }
+    folders.push_back({ archiveHash(folder.first), folder.first, folder.second });
+  }
+  std::sort(folders.begin(), folders.end(),
+            [] (const Folder &lhs, const Folder &rhs) { return lhs.hash < rhs.hash; });
+
+  std::string buffer;
+  auto write32 = [&buffer] (uint32_t value) { buffer.append(reinterpret_cast<const char*>(&value), 4); };
+  auto write64 = [&buffer] (uint64_t value) { buffer.append(reinterpret_cast<const char*>(&value), 8); };
+
+  // header: magic, version, offset of the folder records, archive flags (folder and file names
+  // included), folder count, file count, length of all folder names and of all file names, file flags
+  buffer.append("BSA", 4);
+  write32(104);
+  write32(36);
+  write32(0x3);
+  write32(static_cast<uint32_t>(folders.size()));
+  write32(static_cast<uint32_t>(files.size()));
+  write32(folderNamesLength);
+  write32(fileNamesLength);
+  write32(0);
+
+  // the offsets in the folder records point behind the file names (including their length)
+  uint32_t fileRecordsOffset = static_cast<uint32_t>(36 + folders.size() * 16) + fileNamesLength;
+  for (const Folder &folder : folders) {
+    write64(folder.hash);
+    write32(static_cast<uint32_t>(folder.files.size()));
+    write32(fileRecordsOffset);
+    fileRecordsOffset += static_cast<uint32_t>(folder.name.size() + 2 + folder.files.size() * 16);
+  }
+
+  // all files are empty so they all point at the end of the archive
+  uint32_t dataOffset = fileRecordsOffset;
+  for (const Folder &folder : folders) {
+    buffer.push_back(static_cast<char>(folder.name.size() + 1));
+    buffer.append(folder.name.c_str(), folder.name.size() + 1);
+    for (const File &file : folder.files) {
+      write64(file.hash);
+      write32(0);
+      write32(dataOffset);
+    }
+  }
+  for (const Folder &folder : folders) {
+    for (const File &file : folder.files) {
+      buffer.append(file.name.c_str(), file.name.size() + 1);
+    }
+  }
+
+  FILE *archive = _wfopen(path.c_str(), L"wb");
+  if (archive == nullptr) {
+    throw std::runtime_error("failed to create " + ToString(path, true));
+  }
+  fwrite(buffer.data(), 1, buffer.size(), archive);
+  fclose(archive);
+}
+
+OriginScan scanMod(const SyntheticSetup &setup, int mod)
+{
+  std::vector<OriginScan::Entry> entries;
+  if (setup.archiveFiles > 0) {
+    entries.push_back({ OriginScan::ENTRY_FILE, archiveName(mod), FILE_TIME });
+  }
+  for (int top = 0; top < NUM_TOP_LEVEL; ++top) {
+    if (top >= setup.directoriesPerMod) {
+      break;
+    }
+    entries.push_back({ OriginScan::ENTRY_DIRECTORY, TOP_LEVEL[top], FILE_TIME });
+    for (int directory = top; directory < setup.directoriesPerMod; directory += NUM_TOP_LEVEL) {
+      std::wostringstream name;
+      name << L"group" << directory;
+      entries.push_back({ OriginScan::ENTRY_DIRECTORY, name.str(), FILE_TIME });
+      for (int file = 0; file < setup.filesPerDirectory; ++file) {
+        entries.push_back({ OriginScan::ENTRY_FILE, fileName(setup, mod, directory, file), FILE_TIME });
+      }
+      entries.push_back({ OriginScan::ENTRY_END_DIRECTORY, std::wstring(), FILE_TIME });
+    }
+    entries.push_back({ OriginScan::ENTRY_END_DIRECTORY, std::wstring(), FILE_TIME });
+  }
+
+  OriginScan result;
+  result.restore(false, FILE_TIME, 0, std::move(entries));
+  return result;
+}
+
+DirectoryEntry *buildStructure(const SyntheticSetup &setup)
+{
+  DirectoryEntry *result = new DirectoryEntry(L"data", nullptr, 0);
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    result->addFromOrigin(modName(mod), L"C:\\mods\\" + modName(mod), mod + 1, scanMod(setup, mod));
+  }
+  return result;
+}
+
+std::vector<std::wstring> samplePaths(const SyntheticSetup &setup, size_t count, bool existing)
+{
+  std::vector<std::wstring> result;
+  result.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    int mod = mix(static_cast<unsigned int>(i), 1, 0) % setup.mods;
+    int directory = mix(static_cast<unsigned int>(i), 2, 0) % setup.directoriesPerMod;
+    int file = mix(static_cast<unsigned int>(i), 3, 0) % setup.filesPerDirectory;
+    std::wstring path = directoryName(directory) + L"\\" + fileName(setup, mod, directory, file);
+    if (!existing) {
+      path.append(L".missing");
+    }
+    result.push_back(path);
+  }
+  return result;
+}
+
+std::wstring setupDirectory(const SyntheticSetup &setup, const std::wstring &directory)
+{
+  std::wostringstream stream;
+  stream << directory << L"\\mo_benchmark_" << setup.mods << L"_" << setup.directoriesPerMod
+         << L"_" << setup.filesPerDirectory << L"_" << setup.overlap << L"_" << setup.archiveFiles;
+  return stream.str();
+}
+
+std::vector<std::wstring> writeSetup(const SyntheticSetup &setup, const std::wstring &directory)
+{
+  std::wstring base = setupDirectory(setup, directory);
+
+  std::vector<std::wstring> result;
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    result.push_back(base + L"\\" + modName(mod));
+  }
+
+  // the marker is written last so an interrupted run doesn't leave an incomplete setup behind
+  std::wstring marker = base + L"\\complete";
+  if (::GetFileAttributesW(marker.c_str()) != INVALID_FILE_ATTRIBUTES) {
+    return result;
+  }
+
+  auto createFile = [] (const std::wstring &path) {
+    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error("failed to create " + ToString(path, true));
+    }
+    ::CloseHandle(file);
+  };
+
+  ::CreateDirectoryW(base.c_str(), nullptr);
+  ::CreateDirectoryW((base + L"\\data").c_str(), nullptr);
+  for (int mod = 0; mod < setup.mods; ++mod) {
+    ::CreateDirectoryW(result[mod].c_str(), nullptr);
+    if (setup.archiveFiles > 0) {
+      writeArchive(result[mod] + L"\\" + archiveName(mod), archiveContents(setup, mod));
+    }
+    for (int top = 0; (top < NUM_TOP_LEVEL) && (top < setup.directoriesPerMod); ++top) {
+      ::CreateDirectoryW((result[mod] + L"\\" + TOP_LEVEL[top]).c_str(), nullptr);
+    }
+    for (int directory = 0; directory < setup.directoriesPerMod; ++directory) {
+      std::wstring path = result[mod] + L"\\" + directoryName(directory);
+      ::CreateDirectoryW(path.c_str(), nullptr);
+      for (int file = 0; file < setup.filesPerDirectory; ++file) {
+        createFile(path + L"\\" + fileName(setup, mod, directory, file));
+      }
+    }
+  }
+  createFile(marker);
+  return result;
+}
+
+
+} // namespace MOBenchmark
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+
+#include <string>
+#include <vector>
+#include "directoryentry.h"
+
+
+namespace MOBenchmark {
+
+
+/**
+ * @brief description of a generated mod setup. All mods share the same directory layout
+ *        (textures\group0, meshes\group1, ...), a part of the file names is shared as well so
+ *        mods conflict with each other the way real ones overwrite textures and meshes
+ */
+struct SyntheticSetup
+{
+  int mods;
+  int directoriesPerMod;
+  int filesPerDirectory;
+  // percentage of the files of a mod that other mods provide too
+  int overlap;
+  // number of files in the archive each mod ships, 0 if the mods don't have archives
+  int archiveFiles;
+
+  SyntheticSetup(int mods, int directoriesPerMod, int filesPerDirectory, int overlap = 30, int archiveFiles = 0)
+    : mods(mods), directoriesPerMod(directoriesPerMod), filesPerDirectory(filesPerDirectory), overlap(overlap)
+    , archiveFiles(archiveFiles)
+  {}
+
+  size_t fileCount() const {
+    return static_cast<size_t>(mods) * directoriesPerMod * filesPerDirectory;
+  }
+};
+
+
+// name of a mod in the setup
+std::wstring modName(int mod);
+
+// directory of the specified mod relative to the data directory, without separators around it
+std::wstring directoryName(int directory);
+
+// name of a file in a directory of the specified mod
+std::wstring fileName(const SyntheticSetup &setup, int mod, int directory, int file);
+
+// file name of the archive of a mod, the archive belongs to the plugin "<mod name>.esp"
+std::wstring archiveName(int mod);
+
+// listing of a mod, as if the mod directory had been scanned
+MOShared::OriginScan scanMod(const SyntheticSetup &setup, int mod);
+
+// create a tree containing all mods of the setup, the first mod has the lowest priority
+MOShared::DirectoryEntry *buildStructure(const SyntheticSetup &setup);
+
+/**
+ * @brief relative paths of files in the setup, spread over all mods and directories
+ * @param count number of paths
+ * @param existing if false the file names are changed so the paths don't exist
+ */
+std::vector<std::wstring> samplePaths(const SyntheticSetup &setup, size_t count, bool existing);
+
+/**
+ * @brief write the setup to disk (empty files and uncompressed archives) unless it was written
+ *        before. Next to the mods an empty data directory is created
+ * @return mod directories, in priority order
+ */
+std::vector<std::wstring> writeSetup(const SyntheticSetup &setup, const std::wstring &directory);
+
+// directory writeSetup puts the mods and the data directory in
+std::wstring setupDirectory(const SyntheticSetup &setup, const std::wstring &directory);
+
+
+} // namespace MOBenchmark
+
+#endif // SYNTHETIC_H
@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+#include "synthetic.h"
+#include "directoryrefresher.h"
+#include <memory>
+#include <sstream>
+
+
+using namespace MOShared;
+using namespace MOBenchmark;
+
+
+static const int REPEAT = 3;
+
+
+MO_BENCHMARK(structure_swap)
+{
+  // the pause directory_refreshed causes on the main thread when it replaces the structure. A
+  // new tree is built for every run since each way of getting rid of it consumes it
+  SyntheticSetup setup(scaled(500), 20, 100);
+
+  std::ostringstream prefix;
+  prefix << "  " << setup.fileCount() << " files, ";
+
+  double deleted = 0.0;
+  for (int i = 0; i < REPEAT; ++i) {
+    DirectoryEntry *structure = buildStructure(setup);
+    Timer timer;
+    delete structure;
+    double elapsed = timer.elapsedMs();
+    deleted = (i == 0) ? elapsed : std::min(deleted, elapsed);
+  }
+  report(prefix.str() + "delete on the main thread", deleted, "ms");
+
+  // publishStructure hands the previous structure to discardStructure once the last reader
+  // released it, so this is the pause left after the swap
+  double discarded = 0.0;
+  double reclaimed = 0.0;
+  for (int i = 0; i < REPEAT; ++i) {
+    DirectoryEntry *structure = buildStructure(setup);
+    Timer reclaimTimer;
+    {
+      DirectoryRefresher refresher;
+      // the reclaim thread is started by the first discard, that is not part of the swap
+      refresher.discardStructure(new DirectoryEntry(L"data", nullptr, 0));
+      Timer timer;
+      refresher.discardStructure(structure);
+      double elapsed = timer.elapsedMs();
+      discarded = (i == 0) ? elapsed : std::min(discarded, elapsed);
+      reclaimTimer = Timer();
+      // the destructor waits for the reclaim thread to free everything that was queued
+    }
+    double elapsed = reclaimTimer.elapsedMs();
+    reclaimed = (i == 0) ? elapsed : std::min(reclaimed, elapsed);
+  }
+  report(prefix.str() + "discardStructure on the main thread", discarded, "ms");
+  report(prefix.str() + "freed by the reclaim thread", reclaimed, "ms");
+}
@@ -23,13 +23,24 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #include "utility.h"
 #include "report.h"
 #include "modinfo.h"
+#include <appconfig.h>
 
 #include <QApplication>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QString>
 #include <QTextCodec>
+#include <QThread>
+#include <QTime>
 #include <gameplugins.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <thread>
+
 
 using namespace MOBase;
 using namespace MOShared;
@@ -37,14 +48,65 @@ using namespace MOShared;
 
 DirectoryRefresher::DirectoryRefresher()
   : m_DirectoryStructure(nullptr)
+  , m_ThreadCount(0)
+  , m_PathIndexEnabled(true)
+  , m_StructureHash(0ULL)
+  , m_UpdatePending(false)
+  , m_ReclaimStop(false)
 {
 }
 
 DirectoryRefresher::~DirectoryRefresher()
 {
+  if (m_ReclaimThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_ReclaimMutex);
+      m_ReclaimStop = true;
+    }
+    m_ReclaimCondition.notify_one();
+    m_ReclaimThread.join();
+  }
   delete m_DirectoryStructure;
 }
 
+void DirectoryRefresher::discardStructure(DirectoryEntry *structure)
+{
+  if (structure == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_ReclaimMutex);
+    m_DiscardedStructures.push_back(structure);
+    if (!m_ReclaimThread.joinable()) {
+      m_ReclaimThread = std::thread(&DirectoryRefresher::reclaimStructures, this);
+    }
+  }
+  m_ReclaimCondition.notify_one();
+}
+
+void DirectoryRefresher::reclaimStructures()
+{
+  std::unique_lock<std::mutex> lock(m_ReclaimMutex);
+  for (;;) {
+    m_ReclaimCondition.wait(lock, [this] () { return m_ReclaimStop || !m_DiscardedStructures.empty(); });
+    // structures still queued on shutdown are deleted too
+    std::vector<DirectoryEntry*> structures;
+    structures.swap(m_DiscardedStructures);
+    bool stop = m_ReclaimStop;
+    lock.unlock();
+    for (DirectoryEntry *structure : structures) {
+      QTime time;
+      time.start();
+      delete structure;
+      qDebug("previous directory structure freed in %d ms", time.elapsed());
+    }
+    if (stop) {
+      return;
+    }
+    lock.lock();
+  }
+}
+
 DirectoryEntry *DirectoryRefresher::getDirectoryStructure()
 {
   QMutexLocker locker(&m_RefreshLock);
@@ -53,6 +115,57 @@ DirectoryEntry *DirectoryRefresher::getDirectoryStructure()
   return result;
 }
 
+bool DirectoryRefresher::applyIncrementalUpdate(DirectoryEntry *structure, DirectoryEntry *&updated)
+{
+  updated = nullptr;
+  QMutexLocker locker(&m_RefreshLock);
+  if (!m_UpdatePending) {
+    return false;
+  }
+  m_UpdatePending = false;
+
+  std::vector<ModUpdate> updates;
+  updates.swap(m_PendingUpdates);
+  if (updates.empty() && (structure->getFileRegister()->pathIndexEnabled() == m_PathIndexEnabled)) {
+    return true;
+  }
+
+  QTime time;
+  time.start();
+
+  // other threads may still read the current structure, the changes go to a copy
+  std::unique_ptr<DirectoryEntry> copy(structure->clone());
+  structure = copy.get();
+  structure->getFileRegister()->setPathIndexEnabled(m_PathIndexEnabled);
+
+  // remove all changed origins before adding any of them back so files moved between those mods
+  // end up the same way they would in a new structure
+  for (const ModUpdate &update : updates) {
+    std::wstring name = ToWString(update.entry.modName);
+    if (structure->originExists(name)) {
+      FilesOrigin &origin = structure->getOriginByName(name);
+      origin.enable(false);
+      structure->pruneOrigin(origin.getID());
+    }
+  }
+
+  for (const ModUpdate &update : updates) {
+    try {
+      addModToStructure(structure, update.entry, update.priority, update.scan);
+    } catch (const std::exception &e) {
+      emit error(tr("failed to read mod (%1): %2").arg(update.entry.modName, e.what()));
+    }
+  }
+
+  cleanStructure(structure);
+  structure->getFileRegister()->conflictGraph();
+  updated = copy.release();
+
+  qDebug("directory structure updated in %d ms (%d mods changed)",
+         time.elapsed(), static_cast<int>(updates.size()));
+  return true;
+}
+
 void DirectoryRefresher::setMods(const std::vector<std::tuple<QString, QString, int> > &mods
                                  , const std::set<QString> &managedArchives)
 {
@@ -62,10 +175,39 @@ void DirectoryRefresher::setMods(const std::vector<std::tuple<QString, QString,
   for (auto mod = mods.begin(); mod != mods.end(); ++mod) {
     QString name = std::get<0>(*mod);
     ModInfo::Ptr info = ModInfo::getByIndex(ModInfo::getIndex(name));
-    m_Mods.push_back(EntryInfo(name, std::get<1>(*mod), info->stealFiles(), info->archives(), std::get<2>(*mod)));
+    m_Mods.push_back(EntryInfo(info, name, std::get<1>(*mod), info->stealFiles(), info->archives(), std::get<2>(*mod)));
   }
 
   m_EnabledArchives = managedArchives;
+  m_SEPluginPath = ModInfo::scriptExtenderPluginPath();
+}
+
+void DirectoryRefresher::setMods(const std::vector<std::tuple<QString, QString, QStringList> > &mods
+                                 , const std::set<QString> &managedArchives, const QString &sePluginPath)
+{
+  QMutexLocker locker(&m_RefreshLock);
+
+  m_Mods.clear();
+  int priority = 0;
+  for (const auto &mod : mods) {
+    m_Mods.push_back(EntryInfo(ModInfo::Ptr(), std::get<0>(mod), std::get<1>(mod), QStringList(),
+                               std::get<2>(mod), priority++));
+  }
+
+  m_EnabledArchives = managedArchives;
+  m_SEPluginPath = sePluginPath;
+}
+
+void DirectoryRefresher::setThreadCount(int threadCount)
+{
+  QMutexLocker locker(&m_RefreshLock);
+  m_ThreadCount = threadCount;
+}
+
+void DirectoryRefresher::setPathIndexEnabled(bool enabled)
+{
+  QMutexLocker locker(&m_RefreshLock);
+  m_PathIndexEnabled = enabled;
 }
 
 void DirectoryRefresher::cleanStructure(DirectoryEntry *structure)
@@ -81,33 +223,62 @@ void DirectoryRefresher::cleanStructure(DirectoryEntry *structure)
   }
 }
 
+void DirectoryRefresher::ArchiveOrderIndex::update(const QStringList &loadOrder)
+{
+  m_Plugins.clear();
+  for (int i = 0; i < loadOrder.size(); ++i) {
+    const QString &plugin = loadOrder.at(i);
+    QString name = plugin.left(plugin.size() - 4).toCaseFolded();
+    if (!m_Plugins.contains(name)) {
+      m_Plugins.insert(name, i);
+    }
+  }
+}
+
+int DirectoryRefresher::ArchiveOrderIndex::order(const QString &archiveName) const
+{
+  // an archive belongs to a plugin if its name starts with the name of the plugin followed by
+  // " - " or ".". Every such position in the archive name is looked up, if several plugins match
+  // the one loaded last wins
+  QString name = archiveName.toCaseFolded();
+  int order = -1;
+  for (int pos = name.indexOf('.'); pos != -1; pos = name.indexOf('.', pos + 1)) {
+    order = std::max(order, m_Plugins.value(name.left(pos), -1));
+  }
+  for (int pos = name.indexOf(" - "); pos != -1; pos = name.indexOf(" - ", pos + 1)) {
+    order = std::max(order, m_Plugins.value(name.left(pos), -1));
+  }
+  return order;
+}
+
+QStringList DirectoryRefresher::loadOrder()
+{
+  IPluginGame *game = qApp->property("managed_game").value<IPluginGame*>();
+  QStringList result;
+  game->feature<GamePlugins>()->getLoadOrder(result);
+  return result;
+}
+
+int DirectoryRefresher::archiveOrder(const QFileInfo &fileInfo) const
+{
+  return m_ArchiveOrder.order(fileInfo.fileName());
+}
+
 void DirectoryRefresher::addModBSAToStructure(DirectoryEntry *directoryStructure, const QString &modName,
                                               int priority, const QString &directory, const QStringList &archives)
 {
   std::wstring directoryW = ToWString(QDir::toNativeSeparators(directory));
-  QStringList loadOrder = QStringList();
+
+  // this runs outside of a refresh so the index of the refresher can't be used
+  ArchiveOrderIndex orderIndex;
+  orderIndex.update(loadOrder());
 
   for (const QString &archive : archives) {
     QFileInfo fileInfo(archive);
     if (m_EnabledArchives.find(fileInfo.fileName()) != m_EnabledArchives.end()) {
-      IPluginGame *game = qApp->property("managed_game").value<IPluginGame*>();
-
-      GamePlugins *gamePlugins = game->feature<GamePlugins>();
-      QStringList loadOrder = QStringList();
-      gamePlugins->getLoadOrder(loadOrder);
-
-      int order = -1;
-
-      for (auto plugin : loadOrder)
-      {
-        QString name = plugin.left(plugin.size() - 4);
-        if (fileInfo.fileName().startsWith(name + " - ", Qt::CaseInsensitive) || fileInfo.fileName().startsWith(name + ".", Qt::CaseInsensitive)) {
-          order = loadOrder.indexOf(plugin);
-        }
-      }
+      int order = orderIndex.order(fileInfo.fileName());
 
       try {
-        IPluginGame *game = qApp->property("managed_game").value<IPluginGame*>();
         directoryStructure->addFromBSA(ToWString(modName), directoryW, ToWString(QDir::toNativeSeparators(fileInfo.absoluteFilePath())), priority, order);
       } catch (const std::exception &e) {
         throw MyException(tr("failed to parse bsa %1: %2").arg(archive, e.what()));
@@ -134,7 +305,7 @@ void DirectoryRefresher::addModFilesToStructure(DirectoryEntry *directoryStructu
           file->removeOrigin(0);
         }
         origin.addFile(file->getIndex());
-        file->addOrigin(origin.getID(), file->getFileTime(), L"", -1);
+        file->addOrigin(origin.getID(), file->getFileTime(), StringPool::EMPTY, -1);
       } else {
         qWarning("%s not found", qPrintable(fileInfo.fileName()));
       }
@@ -155,37 +326,453 @@ void DirectoryRefresher::addModToStructure(DirectoryEntry *directoryStructure
   addModBSAToStructure(directoryStructure, modName, priority, directory, archives);
 }
 
-void DirectoryRefresher::refresh()
+void DirectoryRefresher::scanDirectory(const std::wstring &directory, OriginScan &scan, int &numScanned) const
 {
-  QMutexLocker locker(&m_RefreshLock);
+  if (!m_Snapshot.restoreDirectory(directory, scan)) {
+    scan.scanDirectory(directory);
+    ++numScanned;
+  }
+}
 
-  delete m_DirectoryStructure;
+void DirectoryRefresher::scanArchive(const std::wstring &fileName, OriginScan &scan, int &numScanned) const
+{
+  if (!m_Snapshot.restoreArchive(fileName, scan)) {
+    scan.scanArchive(fileName);
+    ++numScanned;
+  }
+}
 
-  m_DirectoryStructure = new DirectoryEntry(L"data", nullptr, 0);
+void DirectoryRefresher::scanMod(const EntryInfo &entry, ModScan &result) const
+{
+  // only the disk access happens here, this must not touch the directory structure
+  scanModFiles(entry, result);
+  listArchives(entry, result);
+  for (ArchiveScan &archive : result.archives) {
+    scanModArchive(archive);
+    if (!archive.error.isEmpty()) {
+      break;
+    }
+  }
+  finishScan(result);
+}
 
-  IPluginGame *game = qApp->property("managed_game").value<IPluginGame*>();
+void DirectoryRefresher::scanModFiles(const EntryInfo &entry, ModScan &result) const
+{
+  if (entry.stealFiles.length() == 0) {
+    // this runs on the scan workers, an exception escaping a worker would terminate the application
+    try {
+      scanDirectory(ToWString(QDir::toNativeSeparators(entry.absolutePath)), result.files, result.numScanned);
+      result.contents = ModInfo::classifyContents(result.files, m_SEPluginPath);
+      recordArchives(entry, result.files);
+    } catch (const std::exception &e) {
+      result.error = tr("failed to scan %1: %2").arg(entry.absolutePath, e.what());
+    }
+  }
+}
 
-  std::wstring dataDirectory = QDir::toNativeSeparators(game->dataDirectory().absolutePath()).toStdWString();
-  m_DirectoryStructure->addFromOrigin(L"data", dataDirectory, 0);
+void DirectoryRefresher::listArchives(const EntryInfo &entry, ModScan &result) const
+{
+  for (const QString &archive : entry.archives) {
+    QFileInfo fileInfo(archive);
+    if (m_EnabledArchives.find(fileInfo.fileName()) != m_EnabledArchives.end()) {
+      result.archives.push_back(ArchiveScan());
+      result.archives.back().fileName = archive;
+    }
+  }
+}
 
-  // TODO what was the point of having the priority in this tuple? the list is already sorted by priority
+void DirectoryRefresher::scanModArchive(ArchiveScan &archive) const
+{
+  try {
+    scanArchive(ToWString(QDir::toNativeSeparators(QFileInfo(archive.fileName).absoluteFilePath())),
+                archive.scan, archive.numScanned);
+  } catch (const std::exception &e) {
+    archive.error = tr("failed to parse bsa %1: %2").arg(archive.fileName, e.what());
+  }
+}
+
+void DirectoryRefresher::recordArchives(const EntryInfo &entry, const OriginScan &scan) const
+{
+  // the listing contains the archives of the mod, there is no need for the mod to list its
+  // directory again before the next refresh
+  FILETIME lastWriteTime = scan.lastWriteTime();
+  quint64 fileTime = (static_cast<quint64>(lastWriteTime.dwHighDateTime) << 32) | lastWriteTime.dwLowDateTime;
+  if ((fileTime == 0) || (entry.modInfo.get() == nullptr)) {
+    // the directory doesn't exist or there is no mod to record the archives on
+    return;
+  }
+
+  QStringList archives;
+  int depth = 0;
+  for (const OriginScan::Entry &file : scan.entries()) {
+    if (file.type == OriginScan::ENTRY_DIRECTORY) {
+      ++depth;
+    } else if (file.type == OriginScan::ENTRY_END_DIRECTORY) {
+      --depth;
+    } else if (depth == 0) {
+      QString fileName = ToQString(file.name);
+      if (fileName.endsWith(".bsa", Qt::CaseInsensitive) || fileName.endsWith(".ba2", Qt::CaseInsensitive)) {
+        archives.append(entry.absolutePath + "/" + fileName);
+      }
+    }
+  }
+
+  // file times count 100ns intervals since 1601
+  qint64 lastModified = static_cast<qint64>((fileTime - 116444736000000000ULL) / 10000ULL);
+  entry.modInfo->recordArchives(entry.absolutePath, archives, lastModified);
+}
+
+void DirectoryRefresher::finishScan(ModScan &result) const
+{
+  for (size_t i = 0; i < result.archives.size(); ++i) {
+    if (!result.archives[i].error.isEmpty()) {
+      // archives after the broken one are skipped, same as when adding them directly
+      if (result.error.isEmpty()) {
+        result.error = result.archives[i].error;
+      }
+      result.archives.resize(i);
+      break;
+    }
+    result.numScanned += result.archives[i].numScanned;
+  }
+}
+
+void DirectoryRefresher::addModToStructure(DirectoryEntry *directoryStructure, const EntryInfo &entry,
+                                           int priority, const ModScan &scan)
+{
+  if (entry.stealFiles.length() > 0) {
+    addModFilesToStructure(directoryStructure, entry.modName, priority, entry.absolutePath, entry.stealFiles);
+  } else {
+    directoryStructure->addFromOrigin(ToWString(entry.modName),
+                                      ToWString(QDir::toNativeSeparators(entry.absolutePath)),
+                                      priority, scan.files);
+    // recorded on the origin so the mod list can show the contents without accessing the disk
+    directoryStructure->getOriginByName(ToWString(entry.modName)).setContents(scan.contents);
+  }
+
+  std::wstring directoryW = ToWString(QDir::toNativeSeparators(entry.absolutePath));
+  for (const ArchiveScan &archive : scan.archives) {
+    QFileInfo fileInfo(archive.fileName);
+    directoryStructure->addFromBSA(ToWString(entry.modName), directoryW,
+                                   ToWString(QDir::toNativeSeparators(fileInfo.absoluteFilePath())),
+                                   priority, archiveOrder(fileInfo), archive.scan);
+  }
+
+  if (!scan.error.isEmpty()) {
+    throw MyException(scan.error);
+  }
+}
+
+void DirectoryRefresher::addToSnapshot(const EntryInfo &entry, const ModScan &scan)
+{
+  if (entry.stealFiles.length() == 0) {
+    m_SnapshotWriter.add(ToWString(QDir::toNativeSeparators(entry.absolutePath)), scan.files);
+  }
+  for (const ArchiveScan &archive : scan.archives) {
+    m_SnapshotWriter.add(ToWString(QDir::toNativeSeparators(QFileInfo(archive.fileName).absoluteFilePath())),
+                         archive.scan);
+  }
+}
+
+void DirectoryRefresher::addToSnapshot(const EntryInfo &entry)
+{
+  if (entry.stealFiles.length() == 0) {
+    m_SnapshotWriter.add(m_Snapshot, ToWString(QDir::toNativeSeparators(entry.absolutePath)));
+  }
+  for (const QString &archive : entry.archives) {
+    QFileInfo fileInfo(archive);
+    if (m_EnabledArchives.find(fileInfo.fileName()) != m_EnabledArchives.end()) {
+      m_SnapshotWriter.add(m_Snapshot, ToWString(QDir::toNativeSeparators(fileInfo.absoluteFilePath())));
+    }
+  }
+}
+
+void DirectoryRefresher::retainArchives()
+{
+  // listings of archives that aren't in use are kept as long as the archive is unchanged, so
+  // enabling a mod or archive again doesn't require parsing it
+  for (const std::wstring &fileName : m_Snapshot.archives()) {
+    if (!m_SnapshotWriter.contains(fileName) && m_Snapshot.isUnchanged(fileName, true)) {
+      m_SnapshotWriter.add(m_Snapshot, fileName);
+    }
+  }
+}
+
+bool DirectoryRefresher::modChanged(const EntryInfo &entry) const
+{
+  if ((entry.stealFiles.length() == 0)
+      && !m_Snapshot.isUnchanged(ToWString(QDir::toNativeSeparators(entry.absolutePath)), false)) {
+    return true;
+  }
+  for (const QString &archive : entry.archives) {
+    QFileInfo fileInfo(archive);
+    if ((m_EnabledArchives.find(fileInfo.fileName()) != m_EnabledArchives.end())
+        && !m_Snapshot.isUnchanged(ToWString(QDir::toNativeSeparators(fileInfo.absoluteFilePath())), true)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+quint64 DirectoryRefresher::modListHash(const std::wstring &dataDirectory, const QStringList &loadOrder) const
+{
+  QCryptographicHash hash(QCryptographicHash::Md5);
+  hash.addData(ToQString(dataDirectory).toUtf8());
+  // the load order determines the order of archives
+  hash.addData(loadOrder.join("|").toUtf8());
+  for (const EntryInfo &entry : m_Mods) {
+    hash.addData(entry.modName.toUtf8());
+    hash.addData(entry.absolutePath.toUtf8());
+    hash.addData(entry.stealFiles.join("|").toUtf8());
+    hash.addData(entry.archives.join("|").toUtf8());
+  }
+  for (const QString &archive : m_EnabledArchives) {
+    hash.addData(archive.toUtf8());
+  }
+  quint64 result = 0;
+  memcpy(&result, hash.result().constData(), sizeof(result));
+  return result;
+}
+
+int DirectoryRefresher::refreshSerial()
+{
+  int numScanned = 0;
   auto iter = m_Mods.begin();
 
   //TODO i is the priority here, where higher = more important. the input vector is also sorted by priority but inverted!
   for (int i = 1; iter != m_Mods.end(); ++iter, ++i) {
+    ModScan scan;
+    scanMod(*iter, scan);
+    numScanned += scan.numScanned;
+    addToSnapshot(*iter, scan);
     try {
-      addModToStructure(m_DirectoryStructure, iter->modName, i, iter->absolutePath, iter->stealFiles, iter->archives);
+      addModToStructure(m_DirectoryStructure, *iter, i, scan);
     } catch (const std::exception &e) {
       emit error(tr("failed to read mod (%1): %2").arg(iter->modName, e.what()));
     }
     emit progress((i * 100) / static_cast<int>(m_Mods.size()) + 1);
   }
+  return numScanned;
+}
 
-  m_DirectoryStructure->getFileRegister()->sortOrigins();
+int DirectoryRefresher::refreshParallel(int threadCount)
+{
+  // the mods are scanned by the workers in priority order while this thread merges the results
+  // into the structure, also in priority order, as soon as they become available. Merging is
+  // what determines the tree so it's identical to the one a serial refresh produces.
+  // The loose files and each archive of a mod are scanned as separate tasks so archives that
+  // have to be parsed are spread over all workers
+  std::vector<ModScan> scans(m_Mods.size());
+  // mod index and archive index, -1 for the loose files
+  std::vector<std::pair<size_t, int>> tasks;
+  std::vector<std::atomic<int>> remaining(m_Mods.size());
+  for (size_t idx = 0; idx < m_Mods.size(); ++idx) {
+    listArchives(m_Mods[idx], scans[idx]);
+    int numArchives = static_cast<int>(scans[idx].archives.size());
+    for (int archive = -1; archive < numArchives; ++archive) {
+      tasks.push_back(std::make_pair(idx, archive));
+    }
+    remaining[idx] = numArchives + 1;
+  }
+
+  std::vector<std::promise<void>> scanned(m_Mods.size());
+  std::vector<std::future<void>> finished;
+  for (std::promise<void> &promise : scanned) {
+    finished.push_back(promise.get_future());
+  }
+
+  std::atomic<size_t> nextTask(0);
+  auto worker = [&] () {
+    for (size_t task = nextTask++; task < tasks.size(); task = nextTask++) {
+      size_t idx = tasks[task].first;
+      if (tasks[task].second < 0) {
+        scanModFiles(m_Mods[idx], scans[idx]);
+      } else {
+        scanModArchive(scans[idx].archives[tasks[task].second]);
+      }
+      if (--remaining[idx] == 0) {
+        scanned[idx].set_value();
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threadCount; ++i) {
+    workers.push_back(std::thread(worker));
+  }
+
+  int numScanned = 0;
+  for (size_t idx = 0; idx < m_Mods.size(); ++idx) {
+    finished[idx].wait();
+    finishScan(scans[idx]);
+    const EntryInfo &entry = m_Mods[idx];
+    int priority = static_cast<int>(idx) + 1;
+    numScanned += scans[idx].numScanned;
+    addToSnapshot(entry, scans[idx]);
+    try {
+      addModToStructure(m_DirectoryStructure, entry, priority, scans[idx]);
+    } catch (const std::exception &e) {
+      emit error(tr("failed to read mod (%1): %2").arg(entry.modName, e.what()));
+    }
+    // the listing isn't needed any more
+    scans[idx] = ModScan();
+    emit progress((priority * 100) / static_cast<int>(m_Mods.size()) + 1);
+  }
+
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+  return numScanned;
+}
+
+bool DirectoryRefresher::refreshIncremental(const std::wstring &dataDirectory, int threadCount)
+{
+  // files of the data directory are modified by mods that take files from it, so changes there
+  // or to those mods can't be applied by replacing a single origin
+  if (!m_Snapshot.isUnchanged(dataDirectory, false)) {
+    return false;
+  }
+
+  std::vector<char> changed(m_Mods.size(), 0);
+  std::atomic<size_t> nextMod(0);
+  auto worker = [&] () {
+    for (size_t idx = nextMod++; idx < m_Mods.size(); idx = nextMod++) {
+      changed[idx] = modChanged(m_Mods[idx]) ? 1 : 0;
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threadCount; ++i) {
+    workers.push_back(std::thread(worker));
+  }
+  worker();
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+
+  for (size_t idx = 0; idx < m_Mods.size(); ++idx) {
+    if (changed[idx] && (m_Mods[idx].stealFiles.length() > 0)) {
+      return false;
+    }
+  }
+
+  m_PendingUpdates.clear();
+  for (size_t idx = 0; idx < m_Mods.size(); ++idx) {
+    if (changed[idx]) {
+      ModUpdate update(m_Mods[idx], static_cast<int>(idx) + 1);
+      scanMod(update.entry, update.scan);
+      m_PendingUpdates.push_back(std::move(update));
+    }
+  }
+
+  if (!m_PendingUpdates.empty()) {
+    m_SnapshotWriter = DirectorySnapshotWriter();
+    m_SnapshotWriter.add(m_Snapshot, dataDirectory);
+    auto update = m_PendingUpdates.begin();
+    for (const EntryInfo &entry : m_Mods) {
+      if ((update != m_PendingUpdates.end()) && (update->entry.modName == entry.modName)) {
+        addToSnapshot(entry, update->scan);
+        ++update;
+      } else {
+        addToSnapshot(entry);
+      }
+    }
+  }
+  m_UpdatePending = true;
+  return true;
+}
+
+void DirectoryRefresher::refresh()
+{
+  IPluginGame *game = qApp->property("managed_game").value<IPluginGame*>();
+
+  // listings of origins that didn't change since the last refresh are taken from the snapshot
+  QString snapshotPath = qApp->property("dataPath").toString() + "/"
+                         + ToQString(AppConfig::directorySnapshotFileName());
+
+  refresh(QDir::toNativeSeparators(game->dataDirectory().absolutePath()).toStdWString(),
+          snapshotPath, loadOrder());
+}
+
+void DirectoryRefresher::refresh(const std::wstring &dataDirectory, const QString &snapshotPath,
+                                 const QStringList &plugins)
+{
+  QMutexLocker locker(&m_RefreshLock);
+
+  QTime time;
+  time.start();
+
+  m_Snapshot.load(snapshotPath);
+
+  m_ArchiveOrder.update(plugins);
+  quint64 hash = modListHash(dataDirectory, plugins);
+
+  int threadCount = m_ThreadCount > 0 ? m_ThreadCount : QThread::idealThreadCount();
+  threadCount = std::min(threadCount, static_cast<int>(m_Mods.size()));
+
+  // with the same mod list as the structure that is in use, only origins that changed on disk
+  // have to be replaced in it
+  if ((m_StructureHash != 0ULL) && (m_StructureHash == m_Snapshot.modListHash())
+      && (m_StructureHash == hash) && (m_DirectoryStructure == nullptr) && !m_UpdatePending
+      && refreshIncremental(dataDirectory, threadCount)) {
+    if (!m_PendingUpdates.empty()) {
+      retainArchives();
+    }
+    m_Snapshot.close();
+    if (!m_PendingUpdates.empty()) {
+      m_SnapshotWriter.write(snapshotPath, hash);
+      m_SnapshotWriter = DirectorySnapshotWriter();
+    }
+    qDebug("directory structure checked in %d ms (%d mods, %d changed)",
+           time.elapsed(), static_cast<int>(m_Mods.size()), static_cast<int>(m_PendingUpdates.size()));
+    emit progress(100);
+    emit refreshed();
+    return;
+  }
+
+  m_PendingUpdates.clear();
+  m_UpdatePending = false;
+
+  delete m_DirectoryStructure;
+
+  m_DirectoryStructure = new DirectoryEntry(L"data", nullptr, 0);
+  m_DirectoryStructure->getFileRegister()->setPathIndexEnabled(m_PathIndexEnabled);
+  m_SnapshotWriter = DirectorySnapshotWriter();
+
+  int numScanned = 0;
+  {
+    OriginScan dataScan;
+    scanDirectory(dataDirectory, dataScan, numScanned);
+    m_DirectoryStructure->addFromOrigin(L"data", dataDirectory, 0, dataScan);
+    m_SnapshotWriter.add(dataDirectory, dataScan);
+  }
+
+  if (threadCount > 1) {
+    numScanned += refreshParallel(threadCount);
+  } else {
+    numScanned += refreshSerial();
+  }
+
+  // the snapshot has to be unmapped before it can be replaced
+  bool snapshotOutdated = (numScanned > 0) || (hash != m_Snapshot.modListHash());
+  if (snapshotOutdated) {
+    retainArchives();
+  }
+  m_Snapshot.close();
+  if (snapshotOutdated) {
+    m_SnapshotWriter.write(snapshotPath, hash);
+  }
+  m_SnapshotWriter = DirectorySnapshotWriter();
+  m_StructureHash = hash;
 
   emit progress(100);
 
   cleanStructure(m_DirectoryStructure);
 
+  // build the conflict graph here so the mod list doesn't have to when it's first displayed
+  m_DirectoryStructure->getFileRegister()->conflictGraph();
+
+  qDebug("directory structure refreshed in %d ms (%d mods, %d threads, %d origins scanned)",
+         time.elapsed(), static_cast<int>(m_Mods.size()), std::max(threadCount, 1), numScanned);
+
   emit refreshed();
 }
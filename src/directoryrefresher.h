@@ -21,12 +21,19 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #define DIRECTORYREFRESHER_H
 
 #include <directoryentry.h>
+#include "directorysnapshot.h"
 #include <QObject>
 #include <QMutex>
+#include <QFileInfo>
 #include <QStringList>
+#include <QHash>
 #include <vector>
 #include <set>
 #include <tuple>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
 #include "profile.h"
 
 
@@ -54,10 +61,26 @@ public:
    * returns a pointer to the updated directory structure. DirectoryRefresher
    * deletes its own pointer and the caller takes custody of the pointer
    * 
-   * @return updated directory structure
+   * @return updated directory structure. nullptr if the refresh only produced an update for
+   *         the current structure (see applyIncrementalUpdate)
    **/
   MOShared::DirectoryEntry *getDirectoryStructure();
 
+  /**
+   * @brief apply the changes found by an incremental refresh to a copy of the structure
+   *
+   * If only some origins changed since the structure was built and the mod list is the same,
+   * refresh() doesn't build a new structure. Instead the changed origins are removed from a copy
+   * of the current one and added again. The current structure isn't changed so other threads can
+   * keep reading it. Has to be called from the thread that owns the structure
+   *
+   * @param structure the structure produced by the previous refresh
+   * @param updated receives the changed copy, which the caller takes custody of. nullptr if the
+   *                update is empty
+   * @return true if there was an update (which may be empty), false if there is nothing to apply
+   **/
+  bool applyIncrementalUpdate(MOShared::DirectoryEntry *structure, MOShared::DirectoryEntry *&updated);
+
   /**
    * @brief sets up the mods to be included in the directory structure
    *
@@ -65,6 +88,17 @@ public:
    **/
   void setMods(const std::vector<std::tuple<QString, QString, int> > &mods, const std::set<QString> &managedArchives);
 
+  /**
+   * @brief sets up the mods without looking them up in the mod list. Used where there is no mod
+   *        list, e.g. by the benchmarks
+   *
+   * @param mods name, absolute path and archives of the mods to include, in priority order
+   * @param managedArchives file names of the archives to include
+   * @param sePluginPath path of script extender plugins relative to the data directory
+   **/
+  void setMods(const std::vector<std::tuple<QString, QString, QStringList> > &mods,
+               const std::set<QString> &managedArchives, const QString &sePluginPath);
+
   /**
    * @brief sets up the directory where mods are stored
    * @param modDirectory the mod directory
@@ -72,6 +106,26 @@ public:
    */
   void setModDirectory(const QString &modDirectory);
 
+  /**
+   * @brief sets the number of threads used to scan mods during a refresh
+   * @param threadCount number of threads. 1 scans all mods serially, 0 or less picks
+   *                    a count based on the number of cores
+   */
+  void setThreadCount(int threadCount);
+
+  /**
+   * @brief enables the index that resolves relative paths to files with a single lookup
+   * @param enabled true to maintain the index in the structures generated from now on
+   */
+  void setPathIndexEnabled(bool enabled);
+
+  /**
+   * @brief delete a directory structure that is no longer in use on a background thread.
+   *        Freeing a large structure takes long enough to be noticeable on the main thread
+   * @param structure the structure to delete. It must not be accessed after this call
+   */
+  void discardStructure(MOShared::DirectoryEntry *structure);
+
   /**
    * @brief remove files from the directory structure that are known to be irrelevant to the game
    * @param the structure to clean
@@ -116,6 +170,17 @@ public slots:
    **/
   void refresh();
 
+public:
+
+  /**
+   * @brief generate a directory structure from the mods set earlier without querying the game
+   *        plugin. refresh() calls this with the settings of the managed game
+   * @param dataDirectory absolute path of the data directory of the game
+   * @param snapshotPath file the listings are cached in between refreshes
+   * @param loadOrder plugins in load order, determines the order of archives
+   **/
+  void refresh(const std::wstring &dataDirectory, const QString &snapshotPath, const QStringList &loadOrder);
+
 signals:
 
   void progress(int progress);
@@ -125,10 +190,11 @@ signals:
 private:
 
   struct EntryInfo {
-    EntryInfo(const QString &modName, const QString &absolutePath,
+    EntryInfo(const ModInfo::Ptr &modInfo, const QString &modName, const QString &absolutePath,
               const QStringList &stealFiles, const QStringList &archives, int priority)
-      : modName(modName), absolutePath(absolutePath), stealFiles(stealFiles)
+      : modInfo(modInfo), modName(modName), absolutePath(absolutePath), stealFiles(stealFiles)
       , archives(archives), priority(priority) {}
+    ModInfo::Ptr modInfo;
     QString modName;
     QString absolutePath;
     QStringList stealFiles;
@@ -136,12 +202,111 @@ private:
     int priority;
   };
 
+  // an archive of a mod, scanned ahead of adding it to the structure
+  struct ArchiveScan {
+    ArchiveScan() : numScanned(0) {}
+    QString fileName;
+    MOShared::OriginScan scan;
+    QString error;
+    int numScanned;
+  };
+
+  // files of a mod, scanned ahead of adding them to the structure
+  struct ModScan {
+    ModScan() : contents(0), numScanned(0) {}
+    MOShared::OriginScan files;
+    // content types found in the files, see ModInfo::classifyContents
+    unsigned int contents;
+    std::vector<ArchiveScan> archives;
+    QString error;
+    // number of origins that had to be read from disk because the snapshot was outdated
+    int numScanned;
+  };
+
+  // determines the order of archives from the plugin each of them belongs to
+  class ArchiveOrderIndex {
+  public:
+    void update(const QStringList &loadOrder);
+    /**
+     * @return position of the plugin the archive belongs to in the load order, -1 if there is none
+     */
+    int order(const QString &archiveName) const;
+  private:
+    // case folded plugin names without extension to their position
+    QHash<QString, int> m_Plugins;
+  };
+
+  // a changed mod, scanned in the refresher thread and applied in the main thread
+  struct ModUpdate {
+    ModUpdate(const EntryInfo &entry, int priority) : entry(entry), priority(priority) {}
+    EntryInfo entry;
+    int priority;
+    ModScan scan;
+  };
+
+private:
+
+  void scanMod(const EntryInfo &entry, ModScan &result) const;
+
+  // the steps of scanMod. The loose files and each archive can be scanned concurrently
+  void scanModFiles(const EntryInfo &entry, ModScan &result) const;
+  void listArchives(const EntryInfo &entry, ModScan &result) const;
+  void scanModArchive(ArchiveScan &archive) const;
+  void recordArchives(const EntryInfo &entry, const MOShared::OriginScan &scan) const;
+  void finishScan(ModScan &result) const;
+
+  void scanDirectory(const std::wstring &directory, MOShared::OriginScan &scan, int &numScanned) const;
+  void scanArchive(const std::wstring &fileName, MOShared::OriginScan &scan, int &numScanned) const;
+
+  void addToSnapshot(const EntryInfo &entry, const ModScan &scan);
+  void addToSnapshot(const EntryInfo &entry);
+  void retainArchives();
+
+  bool modChanged(const EntryInfo &entry) const;
+
+  quint64 modListHash(const std::wstring &dataDirectory, const QStringList &loadOrder) const;
+
+  void addModToStructure(MOShared::DirectoryEntry *directoryStructure, const EntryInfo &entry, int priority, const ModScan &scan);
+
+  int archiveOrder(const QFileInfo &fileInfo) const;
+
+  static QStringList loadOrder();
+
+  int refreshSerial();
+  int refreshParallel(int threadCount);
+  bool refreshIncremental(const std::wstring &dataDirectory, int threadCount);
+
+  void reclaimStructures();
+
 private:
 
   std::vector<EntryInfo> m_Mods;
   std::set<QString> m_EnabledArchives;
+  // taken from the game plugin when the mods are set up, it can't be queried from the scan threads
+  QString m_SEPluginPath;
   MOShared::DirectoryEntry *m_DirectoryStructure;
   QMutex m_RefreshLock;
+  int m_ThreadCount;
+  bool m_PathIndexEnabled;
+
+  // built from the load order at the start of each refresh
+  ArchiveOrderIndex m_ArchiveOrder;
+
+  // listings from the previous refresh and the ones for the next, only used during refresh
+  DirectorySnapshot m_Snapshot;
+  DirectorySnapshotWriter m_SnapshotWriter;
+
+  // mod list hash of the structure handed out last, 0 if there is none to update
+  quint64 m_StructureHash;
+  std::vector<ModUpdate> m_PendingUpdates;
+  bool m_UpdatePending;
+
+  // structures waiting to be deleted by the reclaim thread
+  std::thread m_ReclaimThread;
+  std::mutex m_ReclaimMutex;
+  std::condition_variable m_ReclaimCondition;
+  std::vector<MOShared::DirectoryEntry*> m_DiscardedStructures;
+  bool m_ReclaimStop;
 
 };
 
@@ -0,0 +1,463 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "directorysnapshot.h"
+
+#include <QSaveFile>
+#include <cstring>
+
+
+using namespace MOShared;
+
+
+static const char SNAPSHOT_MAGIC[8] = { 'M', 'O', 'D', 'I', 'R', 'S', 'N', 'P' };
+// increase whenever the layout or the meaning of the data changes
+static const quint32 SNAPSHOT_VERSION = 1;
+
+static_assert(sizeof(wchar_t) == 2, "the snapshot stores utf-16 strings");
+
+
+static quint64 checksum(const uchar *data, size_t size)
+{
+  // FNV-1a, 8 bytes at a time. Only meant to detect truncated or damaged files
+  quint64 hash = 14695981039346656037ULL;
+  size_t words = size / sizeof(quint64);
+  for (size_t i = 0; i < words; ++i) {
+    quint64 word;
+    memcpy(&word, data + i * sizeof(quint64), sizeof(quint64));
+    hash ^= word;
+    hash *= 1099511628211ULL;
+  }
+  for (size_t i = words * sizeof(quint64); i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+static quint64 toInt(const FILETIME &time)
+{
+  return (static_cast<quint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+
+
+static FILETIME toFileTime(quint64 time)
+{
+  FILETIME result;
+  result.dwLowDateTime = static_cast<DWORD>(time & 0xFFFFFFFFULL);
+  result.dwHighDateTime = static_cast<DWORD>(time >> 32);
+  return result;
+}
+
+
+static bool getFileData(const std::wstring &path, WIN32_FILE_ATTRIBUTE_DATA &data)
+{
+  return ::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) != 0;
+}
+
+
+//
+// DirectorySnapshot
+//
+
+DirectorySnapshot::DirectorySnapshot()
+  : m_Data(nullptr)
+  , m_Header(nullptr)
+  , m_Origins(nullptr)
+  , m_Entries(nullptr)
+  , m_Strings(nullptr)
+  , m_StringData(nullptr)
+{
+}
+
+DirectorySnapshot::~DirectorySnapshot()
+{
+  close();
+}
+
+bool DirectorySnapshot::load(const QString &fileName)
+{
+  close();
+
+  m_File.setFileName(fileName);
+  if (!m_File.exists()) {
+    return false;
+  }
+
+  if (!m_File.open(QIODevice::ReadOnly)) {
+    qWarning("failed to open directory snapshot %s: %s",
+             qPrintable(fileName), qPrintable(m_File.errorString()));
+    return false;
+  }
+
+  qint64 size = m_File.size();
+  if (size >= static_cast<qint64>(sizeof(Header))) {
+    m_Data = m_File.map(0, size);
+  }
+
+  if ((m_Data == nullptr) || !validate(size)) {
+    qWarning("directory snapshot %s is invalid, doing a full refresh", qPrintable(fileName));
+    close();
+    return false;
+  }
+
+  for (quint32 i = 0; i < m_Header->numOrigins; ++i) {
+    m_OriginIndex[string(m_Origins[i].path)] = i;
+  }
+
+  return true;
+}
+
+void DirectorySnapshot::close()
+{
+  m_OriginIndex.clear();
+  m_Header = nullptr;
+  m_Origins = nullptr;
+  m_Entries = nullptr;
+  m_Strings = nullptr;
+  m_StringData = nullptr;
+  if (m_Data != nullptr) {
+    m_File.unmap(const_cast<uchar*>(m_Data));
+    m_Data = nullptr;
+  }
+  m_File.close();
+}
+
+bool DirectorySnapshot::validate(qint64 size)
+{
+  const Header *header = reinterpret_cast<const Header*>(m_Data);
+  if ((memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+      || (header->version != SNAPSHOT_VERSION)) {
+    return false;
+  }
+
+  // check the table sizes add up to the file size before calculating anything else from them
+  quint64 expected = sizeof(Header)
+      + static_cast<quint64>(header->numOrigins) * sizeof(OriginRecord)
+      + static_cast<quint64>(header->numEntries) * sizeof(EntryRecord)
+      + static_cast<quint64>(header->numStrings) * sizeof(StringRecord);
+  if ((header->stringDataLength > static_cast<quint64>(size))
+      || (expected + header->stringDataLength * sizeof(wchar_t) != static_cast<quint64>(size))) {
+    return false;
+  }
+
+  if (checksum(m_Data + sizeof(Header), static_cast<size_t>(size) - sizeof(Header)) != header->checksum) {
+    return false;
+  }
+
+  const uchar *pos = m_Data + sizeof(Header);
+  const OriginRecord *origins = reinterpret_cast<const OriginRecord*>(pos);
+  pos += header->numOrigins * sizeof(OriginRecord);
+  const EntryRecord *entries = reinterpret_cast<const EntryRecord*>(pos);
+  pos += header->numEntries * sizeof(EntryRecord);
+  const StringRecord *strings = reinterpret_cast<const StringRecord*>(pos);
+  pos += header->numStrings * sizeof(StringRecord);
+
+  // with all indices in range, reading the snapshot later can't go out of bounds
+  for (quint32 i = 0; i < header->numStrings; ++i) {
+    if (static_cast<quint64>(strings[i].offset) + strings[i].length > header->stringDataLength) {
+      return false;
+    }
+  }
+  for (quint32 i = 0; i < header->numEntries; ++i) {
+    if ((entries[i].name >= header->numStrings) || (entries[i].type > OriginScan::ENTRY_END_DIRECTORY)) {
+      return false;
+    }
+  }
+  for (quint32 i = 0; i < header->numOrigins; ++i) {
+    if ((origins[i].path >= header->numStrings)
+        || (static_cast<quint64>(origins[i].firstEntry) + origins[i].numEntries > header->numEntries)) {
+      return false;
+    }
+  }
+
+  m_Header = header;
+  m_Origins = origins;
+  m_Entries = entries;
+  m_Strings = strings;
+  m_StringData = reinterpret_cast<const wchar_t*>(pos);
+  return true;
+}
+
+quint64 DirectorySnapshot::modListHash() const
+{
+  return m_Header != nullptr ? m_Header->modListHash : 0ULL;
+}
+
+std::wstring DirectorySnapshot::string(quint32 index) const
+{
+  const StringRecord &record = m_Strings[index];
+  return std::wstring(m_StringData + record.offset, record.length);
+}
+
+const DirectorySnapshot::OriginRecord *DirectorySnapshot::findOrigin(const std::wstring &path) const
+{
+  auto iter = m_OriginIndex.find(path);
+  return iter != m_OriginIndex.end() ? &m_Origins[iter->second] : nullptr;
+}
+
+void DirectorySnapshot::restoreEntries(const OriginRecord &origin, std::vector<OriginScan::Entry> &entries) const
+{
+  entries.reserve(origin.numEntries);
+  for (quint32 i = origin.firstEntry; i < origin.firstEntry + origin.numEntries; ++i) {
+    const EntryRecord &record = m_Entries[i];
+    OriginScan::Entry entry;
+    entry.type = static_cast<OriginScan::EntryType>(record.type);
+    entry.name = string(record.name);
+    entry.fileTime = toFileTime(record.fileTime);
+    entries.push_back(std::move(entry));
+  }
+}
+
+bool DirectorySnapshot::directoryUnchanged(const std::wstring &path, const OriginRecord &origin) const
+{
+  WIN32_FILE_ATTRIBUTE_DATA fileData;
+  if (!getFileData(path, fileData)) {
+    // a directory that didn't exist before still doesn't
+    return (origin.lastWriteTime == 0) && (origin.numEntries == 0);
+  }
+  if (toInt(fileData.ftLastWriteTime) != origin.lastWriteTime) {
+    return false;
+  }
+
+  // editing a file in place doesn't change the modification time of the directory containing it,
+  // so the directories are listed again and compared with the stored listing entry by entry. That
+  // still saves building the listing and lets an incremental refresh skip the origin
+  quint32 next = origin.firstEntry;
+  quint32 end = origin.firstEntry + origin.numEntries;
+  return listingUnchanged(path, next, end) && (next == end);
+}
+
+bool DirectorySnapshot::nameEquals(quint32 index, const wchar_t *name) const
+{
+  const StringRecord &record = m_Strings[index];
+  return (wcsncmp(m_StringData + record.offset, name, record.length) == 0) && (name[record.length] == L'\0');
+}
+
+bool DirectorySnapshot::listingUnchanged(const std::wstring &path, quint32 &next, quint32 end) const
+{
+  // has to visit the entries in the order OriginScan::scanDirectory stored them
+  WIN32_FIND_DATAW findData;
+  HANDLE searchHandle = OriginScan::findFirstFile((path + L"\\*").c_str(), findData);
+  if (searchHandle == INVALID_HANDLE_VALUE) {
+    // the scan lists nothing for a directory it can't open
+    return true;
+  }
+
+  bool unchanged = true;
+  for (BOOL result = TRUE; unchanged && result; result = ::FindNextFileW(searchHandle, &findData)) {
+    if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+      if ((wcscmp(findData.cFileName, L".") == 0) || (wcscmp(findData.cFileName, L"..") == 0)) {
+        continue;
+      }
+      if ((next >= end) || (m_Entries[next].type != OriginScan::ENTRY_DIRECTORY)
+          || !nameEquals(m_Entries[next].name, findData.cFileName)) {
+        unchanged = false;
+        continue;
+      }
+      // the times of directories don't end up in the structure, with the same names and file times
+      // the listing gives the same tree
+      ++next;
+      unchanged = listingUnchanged(path + L"\\" + findData.cFileName, next, end)
+          && (next < end) && (m_Entries[next].type == OriginScan::ENTRY_END_DIRECTORY);
+      ++next;
+    } else {
+      unchanged = (next < end) && (m_Entries[next].type == OriginScan::ENTRY_FILE)
+          && nameEquals(m_Entries[next].name, findData.cFileName)
+          && (m_Entries[next].fileTime == toInt(findData.ftLastWriteTime));
+      ++next;
+    }
+  }
+  ::FindClose(searchHandle);
+  return unchanged;
+}
+
+bool DirectorySnapshot::archiveUnchanged(const std::wstring &fileName, const OriginRecord &origin) const
+{
+  WIN32_FILE_ATTRIBUTE_DATA fileData;
+  if (!getFileData(fileName, fileData)) {
+    return false;
+  }
+  quint64 size = (static_cast<quint64>(fileData.nFileSizeHigh) << 32) | fileData.nFileSizeLow;
+  return (size == origin.size) && (toInt(fileData.ftLastWriteTime) == origin.lastWriteTime);
+}
+
+bool DirectorySnapshot::isUnchanged(const std::wstring &path, bool archive) const
+{
+  const OriginRecord *origin = findOrigin(path);
+  if ((origin == nullptr) || ((origin->archive != 0) != archive)) {
+    return false;
+  }
+  return archive ? archiveUnchanged(path, *origin) : directoryUnchanged(path, *origin);
+}
+
+std::vector<std::wstring> DirectorySnapshot::archives() const
+{
+  std::vector<std::wstring> result;
+  if (m_Header != nullptr) {
+    for (quint32 i = 0; i < m_Header->numOrigins; ++i) {
+      if (m_Origins[i].archive != 0) {
+        result.push_back(string(m_Origins[i].path));
+      }
+    }
+  }
+  return result;
+}
+
+bool DirectorySnapshot::restoreDirectory(const std::wstring &path, OriginScan &scan) const
+{
+  const OriginRecord *origin = findOrigin(path);
+  if ((origin == nullptr) || (origin->archive != 0) || !directoryUnchanged(path, *origin)) {
+    return false;
+  }
+
+  std::vector<OriginScan::Entry> entries;
+  restoreEntries(*origin, entries);
+  scan.restore(false, toFileTime(origin->lastWriteTime), 0, std::move(entries));
+  return true;
+}
+
+bool DirectorySnapshot::restoreArchive(const std::wstring &fileName, OriginScan &scan) const
+{
+  const OriginRecord *origin = findOrigin(fileName);
+  if ((origin == nullptr) || (origin->archive == 0) || !archiveUnchanged(fileName, *origin)) {
+    return false;
+  }
+
+  std::vector<OriginScan::Entry> entries;
+  restoreEntries(*origin, entries);
+  scan.restore(true, toFileTime(origin->lastWriteTime), origin->size, std::move(entries));
+  return true;
+}
+
+
+//
+// DirectorySnapshotWriter
+//
+
+quint32 DirectorySnapshotWriter::addString(const std::wstring &value)
+{
+  auto iter = m_StringIndex.find(value);
+  if (iter != m_StringIndex.end()) {
+    return iter->second;
+  }
+
+  DirectorySnapshot::StringRecord record;
+  record.offset = static_cast<quint32>(m_StringData.size());
+  record.length = static_cast<quint32>(value.length());
+  m_StringData.insert(m_StringData.end(), value.begin(), value.end());
+
+  quint32 index = static_cast<quint32>(m_Strings.size());
+  m_Strings.push_back(record);
+  m_StringIndex[value] = index;
+  return index;
+}
+
+void DirectorySnapshotWriter::add(const std::wstring &path, const OriginScan &scan)
+{
+  DirectorySnapshot::OriginRecord origin;
+  origin.path = addString(path);
+  origin.archive = scan.isArchive() ? 1 : 0;
+  origin.size = scan.size();
+  origin.lastWriteTime = toInt(scan.lastWriteTime());
+  origin.firstEntry = static_cast<quint32>(m_Entries.size());
+  origin.numEntries = static_cast<quint32>(scan.entries().size());
+  m_Origins.push_back(origin);
+  m_OriginPaths.insert(origin.path);
+
+  for (const OriginScan::Entry &entry : scan.entries()) {
+    DirectorySnapshot::EntryRecord record;
+    record.type = static_cast<quint32>(entry.type);
+    record.name = addString(entry.name);
+    record.fileTime = toInt(entry.fileTime);
+    m_Entries.push_back(record);
+  }
+}
+
+bool DirectorySnapshotWriter::add(const DirectorySnapshot &snapshot, const std::wstring &path)
+{
+  const DirectorySnapshot::OriginRecord *source = snapshot.findOrigin(path);
+  if (source == nullptr) {
+    return false;
+  }
+
+  DirectorySnapshot::OriginRecord origin = *source;
+  origin.path = addString(path);
+  origin.firstEntry = static_cast<quint32>(m_Entries.size());
+  m_Origins.push_back(origin);
+  m_OriginPaths.insert(origin.path);
+
+  for (quint32 i = source->firstEntry; i < source->firstEntry + source->numEntries; ++i) {
+    DirectorySnapshot::EntryRecord record = snapshot.m_Entries[i];
+    record.name = addString(snapshot.string(record.name));
+    m_Entries.push_back(record);
+  }
+  return true;
+}
+
+bool DirectorySnapshotWriter::contains(const std::wstring &path) const
+{
+  auto iter = m_StringIndex.find(path);
+  return (iter != m_StringIndex.end()) && (m_OriginPaths.find(iter->second) != m_OriginPaths.end());
+}
+
+bool DirectorySnapshotWriter::write(const QString &fileName, quint64 modListHash) const
+{
+  QByteArray data;
+  data.reserve(static_cast<int>(sizeof(DirectorySnapshot::Header)
+                                + m_Origins.size() * sizeof(DirectorySnapshot::OriginRecord)
+                                + m_Entries.size() * sizeof(DirectorySnapshot::EntryRecord)
+                                + m_Strings.size() * sizeof(DirectorySnapshot::StringRecord)
+                                + m_StringData.size() * sizeof(wchar_t)));
+
+  DirectorySnapshot::Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.version = SNAPSHOT_VERSION;
+  header.numOrigins = static_cast<quint32>(m_Origins.size());
+  header.numEntries = static_cast<quint32>(m_Entries.size());
+  header.numStrings = static_cast<quint32>(m_Strings.size());
+  header.stringDataLength = m_StringData.size();
+  header.modListHash = modListHash;
+
+  data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  data.append(reinterpret_cast<const char*>(m_Origins.data()),
+              static_cast<int>(m_Origins.size() * sizeof(DirectorySnapshot::OriginRecord)));
+  data.append(reinterpret_cast<const char*>(m_Entries.data()),
+              static_cast<int>(m_Entries.size() * sizeof(DirectorySnapshot::EntryRecord)));
+  data.append(reinterpret_cast<const char*>(m_Strings.data()),
+              static_cast<int>(m_Strings.size() * sizeof(DirectorySnapshot::StringRecord)));
+  data.append(reinterpret_cast<const char*>(m_StringData.data()),
+              static_cast<int>(m_StringData.size() * sizeof(wchar_t)));
+
+  header.checksum = checksum(reinterpret_cast<const uchar*>(data.constData()) + sizeof(header),
+                             data.size() - sizeof(header));
+  memcpy(data.data(), &header, sizeof(header));
+
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly)
+      || (file.write(data) != data.size())
+      || !file.commit()) {
+    qWarning("failed to write directory snapshot %s: %s",
+             qPrintable(fileName), qPrintable(file.errorString()));
+    return false;
+  }
+  return true;
+}
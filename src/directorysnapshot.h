@@ -0,0 +1,219 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIRECTORYSNAPSHOT_H
+#define DIRECTORYSNAPSHOT_H
+
+#include <directoryentry.h>
+#include <QFile>
+#include <QString>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+
+/**
+ * @brief read access to the snapshot of the listings the directory structure was built from
+ *
+ * The snapshot stores the listing of every origin (mod directory, data directory or bsa) that went
+ * into the last directory structure. The file is memory mapped and listings are only read when they
+ * are requested. A listing is handed out only if the origin is unchanged on disk, otherwise the
+ * caller has to scan it again. Directories count as unchanged if listing them gives the stored names
+ * and modification times, so files edited in place are noticed. Since the structure is always built from listings, a structure
+ * built from the snapshot is identical to one built from a fresh scan.
+ **/
+class DirectorySnapshot
+{
+
+public:
+
+  DirectorySnapshot();
+  ~DirectorySnapshot();
+
+  /**
+   * @brief map the snapshot file. A missing, outdated or corrupt file is ignored
+   * @param fileName path of the snapshot
+   * @return true if the snapshot can be used
+   **/
+  bool load(const QString &fileName);
+
+  /**
+   * @brief unmap the snapshot. This has to happen before the file can be replaced
+   **/
+  void close();
+
+  /**
+   * @return hash of the mod list the snapshot was written for, 0 if no snapshot is loaded
+   **/
+  quint64 modListHash() const;
+
+  /**
+   * @brief retrieve the listing of a directory if it didn't change since the snapshot was written.
+   *        Can be called from multiple threads concurrently
+   * @param path absolute path of the directory
+   * @param scan receives the listing
+   * @return true if the listing is valid, false if the directory has to be scanned
+   **/
+  bool restoreDirectory(const std::wstring &path, MOShared::OriginScan &scan) const;
+
+  /**
+   * @brief retrieve the listing of an archive if it didn't change since the snapshot was written.
+   *        Can be called from multiple threads concurrently
+   * @param fileName absolute path of the archive
+   * @param scan receives the listing
+   * @return true if the listing is valid, false if the archive has to be parsed
+   **/
+  bool restoreArchive(const std::wstring &fileName, MOShared::OriginScan &scan) const;
+
+  /**
+   * @brief test if a directory or archive is unchanged since the snapshot was written without
+   *        retrieving its listing. Can be called from multiple threads concurrently
+   * @param path absolute path of the directory or archive
+   * @param archive true if the path refers to an archive
+   * @return true if the snapshot contains an up-to-date listing
+   **/
+  bool isUnchanged(const std::wstring &path, bool archive) const;
+
+  /**
+   * @return paths of all archives the snapshot contains listings for
+   **/
+  std::vector<std::wstring> archives() const;
+
+private:
+
+  // the file consists of the header followed by the origin, entry and string tables and the
+  // string data. All records are fixed size so the tables can be used in place
+
+  struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 numOrigins;
+    quint32 numEntries;
+    quint32 numStrings;
+    quint64 stringDataLength; // in characters
+    quint64 modListHash;
+    quint64 checksum; // of everything following the header
+  };
+
+  struct OriginRecord {
+    quint32 path;       // string index
+    quint32 archive;    // 1 for archives, 0 for directories
+    quint64 size;
+    quint64 lastWriteTime;
+    quint32 firstEntry;
+    quint32 numEntries;
+  };
+
+  struct EntryRecord {
+    quint32 type;       // OriginScan::EntryType
+    quint32 name;       // string index
+    quint64 fileTime;
+  };
+
+  struct StringRecord {
+    quint32 offset;     // in characters
+    quint32 length;
+  };
+
+  friend class DirectorySnapshotWriter;
+
+private:
+
+  bool validate(qint64 size);
+
+  const OriginRecord *findOrigin(const std::wstring &path) const;
+  std::wstring string(quint32 index) const;
+
+  bool directoryUnchanged(const std::wstring &path, const OriginRecord &origin) const;
+  bool listingUnchanged(const std::wstring &path, quint32 &next, quint32 end) const;
+  bool nameEquals(quint32 index, const wchar_t *name) const;
+  bool archiveUnchanged(const std::wstring &fileName, const OriginRecord &origin) const;
+
+  void restoreEntries(const OriginRecord &origin, std::vector<MOShared::OriginScan::Entry> &entries) const;
+
+private:
+
+  QFile m_File;
+  const uchar *m_Data;
+
+  const Header *m_Header;
+  const OriginRecord *m_Origins;
+  const EntryRecord *m_Entries;
+  const StringRecord *m_Strings;
+  const wchar_t *m_StringData;
+
+  std::unordered_map<std::wstring, quint32> m_OriginIndex;
+
+};
+
+
+/**
+ * @brief assembles a new snapshot while the directory structure is being built
+ **/
+class DirectorySnapshotWriter
+{
+
+public:
+
+  /**
+   * @brief add the listing of an origin. Listings that were restored from the previous snapshot
+   *        have to be added too, otherwise they are missing from the next one
+   * @param path absolute path of the directory or archive the listing was generated from
+   * @param scan the listing
+   **/
+  void add(const std::wstring &path, const MOShared::OriginScan &scan);
+
+  /**
+   * @brief copy the listing of an unchanged origin from the previous snapshot
+   * @param snapshot the previous snapshot, has to be loaded
+   * @param path absolute path of the directory or archive
+   * @return false if the snapshot doesn't contain the origin
+   **/
+  bool add(const DirectorySnapshot &snapshot, const std::wstring &path);
+
+  /**
+   * @return true if a listing for the specified path was added
+   **/
+  bool contains(const std::wstring &path) const;
+
+  /**
+   * @brief write the snapshot
+   * @param fileName target file. It's replaced atomically
+   * @param modListHash hash of the mod list the snapshot belongs to
+   * @return true on success
+   **/
+  bool write(const QString &fileName, quint64 modListHash) const;
+
+private:
+
+  quint32 addString(const std::wstring &value);
+
+private:
+
+  std::vector<DirectorySnapshot::OriginRecord> m_Origins;
+  std::vector<DirectorySnapshot::EntryRecord> m_Entries;
+  std::vector<DirectorySnapshot::StringRecord> m_Strings;
+  std::vector<wchar_t> m_StringData;
+  std::unordered_map<std::wstring, quint32> m_StringIndex;
+  std::unordered_set<quint32> m_OriginPaths; // string indices
+
+};
+
+#endif // DIRECTORYSNAPSHOT_H
@@ -357,6 +357,7 @@ MainWindow::MainWindow(QSettings &initSettings
   connect(ui->toolBar, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(toolBar_customContextMenuRequested(QPoint)));
 
   connect(&m_OrganizerCore, &OrganizerCore::modInstalled, this, &MainWindow::modInstalled);
+  connect(&m_OrganizerCore, &OrganizerCore::modPrioritiesChanged, this, &MainWindow::modPrioritiesChanged);
   connect(&m_OrganizerCore, &OrganizerCore::close, this, &QMainWindow::close);
 
   connect(&m_IntegratedBrowser, SIGNAL(requestDownload(QUrl,QNetworkReply*)), &m_OrganizerCore, SLOT(requestDownload(QUrl,QNetworkReply*)));
@@ -1116,26 +1117,29 @@ void MainWindow::on_profileBox_currentIndexChanged(int index)
 void MainWindow::updateTo(QTreeWidgetItem *subTree, const std::wstring &directorySoFar, const DirectoryEntry &directoryEntry, bool conflictsOnly)
 {
   {
-    for (const FileEntry::Ptr current : directoryEntry.getFiles()) {
+    std::wstring fullPath;
+    // in the order of their names, the view doesn't separate files with equal sort values
+    directoryEntry.forEachFileSorted([&] (const FileEntry &file) -> bool {
+      const FileEntry *current = &file;
       if (conflictsOnly && (current->getAlternatives().size() == 0)) {
-        continue;
+        return true;
       }
 
       QString fileName = ToQString(current->getName());
       QStringList columns(fileName);
       bool isArchive = false;
       int originID = current->getOrigin(isArchive);
-      FilesOrigin origin = m_OrganizerCore.directoryStructure()->getOriginByID(originID);
+      const FilesOrigin &origin = m_OrganizerCore.directoryStructure()->getOriginByID(originID);
       QString source("data");
-      unsigned int modIndex = ModInfo::getIndex(ToQString(origin.getName()));
+      unsigned int modIndex = ModInfo::getIndex(origin);
       if (modIndex != UINT_MAX) {
         ModInfo::Ptr modInfo = ModInfo::getByIndex(modIndex);
         source = modInfo->name();
       }
 
-      std::pair<std::wstring, int> archive = current->getArchive();
-      if (archive.first.length() != 0) {
-        source.append(" (").append(ToQString(archive.first)).append(")");
+      PooledString archive = current->getArchiveName();
+      if (archive.length() != 0) {
+        source.append(" (").append(ToQString(archive)).append(")");
       }
       columns.append(source);
       QTreeWidgetItem *fileChild = new QTreeWidgetItem(columns);
@@ -1150,17 +1154,18 @@ void MainWindow::updateTo(QTreeWidgetItem *subTree, const std::wstring &director
         fileChild->setFont(0, font);
         fileChild->setFont(1, font);
       }
-      fileChild->setData(0, Qt::UserRole, ToQString(current->getFullPath()));
+      current->getFullPath(fullPath);
+      fileChild->setData(0, Qt::UserRole, ToQString(fullPath));
       fileChild->setData(0, Qt::UserRole + 1, isArchive);
       fileChild->setData(1, Qt::UserRole, source);
       fileChild->setData(1, Qt::UserRole + 1, originID);
 
-      std::vector<std::pair<int, std::pair<std::wstring, int>>> alternatives = current->getAlternatives();
+      FileEntry::Alternatives alternatives = current->getAlternatives();
 
       if (!alternatives.empty()) {
         std::wostringstream altString;
         altString << ToWString(tr("Also in: <br>"));
-        for (std::vector<std::pair<int, std::pair<std::wstring, int>>>::iterator altIter = alternatives.begin();
+        for (FileEntry::Alternatives::const_iterator altIter = alternatives.begin();
              altIter != alternatives.end(); ++altIter) {
           if (altIter != alternatives.begin()) {
             altString << " , ";
@@ -1173,15 +1178,15 @@ void MainWindow::updateTo(QTreeWidgetItem *subTree, const std::wstring &director
         fileChild->setToolTip(1, tr("No conflict"));
       }
       subTree->addChild(fileChild);
-    }
+      return true;
+    });
   }
 
   std::wostringstream temp;
-  temp << directorySoFar << "\\" << directoryEntry.getName();
+  temp << directorySoFar << "\\" << directoryEntry.getName().c_str();
   {
-    std::vector<DirectoryEntry*>::const_iterator current, end;
-    directoryEntry.getSubDirectories(current, end);
-    for (; current != end; ++current) {
+    Span<DirectoryEntry*> subDirectories = directoryEntry.getSubDirectories();
+    for (auto current = subDirectories.begin(); current != subDirectories.end(); ++current) {
       QString pathName = ToQString((*current)->getName());
       QStringList columns(pathName);
       columns.append("");
@@ -1431,7 +1436,21 @@ void MainWindow::updateBSAList(const QStringList &defaultArchives, const QString
   std::vector<std::pair<UINT32, QTreeWidgetItem*>> items;
 
   BSAInvalidation * invalidation = m_OrganizerCore.managedGame()->feature<BSAInvalidation>();
-  std::vector<FileEntry::Ptr> files = m_OrganizerCore.directoryStructure()->getFiles();
+  // archives in the order of their names, sorting the items below doesn't separate archives with
+  // equal sort values
+  std::vector<const FileEntry*> files;
+  m_OrganizerCore.directoryStructure()->forEachFile([&] (const FileEntry &file) -> bool {
+    PooledString name = file.getName();
+    if ((name.length() >= 4)
+        && ((_wcsicmp(name.c_str() + name.length() - 4, L".bsa") == 0)
+            || (_wcsicmp(name.c_str() + name.length() - 4, L".ba2") == 0))) {
+      files.push_back(&file);
+    }
+    return true;
+  });
+  std::sort(files.begin(), files.end(), [] (const FileEntry *lhs, const FileEntry *rhs) {
+    return *lhs < *rhs;
+  });
 
   QStringList plugins = m_OrganizerCore.findFiles("", [](const QString &fileName) -> bool {
     return fileName.endsWith(".esp", Qt::CaseInsensitive)
@@ -1450,7 +1469,7 @@ void MainWindow::updateBSAList(const QStringList &defaultArchives, const QString
     return false;
   };
 
-  for (FileEntry::Ptr current : files) {
+  for (const FileEntry *current : files) {
     QFileInfo fileInfo(ToQString(current->getName().c_str()));
 
     if (fileInfo.suffix().toLower() == "bsa" || fileInfo.suffix().toLower() == "ba2") {
@@ -1498,14 +1517,14 @@ void MainWindow::updateBSAList(const QStringList &defaultArchives, const QString
       items.push_back(std::make_pair(sortValue, newItem));
     }
   }
-  std::sort(items.begin(), items.end(), BySortValue);
+  std::stable_sort(items.begin(), items.end(), BySortValue);
 
   for (auto iter = items.begin(); iter != items.end(); ++iter) {
     int originID = iter->second->data(1, Qt::UserRole).toInt();
 
-    FilesOrigin origin = m_OrganizerCore.directoryStructure()->getOriginByID(originID);
+    const FilesOrigin &origin = m_OrganizerCore.directoryStructure()->getOriginByID(originID);
     QString modName("data");
-    unsigned int modIndex = ModInfo::getIndex(ToQString(origin.getName()));
+    unsigned int modIndex = ModInfo::getIndex(origin);
     if (modIndex != UINT_MAX) {
       ModInfo::Ptr modInfo = ModInfo::getByIndex(modIndex);
       modName = modInfo->name();
@@ -1990,18 +2009,10 @@ void MainWindow::directory_refreshed()
 
 void MainWindow::modorder_changed()
 {
-  for (unsigned int i = 0; i < m_OrganizerCore.currentProfile()->numMods(); ++i) {
-    int priority = m_OrganizerCore.currentProfile()->getModPriority(i);
-    if (m_OrganizerCore.currentProfile()->modEnabled(i)) {
-      ModInfo::Ptr modInfo = ModInfo::getByIndex(i);
-      // priorities in the directory structure are one higher because data is 0
-      m_OrganizerCore.directoryStructure()->getOriginByName(ToWString(modInfo->internalName())).setPriority(priority + 1);
-    }
-  }
+  m_OrganizerCore.updateModPriorities();
   m_OrganizerCore.refreshBSAList();
   m_OrganizerCore.currentProfile()->writeModlist();
   m_ArchiveListWriter.write();
-  m_OrganizerCore.directoryStructure()->getFileRegister()->sortOrigins();
 
   { // refresh selection
     QModelIndex current = ui->modList->currentIndex();
@@ -2032,6 +2043,18 @@ void MainWindow::modorder_changed()
   }
 }
 
+void MainWindow::modPrioritiesChanged(const QStringList &modNames)
+{
+  // the moved mods and the mods they share files with, the conflict markers of other rows stay
+  // the same
+  for (const QString &modName : modNames) {
+    unsigned int index = ModInfo::getIndex(modName);
+    if (index != UINT_MAX) {
+      m_OrganizerCore.modList()->notifyChange(index);
+    }
+  }
+}
+
 void MainWindow::modInstalled(const QString &modName)
 {
   QModelIndexList posList =
@@ -2077,7 +2100,7 @@ void MainWindow::modRenamed(const QString &oldName, const QString &newName)
   // also fix the directory structure
   try {
     if (m_OrganizerCore.directoryStructure()->originExists(ToWString(oldName))) {
-      FilesOrigin &origin = m_OrganizerCore.directoryStructure()->getOriginByName(ToWString(oldName));
+      FilesOrigin &origin = m_OrganizerCore.modifiableStructure()->getOriginByName(ToWString(oldName));
       origin.setName(ToWString(newName));
     } else {
 
@@ -2089,21 +2112,25 @@ void MainWindow::modRenamed(const QString &oldName, const QString &newName)
 
 void MainWindow::fileMoved(const QString &filePath, const QString &oldOriginName, const QString &newOriginName)
 {
-  const FileEntry::Ptr filePtr = m_OrganizerCore.directoryStructure()->findFile(ToWString(filePath));
+  DirectoryEntry *structure = m_OrganizerCore.directoryStructure();
+  if (structure->findFile(ToWString(filePath)).get() != nullptr) {
+    structure = m_OrganizerCore.modifiableStructure();
+  }
+  const FileEntry::Ptr filePtr = structure->findFile(ToWString(filePath));
   if (filePtr.get() != nullptr) {
     try {
-      if (m_OrganizerCore.directoryStructure()->originExists(ToWString(newOriginName))) {
-        FilesOrigin &newOrigin = m_OrganizerCore.directoryStructure()->getOriginByName(ToWString(newOriginName));
+      if (structure->originExists(ToWString(newOriginName))) {
+        FilesOrigin &newOrigin = structure->getOriginByName(ToWString(newOriginName));
 
         QString fullNewPath = ToQString(newOrigin.getPath()) + "\\" + filePath;
         WIN32_FIND_DATAW findData;
 		HANDLE hFind;
 		hFind = ::FindFirstFileW(ToWString(fullNewPath).c_str(), &findData);
-        filePtr->addOrigin(newOrigin.getID(), findData.ftCreationTime, L"", -1);
+        filePtr->addOrigin(newOrigin.getID(), findData.ftCreationTime, StringPool::EMPTY, -1);
 		FindClose(hFind);
       }
-      if (m_OrganizerCore.directoryStructure()->originExists(ToWString(oldOriginName))) {
-        FilesOrigin &oldOrigin = m_OrganizerCore.directoryStructure()->getOriginByName(ToWString(oldOriginName));
+      if (structure->originExists(ToWString(oldOriginName))) {
+        FilesOrigin &oldOrigin = structure->getOriginByName(ToWString(oldOriginName));
         filePtr->removeOrigin(oldOrigin.getID());
       }
     } catch (const std::exception &e) {
@@ -2483,21 +2510,21 @@ void MainWindow::displayModInformation(ModInfo::Ptr modInfo, unsigned int index,
 
   if (m_OrganizerCore.currentProfile()->modEnabled(index)
       && !modInfo->hasFlag(ModInfo::FLAG_FOREIGN)) {
-    FilesOrigin& origin = m_OrganizerCore.directoryStructure()->getOriginByName(ToWString(modInfo->name()));
+    DirectoryEntry *structure = m_OrganizerCore.modifiableStructure();
+    FilesOrigin& origin = structure->getOriginByName(ToWString(modInfo->name()));
     origin.enable(false);
 
-    if (m_OrganizerCore.directoryStructure()->originExists(ToWString(modInfo->name()))) {
-      FilesOrigin& origin = m_OrganizerCore.directoryStructure()->getOriginByName(ToWString(modInfo->name()));
+    if (structure->originExists(ToWString(modInfo->name()))) {
+      FilesOrigin& origin = structure->getOriginByName(ToWString(modInfo->name()));
       origin.enable(false);
 
-      m_OrganizerCore.directoryRefresher()->addModToStructure(m_OrganizerCore.directoryStructure()
+      m_OrganizerCore.directoryRefresher()->addModToStructure(structure
                                              , modInfo->name()
                                              , m_OrganizerCore.currentProfile()->getModPriority(index)
                                              , modInfo->absolutePath()
                                              , modInfo->stealFiles()
                                              , modInfo->archives());
-      DirectoryRefresher::cleanStructure(m_OrganizerCore.directoryStructure());
-      m_OrganizerCore.directoryStructure()->getFileRegister()->sortOrigins();
+      DirectoryRefresher::cleanStructure(structure);
       m_OrganizerCore.refreshLists();
     }
   }
@@ -2674,9 +2701,7 @@ void MainWindow::createModFromOverwrite()
     return;
   }
 
-  unsigned int overwriteIndex = ModInfo::findMod([](ModInfo::Ptr mod) -> bool {
-    std::vector<ModInfo::EFlag> flags = mod->getFlags();
-    return std::find(flags.begin(), flags.end(), ModInfo::FLAG_OVERWRITE) != flags.end(); });
+  unsigned int overwriteIndex = ModInfo::getOverwriteIndex();
 
   ModInfo::Ptr overwriteInfo = ModInfo::getByIndex(overwriteIndex);
   shellMove(QStringList(QDir::toNativeSeparators(overwriteInfo->absolutePath()) + "\\*"),
@@ -2687,11 +2712,7 @@ void MainWindow::createModFromOverwrite()
 
 void MainWindow::clearOverwrite()
 {
-  unsigned int overwriteIndex = ModInfo::findMod([](ModInfo::Ptr mod) -> bool {
-    std::vector<ModInfo::EFlag> flags = mod->getFlags();
-    return std::find(flags.begin(), flags.end(), ModInfo::FLAG_OVERWRITE)
-      != flags.end();
-  });
+  unsigned int overwriteIndex = ModInfo::getOverwriteIndex();
 
   ModInfo::Ptr modInfo = ModInfo::getByIndex(overwriteIndex);
   if (modInfo)
@@ -3760,26 +3781,25 @@ void MainWindow::languageChange(const QString &newLanguage)
 
 void MainWindow::writeDataToFile(QFile &file, const QString &directory, const DirectoryEntry &directoryEntry)
 {
-  for (FileEntry::Ptr current : directoryEntry.getFiles()) {
+  directoryEntry.forEachFileSorted([&] (const FileEntry &current) -> bool {
     bool isArchive = false;
-    int origin = current->getOrigin(isArchive);
+    int origin = current.getOrigin(isArchive);
     if (isArchive) {
       // TODO: don't list files from archives. maybe make this an option?
-      continue;
+      return true;
     }
-    QString fullName = directory + "\\" + ToQString(current->getName());
+    QString fullName = directory + "\\" + ToQString(current.getName());
     file.write(fullName.toUtf8());
 
     file.write("\t(");
     file.write(ToQString(m_OrganizerCore.directoryStructure()->getOriginByID(origin).getName()).toUtf8());
     file.write(")\r\n");
-  }
+    return true;
+  });
 
   // recurse into subdirectories
-  std::vector<DirectoryEntry*>::const_iterator current, end;
-  directoryEntry.getSubDirectories(current, end);
-  for (; current != end; ++current) {
-    writeDataToFile(file, directory + "\\" + ToQString((*current)->getName()), **current);
+  for (const DirectoryEntry *current : directoryEntry.getSubDirectories()) {
+    writeDataToFile(file, directory + "\\" + ToQString(current->getName()), *current);
   }
 }
 
@@ -3888,10 +3908,12 @@ void MainWindow::addAsExecutable()
 
 void MainWindow::originModified(int originID)
 {
-  FilesOrigin &origin = m_OrganizerCore.directoryStructure()->getOriginByID(originID);
+  DirectoryEntry *structure = m_OrganizerCore.modifiableStructure();
+  FilesOrigin &origin = structure->getOriginByID(originID);
   origin.enable(false);
-  m_OrganizerCore.directoryStructure()->addFromOrigin(origin.getName(), origin.getPath(), origin.getPriority());
-  DirectoryRefresher::cleanStructure(m_OrganizerCore.directoryStructure());
+  structure->pruneOrigin(originID);
+  structure->addFromOrigin(origin.getName(), origin.getPath(), origin.getPriority());
+  DirectoryRefresher::cleanStructure(structure);
 }
 
 
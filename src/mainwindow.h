@@ -459,6 +459,7 @@ private slots:
   void modDetailsUpdated(bool success);
 
   void modInstalled(const QString &modName);
+  void modPrioritiesChanged(const QStringList &modNames);
 
   void nxmUpdatesAvailable(const std::vector<int> &modIDs, QVariant userData, QVariant resultData, int requestID);
   void nxmEndorsementToggled(QString, int, QVariant, QVariant resultData, int);
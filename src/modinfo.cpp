@@ -30,6 +30,11 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #include "overwriteinfodialog.h"
 #include "filenamestring.h"
 #include "versioninfo.h"
+#include "nexusinterface.h"
+#include "modmetastore.h"
+#include "settings.h"
+#include "utility.h"
+#include "directoryentry.h"
 
 #include <iplugingame.h>
 #include <versioninfo.h>
@@ -39,22 +44,58 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QApplication>
 #include <QDirIterator>
+#include <QElapsedTimer>
 #include <QMutexLocker>
 #include <QSettings>
+#include <QThread>
+
+#include <atomic>
+#include <exception>
+#include <thread>
 
 using namespace MOBase;
 using namespace MOShared;
 
 
+QReadWriteLock ModInfo::s_Lock(QReadWriteLock::Recursive);
 std::vector<ModInfo::Ptr> ModInfo::s_Collection;
-std::map<QString, unsigned int> ModInfo::s_ModsByName;
-std::map<int, std::vector<unsigned int> > ModInfo::s_ModsByModID;
+QHash<QString, unsigned int> ModInfo::s_ModsByName;
+QHash<int, std::vector<unsigned int> > ModInfo::s_ModsByModID;
+QHash<int, ModInfo::OriginIndex> ModInfo::s_ModsByOrigin;
+ModInfo::Ptr ModInfo::s_Overwrite;
+unsigned int ModInfo::s_OverwriteIndex = UINT_MAX;
 int ModInfo::s_NextID;
-QMutex ModInfo::s_Mutex(QMutex::Recursive);
 
 QString ModInfo::s_HiddenExt(".mohidden");
 
 
+namespace {
+
+// counts lookups and their accumulated duration for the diagnostics log
+struct LookupStatistics {
+  std::atomic<quint64> count { 0 };
+  std::atomic<quint64> nsecs { 0 };
+  std::atomic<quint64> misses { 0 };
+};
+
+LookupStatistics s_NameLookups;
+LookupStatistics s_OriginLookups;
+
+class LookupTimer {
+public:
+  explicit LookupTimer(LookupStatistics &statistics) : m_Statistics(statistics) { m_Timer.start(); }
+  ~LookupTimer() {
+    ++m_Statistics.count;
+    m_Statistics.nsecs += static_cast<quint64>(m_Timer.nsecsElapsed());
+  }
+private:
+  LookupStatistics &m_Statistics;
+  QElapsedTimer m_Timer;
+};
+
+}
+
+
 bool ModInfo::ByName(const ModInfo::Ptr &LHS, const ModInfo::Ptr &RHS)
 {
   return QString::compare(LHS->name(), RHS->name(), Qt::CaseInsensitive) < 0;
@@ -63,16 +104,76 @@ bool ModInfo::ByName(const ModInfo::Ptr &LHS, const ModInfo::Ptr &RHS)
 
 ModInfo::Ptr ModInfo::createFrom(PluginContainer *pluginContainer, QString gameName, const QDir &dir, DirectoryEntry **directoryStructure)
 {
-  QMutexLocker locker(&s_Mutex);
 //  int id = s_NextID++;
-  static QRegExp backupExp(".*backup[0-9]*");
-  ModInfo::Ptr result;
+  ModInfo::Ptr result = construct(pluginContainer, gameName, dir, directoryStructure, QThread::currentThread());
+  QWriteLocker locker(&s_Lock);
+  s_Collection.push_back(result);
+  return result;
+}
+
+ModInfo::Ptr ModInfo::construct(PluginContainer *pluginContainer, const QString &gameName, const QDir &dir,
+                                DirectoryEntry **directoryStructure, QThread *thread)
+{
+  // not static, matching changes the state of the expression
+  QRegExp backupExp(".*backup[0-9]*");
+  ModInfoRegular *result;
   if (backupExp.exactMatch(dir.dirName())) {
-    result = ModInfo::Ptr(new ModInfoBackup(pluginContainer, gameName, dir, directoryStructure));
+    result = new ModInfoBackup(pluginContainer, gameName, dir, directoryStructure);
   } else {
-    result = ModInfo::Ptr(new ModInfoRegular(pluginContainer, gameName, dir, directoryStructure));
+    result = new ModInfoRegular(pluginContainer, gameName, dir, directoryStructure);
+  }
+  if (thread != QThread::currentThread()) {
+    result->moveToThread(thread);
+    result->m_NexusBridge.moveToThread(thread);
+  }
+  return ModInfo::Ptr(result);
+}
+
+std::vector<ModInfo::Ptr> ModInfo::createFromDirectories(PluginContainer *pluginContainer, const QString &gameName,
+                                                         const QStringList &directories,
+                                                         DirectoryEntry **directoryStructure,
+                                                         int threadCount)
+{
+  // creating a mod is mostly waiting for the disk (listing the directory, reading meta.ini) so
+  // the mods are spread over several threads
+  std::vector<ModInfo::Ptr> result(directories.size());
+  QThread *thread = QThread::currentThread();
+
+  // singletons the constructors use are created on first use, that must not happen concurrently.
+  // The nexus interface also has to belong to this thread
+  NexusInterface::instance(pluginContainer);
+  CategoryFactory::instance();
+
+  std::atomic<int> nextMod(0);
+  std::vector<std::exception_ptr> errors;
+  QMutex errorMutex;
+  auto worker = [&] () {
+    for (int idx = nextMod++; idx < directories.size(); idx = nextMod++) {
+      try {
+        result[idx] = construct(pluginContainer, gameName, QDir(directories.at(idx)), directoryStructure, thread);
+      } catch (...) {
+        QMutexLocker locker(&errorMutex);
+        errors.push_back(std::current_exception());
+      }
+    }
+  };
+
+  if (threadCount <= 0) {
+    threadCount = QThread::idealThreadCount();
+  }
+  threadCount = std::min(threadCount, directories.size());
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threadCount; ++i) {
+    workers.push_back(std::thread(worker));
+  }
+  worker();
+  for (std::thread &workerThread : workers) {
+    workerThread.join();
+  }
+
+  if (!errors.empty()) {
+    std::rethrow_exception(errors.front());
   }
-  s_Collection.push_back(result);
   return result;
 }
 
@@ -82,9 +183,9 @@ ModInfo::Ptr ModInfo::createFromPlugin(const QString &modName,
                                        ModInfo::EModType modType,
                                        DirectoryEntry **directoryStructure,
                                        PluginContainer *pluginContainer) {
-  QMutexLocker locker(&s_Mutex);
   ModInfo::Ptr result = ModInfo::Ptr(
       new ModInfoForeign(modName, espName, bsaNames, modType, directoryStructure, pluginContainer));
+  QWriteLocker locker(&s_Lock);
   s_Collection.push_back(result);
   return result;
 }
@@ -106,35 +207,140 @@ QString ModInfo::getContentTypeName(int contentType)
   }
 }
 
-void ModInfo::createFromOverwrite(PluginContainer *pluginContainer)
+unsigned int ModInfo::classifyContents(const QStringList &fileNames, const QStringList &directoryNames,
+                                       bool hasSEPlugins)
+{
+  static const struct {
+    const char *name;
+    EContent content;
+  } directories[] = {
+    { "textures",         CONTENT_TEXTURE },
+    { "meshes",           CONTENT_MESH },
+    { "interface",        CONTENT_INTERFACE },
+    { "menus",            CONTENT_INTERFACE },
+    { "music",            CONTENT_SOUND },
+    { "sound",            CONTENT_SOUND },
+    { "scripts",          CONTENT_SCRIPT },
+    { "SkyProc Patchers", CONTENT_SKYPROC },
+    { "MCM",              CONTENT_MCM }
+  };
+
+  unsigned int result = 0;
+  for (const QString &fileName : fileNames) {
+    if (fileName.endsWith(".esp", Qt::CaseInsensitive)
+        || fileName.endsWith(".esm", Qt::CaseInsensitive)
+        || fileName.endsWith(".esl", Qt::CaseInsensitive)) {
+      result |= 1U << CONTENT_PLUGIN;
+    } else if (fileName.endsWith(".bsa", Qt::CaseInsensitive)
+               || fileName.endsWith(".ba2", Qt::CaseInsensitive)) {
+      result |= 1U << CONTENT_BSA;
+    }
+  }
+  for (const QString &directoryName : directoryNames) {
+    for (const auto &directory : directories) {
+      if (directoryName.compare(directory.name, Qt::CaseInsensitive) == 0) {
+        result |= 1U << directory.content;
+      }
+    }
+  }
+  if (hasSEPlugins) {
+    result |= 1U << CONTENT_SKSE;
+  }
+  return result;
+}
+
+unsigned int ModInfo::classifyContents(const OriginScan &scan, const QString &sePluginPath)
 {
-  QMutexLocker locker(&s_Mutex);
+  QStringList sePath = QDir::fromNativeSeparators(sePluginPath).split('/', QString::SkipEmptyParts);
+  QStringList fileNames;
+  QStringList directoryNames;
+  bool hasSEPlugins = false;
+
+  // depth below the mod directory and how many of the enclosing directories match the
+  // start of the plugin path
+  int depth = 0;
+  int matched = 0;
+  for (const OriginScan::Entry &entry : scan.entries()) {
+    switch (entry.type) {
+      case OriginScan::ENTRY_DIRECTORY: {
+        if (depth == 0) {
+          directoryNames.append(ToQString(entry.name));
+        }
+        if ((matched == depth) && (depth < sePath.size())
+            && (sePath[depth].compare(ToQString(entry.name), Qt::CaseInsensitive) == 0)) {
+          ++matched;
+          hasSEPlugins = hasSEPlugins || (matched == sePath.size());
+        }
+        ++depth;
+      } break;
+      case OriginScan::ENTRY_END_DIRECTORY: {
+        --depth;
+        matched = std::min(matched, depth);
+      } break;
+      case OriginScan::ENTRY_FILE: {
+        if (depth == 0) {
+          fileNames.append(ToQString(entry.name));
+        }
+      } break;
+    }
+  }
 
-  s_Collection.push_back(ModInfo::Ptr(new ModInfoOverwrite(pluginContainer)));
+  return classifyContents(fileNames, directoryNames, hasSEPlugins);
+}
+
+QString ModInfo::scriptExtenderPluginPath()
+{
+  ScriptExtender *extender = qApp->property("managed_game")
+                                 .value<IPluginGame *>()
+                                 ->feature<ScriptExtender>();
+  return extender != nullptr ? extender->PluginPath() : QString();
+}
+
+std::vector<ModInfo::EContent> ModInfo::contentsFromMask(unsigned int contents)
+{
+  std::vector<EContent> result;
+  for (int i = 0; i < NUM_CONTENT_TYPES; ++i) {
+    if ((contents & (1U << i)) != 0) {
+      result.push_back(static_cast<EContent>(i));
+    }
+  }
+  return result;
+}
+
+void ModInfo::clear()
+{
+  std::vector<ModInfo::Ptr> previous;
+  QWriteLocker locker(&s_Lock);
+  // the mods are destroyed after the lock is released, they save their meta data on destruction
+  previous.swap(s_Collection);
+  s_Overwrite.clear();
+  updateIndices();
 }
 
 unsigned int ModInfo::getNumMods()
 {
-  QMutexLocker locker(&s_Mutex);
+  QReadLocker locker(&s_Lock);
   return static_cast<unsigned int>(s_Collection.size());
 }
 
 
 ModInfo::Ptr ModInfo::getByIndex(unsigned int index)
 {
-  QMutexLocker locker(&s_Mutex);
+  QReadLocker locker(&s_Lock);
 
-  if (index >= s_Collection.size() && index != ULONG_MAX) {
+  if (index == ULONG_MAX) {
+    index = s_OverwriteIndex;
+  }
+  if (index >= s_Collection.size()) {
     throw MyException(tr("invalid mod index %1").arg(index));
   }
-  if (index == ULONG_MAX) return s_Collection[ModInfo::getIndex("Overwrite")];
   return s_Collection[index];
 }
 
 
 std::vector<ModInfo::Ptr> ModInfo::getByModID(int modID)
 {
-  QMutexLocker locker(&s_Mutex);
+  QReadLocker locker(&s_Lock);
 
   auto iter = s_ModsByModID.find(modID);
   if (iter == s_ModsByModID.end()) {
@@ -142,8 +348,8 @@ std::vector<ModInfo::Ptr> ModInfo::getByModID(int modID)
   }
 
   std::vector<ModInfo::Ptr> result;
-  for (auto idxIter = iter->second.begin(); idxIter != iter->second.end(); ++idxIter) {
-    result.push_back(getByIndex(*idxIter));
+  for (unsigned int index : *iter) {
+    result.push_back(s_Collection[index]);
   }
 
   return result;
@@ -152,51 +358,90 @@ std::vector<ModInfo::Ptr> ModInfo::getByModID(int modID)
 
 bool ModInfo::removeMod(unsigned int index)
 {
-  QMutexLocker locker(&s_Mutex);
-
-  if (index >= s_Collection.size()) {
-    throw MyException(tr("remove: invalid mod index %1").arg(index));
-  }
-  // update the indices first
-  ModInfo::Ptr modInfo = s_Collection[index];
-  s_ModsByName.erase(s_ModsByName.find(modInfo->name()));
+  ModInfo::Ptr modInfo;
+  {
+    QWriteLocker locker(&s_Lock);
 
-  auto iter = s_ModsByModID.find(modInfo->getNexusID());
-  if (iter != s_ModsByModID.end()) {
-    std::vector<unsigned int> indices = iter->second;
-    indices.erase(std::remove(indices.begin(), indices.end(), index), indices.end());
-    s_ModsByModID[modInfo->getNexusID()] = indices;
+    if (index >= s_Collection.size()) {
+      throw MyException(tr("remove: invalid mod index %1").arg(index));
+    }
+    // remove the mod from the collection and update the indices first
+    modInfo = s_Collection[index];
+    s_Collection.erase(s_Collection.begin() + index);
+    updateIndices();
   }
 
-  // physically remove the mod directory
+  // physically remove the mod directory. This happens without holding the lock since the
+  // shell may show dialogs, which can lead to mods being looked up
   //TODO the return value is ignored because the indices were already removed here, so stopping
   // would cause data inconsistencies. Instead we go through with the removal but the mod will show up
   // again if the user refreshes
   modInfo->remove();
 
-  // finally, remove the mod from the collection
-  s_Collection.erase(s_Collection.begin() + index);
-
-  // and update the indices
-  updateIndices();
   return true;
 }
 
 
-unsigned int ModInfo::getIndex(const QString &name)
+unsigned int ModInfo::indexByName(const QString &name)
 {
-  QMutexLocker locker(&s_Mutex);
-
-  std::map<QString, unsigned int>::iterator iter = s_ModsByName.find(name);
+  auto iter = s_ModsByName.find(name);
   if (iter == s_ModsByName.end()) {
     return UINT_MAX;
   }
+  return *iter;
+}
+
+
+unsigned int ModInfo::getIndex(const QString &name)
+{
+  LookupTimer timer(s_NameLookups);
+  QReadLocker locker(&s_Lock);
+  return indexByName(name);
+}
+
+
+unsigned int ModInfo::getIndex(const FilesOrigin &origin)
+{
+  LookupTimer timer(s_OriginLookups);
+  {
+    QReadLocker locker(&s_Lock);
+    auto iter = s_ModsByOrigin.find(origin.getID());
+    if ((iter != s_ModsByOrigin.end()) && (iter->name == origin.getName())) {
+      return iter->index;
+    }
+  }
+
+  ++s_OriginLookups.misses;
+  QString name = ToQString(origin.getName());
+  QWriteLocker locker(&s_Lock);
+  unsigned int index = indexByName(name);
+  s_ModsByOrigin[origin.getID()] = { origin.getName(), index };
+  return index;
+}
+
+
+unsigned int ModInfo::getOverwriteIndex()
+{
+  QReadLocker locker(&s_Lock);
+  return s_OverwriteIndex;
+}
+
 
-  return iter->second;
+void ModInfo::logLookupStatistics()
+{
+  auto report = [](const char *type, LookupStatistics &statistics) {
+    quint64 count = statistics.count.exchange(0);
+    quint64 nsecs = statistics.nsecs.exchange(0);
+    quint64 misses = statistics.misses.exchange(0);
+    qDebug("%llu mod lookups by %s in %llu us (%llu not cached)", count, type, nsecs / 1000, misses);
+  };
+  report("name", s_NameLookups);
+  report("origin", s_OriginLookups);
 }
 
 unsigned int ModInfo::findMod(const boost::function<bool (ModInfo::Ptr)> &filter)
 {
+  QReadLocker locker(&s_Lock);
   for (unsigned int i = 0U; i < s_Collection.size(); ++i) {
     if (filter(s_Collection[i])) {
       return i;
@@ -212,17 +457,30 @@ void ModInfo::updateFromDisc(const QString &modDirectory,
                              bool displayForeign,
                              MOBase::IPluginGame const *game)
 {
-  QMutexLocker lock(&s_Mutex);
-  s_Collection.clear();
-  s_NextID = 0;
+  // the previous mods are destroyed first, they save their meta data which is then read again
+  clear();
+
+  // opened here so changing the setting takes effect with the next refresh
+  if (Settings::instance().modMetaStoreEnabled()) {
+    ModMetaStore::instance().open(qApp->property("dataPath").toString() + "/"
+                                  + ToQString(AppConfig::modMetaStoreFileName()));
+  } else {
+    ModMetaStore::instance().close();
+  }
+
+  // the mods are collected first and then published at once, lookups don't see a partial collection
+  std::vector<ModInfo::Ptr> collection;
 
   { // list all directories in the mod directory and make a mod out of each
     QDir mods(QDir::fromNativeSeparators(modDirectory));
     mods.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
     QDirIterator modIter(mods);
+    QStringList modDirectories;
     while (modIter.hasNext()) {
-      createFrom(pluginContainer, game->gameShortName(), QDir(modIter.next()), directoryStructure);
+      modDirectories.append(modIter.next());
     }
+    collection = createFromDirectories(pluginContainer, game->gameShortName(),
+                                       modDirectories, directoryStructure);
   }
 
   UnmanagedMods *unmanaged = game->feature<UnmanagedMods>();
@@ -231,19 +489,24 @@ void ModInfo::updateFromDisc(const QString &modDirectory,
       ModInfo::EModType modType = game->DLCPlugins().contains(unmanaged->referenceFile(modName).fileName(), Qt::CaseInsensitive) ? ModInfo::EModType::MOD_DLC :
                          (game->CCPlugins().contains(unmanaged->referenceFile(modName).fileName(), Qt::CaseInsensitive) ? ModInfo::EModType::MOD_CC : ModInfo::EModType::MOD_DEFAULT);
 
-      createFromPlugin(unmanaged->displayName(modName),
-                       unmanaged->referenceFile(modName).absoluteFilePath(),
-                       unmanaged->secondaryFiles(modName),
-                       modType,
-                       directoryStructure,
-                       pluginContainer);
+      collection.push_back(ModInfo::Ptr(new ModInfoForeign(unmanaged->displayName(modName),
+                                                           unmanaged->referenceFile(modName).absoluteFilePath(),
+                                                           unmanaged->secondaryFiles(modName),
+                                                           modType,
+                                                           directoryStructure,
+                                                           pluginContainer)));
     }
   }
 
-  createFromOverwrite(pluginContainer);
+  ModInfo::Ptr overwrite(new ModInfoOverwrite(pluginContainer));
+  collection.push_back(overwrite);
 
-  std::sort(s_Collection.begin(), s_Collection.end(), ModInfo::ByName);
+  std::sort(collection.begin(), collection.end(), ModInfo::ByName);
 
+  QWriteLocker locker(&s_Lock);
+  s_Collection.swap(collection);
+  s_Overwrite = overwrite;
+  s_NextID = 0;
   updateIndices();
 }
 
@@ -252,12 +515,18 @@ void ModInfo::updateIndices()
 {
   s_ModsByName.clear();
   s_ModsByModID.clear();
+  s_ModsByOrigin.clear();
+  s_OverwriteIndex = UINT_MAX;
 
+  s_ModsByName.reserve(static_cast<int>(s_Collection.size()));
   for (unsigned int i = 0; i < s_Collection.size(); ++i) {
     QString modName = s_Collection[i]->internalName();
     int modID = s_Collection[i]->getNexusID();
     s_ModsByName[modName] = i;
     s_ModsByModID[modID].push_back(i);
+    if (s_Collection[i] == s_Overwrite) {
+      s_OverwriteIndex = i;
+    }
   }
 }
 
@@ -291,9 +560,12 @@ int ModInfo::checkAllForUpdate(PluginContainer *pluginContainer, QObject *receiv
   checkChunkForUpdate(pluginContainer, modIDs, receiver, game->gameShortName());
 
   std::multimap<QString, QSharedPointer<ModInfo>> organizedGames;
-  for (auto mod : s_Collection) {
-    if (mod->canBeUpdated()) {
-      organizedGames.insert(std::pair<QString, QSharedPointer<ModInfo>>(mod->getGameName(), mod));
+  {
+    QReadLocker locker(&s_Lock);
+    for (auto mod : s_Collection) {
+      if (mod->canBeUpdated()) {
+        organizedGames.insert(std::pair<QString, QSharedPointer<ModInfo>>(mod->getGameName(), mod));
+      }
     }
   }
 
@@ -27,7 +27,10 @@ class PluginContainer;
 
 class QDateTime;
 class QDir;
+class QThread;
+#include <QHash>
 #include <QMutex>
+#include <QReadWriteLock>
 #include <QSharedPointer>
 #include <QString>
 #include <QStringList>
@@ -36,10 +39,11 @@ class QDir;
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 namespace MOBase { class IPluginGame; }
-namespace MOShared { class DirectoryEntry; }
+namespace MOShared { class DirectoryEntry; class FilesOrigin; class OriginScan; }
 
 /**
  * @brief Represents meta information about a single mod.
@@ -124,7 +128,19 @@ public:
                              bool displayForeign,
                              MOBase::IPluginGame const *game);
 
-  static void clear() { s_Collection.clear(); s_ModsByName.clear(); s_ModsByModID.clear(); }
+  /**
+   * @brief create the mods for several directories on multiple threads without adding them to the
+   *        collection. The objects are moved to the calling thread
+   * @param threadCount number of threads. 1 creates all mods on the calling thread, 0 or less picks
+   *                    a count based on the number of cores
+   * @return the mods in the order of the directories
+   */
+  static std::vector<ModInfo::Ptr> createFromDirectories(PluginContainer *pluginContainer, const QString &gameName,
+                                                         const QStringList &directories,
+                                                         MOShared::DirectoryEntry **directoryStructure,
+                                                         int threadCount = 0);
+
+  static void clear();
 
   /**
    * @brief retrieve the number of mods
@@ -170,6 +186,26 @@ public:
    **/
   static unsigned int getIndex(const QString &name);
 
+  /**
+   * @brief retrieve the index of the mod an origin of the directory structure belongs to
+   *
+   * @param origin the origin to look up
+   * @return the index of the mod. If the origin doesn't belong to a mod (i.e. the data directory),
+   *         UINT_MAX is returned
+   * @note cheaper than looking up the name of the origin, the result is cached by origin id
+   **/
+  static unsigned int getIndex(const MOShared::FilesOrigin &origin);
+
+  /**
+   * @return index of the overwrite mod, UINT_MAX if the mods haven't been read yet
+   **/
+  static unsigned int getOverwriteIndex();
+
+  /**
+   * @brief write the number and accumulated duration of mod lookups since the last call to the log
+   **/
+  static void logLookupStatistics();
+
   /**
    * @brief find the first mod that fulfills the filter function (after no particular order)
    * @param filter a function to filter by. should return true for a match
@@ -211,6 +247,32 @@ public:
    */
   static QString getContentTypeName(int contentType);
 
+  /**
+   * @brief determine the contents of a mod from the top level of its directory
+   * @param fileNames names of the files directly in the mod directory
+   * @param directoryNames names of the directories directly in the mod directory
+   * @param hasSEPlugins true if the mod contains the script extender plugin directory
+   * @return bitmask with the bit (1 << content) set for every EContent the mod provides
+   */
+  static unsigned int classifyContents(const QStringList &fileNames, const QStringList &directoryNames,
+                                       bool hasSEPlugins);
+
+  /**
+   * @brief determine the contents of a mod from the listing its origin in the directory
+   *        structure is built from. Doesn't access the disk
+   * @param scan listing of the mod directory
+   * @param sePluginPath relative path of the script extender plugin directory, empty if
+   *                     the game has no script extender
+   * @return bitmask with the bit (1 << content) set for every EContent the mod provides
+   */
+  static unsigned int classifyContents(const MOShared::OriginScan &scan, const QString &sePluginPath);
+
+  /**
+   * @return relative path of the directory script extender plugins are installed to, empty if
+   *         the managed game has no script extender
+   */
+  static QString scriptExtenderPluginPath();
+
   virtual bool isRegular() const { return false; }
 
   virtual bool isEmpty() const { return false; }
@@ -455,6 +517,11 @@ public:
    */
   virtual std::vector<EContent> getContents() const { return std::vector<EContent>(); }
 
+  /**
+   * @return the content types contained in a mod as a bitmask, see classifyContents
+   */
+  virtual unsigned int getContentsMask() const { return 0; }
+
   /**
    * @brief test if the specified flag is set for this mod
    * @param flag the flag to test
@@ -514,6 +581,16 @@ public:
    */
   virtual QStringList archives() const = 0;
 
+  /**
+   * @brief record the archives found while the mod directory was scanned so archives() doesn't
+   *        have to list the directory again. Can be called from any thread
+   * @param modPath absolute path of the scanned directory
+   * @param archives absolute paths of the archives directly in that directory
+   * @param lastModified modification time of the directory in ms since epoch, taken before the scan
+   */
+  virtual void recordArchives(const QString &modPath, const QStringList &archives, qint64 lastModified)
+  { Q_UNUSED(modPath); Q_UNUSED(archives); Q_UNUSED(lastModified); }
+
   /**
    * @brief adds the information that a file has been installed into this mod
    * @param modId id of the mod installed
@@ -621,17 +698,31 @@ protected:
 
   ModInfo(PluginContainer *pluginContainer);
 
+  // rebuilds the indices after the collection changed, the write lock has to be held
   static void updateIndices();
   static bool ByName(const ModInfo::Ptr &LHS, const ModInfo::Ptr &RHS);
 
-private:
+  /**
+   * @brief convert a bitmask produced by classifyContents to a list of content types
+   */
+  static std::vector<EContent> contentsFromMask(unsigned int contents);
 
-  static void createFromOverwrite(PluginContainer *pluginContainer);
+private:
 
+  /**
+   * @brief create the mod for a directory without adding it to the collection. Can be called from
+   *        any thread
+   * @param thread thread the new object is moved to
+   */
+  static ModInfo::Ptr construct(PluginContainer *pluginContainer, const QString &gameName, const QDir &dir,
+                                MOShared::DirectoryEntry **directoryStructure, QThread *thread);
+
 protected:
 
+  // guards the collection and the indices. Lookups only need a read lock
+  static QReadWriteLock s_Lock;
   static std::vector<ModInfo::Ptr> s_Collection;
-  static std::map<QString, unsigned int> s_ModsByName;
+  static QHash<QString, unsigned int> s_ModsByName;
 
   int m_PrimaryCategory;
   std::set<int> m_Categories;
@@ -642,8 +733,18 @@ protected:
 
 private:
 
-  static QMutex s_Mutex;
-  static std::map<int, std::vector<unsigned int> > s_ModsByModID;
+  struct OriginIndex {
+    std::wstring name; // name of the origin, ids are only unique within one directory structure
+    unsigned int index;
+  };
+
+  static unsigned int indexByName(const QString &name);
+
+  static QHash<int, std::vector<unsigned int> > s_ModsByModID;
+  // filled on demand by getIndex(const FilesOrigin&)
+  static QHash<int, OriginIndex> s_ModsByOrigin;
+  static ModInfo::Ptr s_Overwrite;
+  static unsigned int s_OverwriteIndex;
   static int s_NextID;
 
   bool m_Valid;
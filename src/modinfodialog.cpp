@@ -267,16 +267,15 @@ void ModInfoDialog::refreshLists()
   ui->overwrittenTree->clear();
 
   if (m_Origin != nullptr) {
-    std::vector<FileEntry::Ptr> files = m_Origin->getFiles();
-    for (auto iter = files.begin(); iter != files.end(); ++iter) {
-      QString relativeName = QDir::fromNativeSeparators(ToQString((*iter)->getRelativePath()));
+    m_Origin->forEachFile([&] (const FileEntry &file) -> bool {
+      QString relativeName = QDir::fromNativeSeparators(ToQString(file.getRelativePath()));
       QString fileName = relativeName.mid(0).prepend(m_RootPath);
       bool archive;
-      if ((*iter)->getOrigin(archive) == m_Origin->getID()) {
-        std::vector<std::pair<int, std::pair<std::wstring, int>>> alternatives = (*iter)->getAlternatives();
+      if (file.getOrigin(archive) == m_Origin->getID()) {
+        FileEntry::Alternatives alternatives = file.getAlternatives();
         if (!alternatives.empty()) {
           std::wostringstream altString;
-          for (std::vector<std::pair<int, std::pair<std::wstring, int>>>::iterator altIter = alternatives.begin();
+          for (FileEntry::Alternatives::const_iterator altIter = alternatives.begin();
                altIter != alternatives.end(); ++altIter) {
             if (altIter != alternatives.begin()) {
               altString << ", ";
@@ -296,7 +295,7 @@ void ModInfoDialog::refreshLists()
           ++numNonConflicting;
         }
       } else {
-        FilesOrigin &realOrigin = m_Directory->getOriginByID((*iter)->getOrigin(archive));
+        FilesOrigin &realOrigin = m_Directory->getOriginByID(file.getOrigin(archive));
         QStringList fields(relativeName);
         fields.append(ToQString(realOrigin.getName()));
         QTreeWidgetItem *item = new QTreeWidgetItem(fields);
@@ -306,7 +305,8 @@ void ModInfoDialog::refreshLists()
         ui->overwrittenTree->addTopLevelItem(item);
         ++numOverwritten;
       }
-    }
+      return true;
+    });
   }
 
   if (m_RootPath.length() > 0) {
@@ -1192,7 +1192,9 @@ bool ModInfoDialog::unhideFile(const QString &oldName)
 void ModInfoDialog::hideConflictFile()
 {
   if (hideFile(m_ConflictsContextItem->data(0, Qt::UserRole).toString())) {
-    emit originModified(m_Origin->getID());
+    int originID = m_Origin->getID();
+    emit originModified(originID);
+    reloadOrigin(originID);
     refreshLists();
   }
 }
@@ -1201,11 +1203,22 @@ void ModInfoDialog::hideConflictFile()
 void ModInfoDialog::unhideConflictFile()
 {
   if (unhideFile(m_ConflictsContextItem->data(0, Qt::UserRole).toString())) {
-    emit originModified(m_Origin->getID());
+    int originID = m_Origin->getID();
+    emit originModified(originID);
+    reloadOrigin(originID);
     refreshLists();
   }
 }
 
+
+void ModInfoDialog::reloadOrigin(int originID)
+{
+  // the origin was changed in a copy of the structure, the one the dialog was opened with is
+  // released once the copy is published
+  m_Directory = m_OrganizerCore->directoryStructure();
+  m_Origin = &m_Directory->getOriginByID(originID);
+}
+
 int ModInfoDialog::getBinaryExecuteInfo(const QFileInfo &targetInfo, QFileInfo &binaryInfo, QString &arguments)
 {
 	QString extension = targetInfo.suffix();
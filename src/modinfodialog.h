@@ -148,6 +148,7 @@ private:
   bool allowNavigateFromINI();
   bool hideFile(const QString &oldName);
   bool unhideFile(const QString &oldName);
+  void reloadOrigin(int originID);
   void addCheckedCategories(QTreeWidgetItem *tree);
   void refreshPrimaryCategoriesBox();
 
@@ -3,8 +3,8 @@
 #include "categories.h"
 #include "iplugingame.h"
 #include "messagedialog.h"
+#include "modmetastore.h"
 #include "report.h"
-#include "scriptextender.h"
 
 #include <QApplication>
 #include <QDirIterator>
@@ -16,6 +16,16 @@ using namespace MOBase;
 using namespace MOShared;
 
 namespace {
+  // keys are stored in lower case, like QSettings on windows the lookups have to ignore the case
+  QVariantMap allValues(const QSettings &settings)
+  {
+    QVariantMap result;
+    for (const QString &key : settings.allKeys()) {
+      result[key.toLower()] = settings.value(key);
+    }
+    return result;
+  }
+
   //Arguably this should be a class static or we should be using FileString rather
   //than QString for the names. Or both.
   static bool ByName(const ModInfo::Ptr &LHS, const ModInfo::Ptr &RHS)
@@ -33,6 +43,8 @@ ModInfoRegular::ModInfoRegular(PluginContainer *pluginContainer, QString gameNam
   , m_MetaInfoChanged(false)
   , m_EndorsedState(ENDORSED_UNKNOWN)
   , m_NexusBridge(pluginContainer)
+  , m_CachedContents(0)
+  , m_ArchivesTime(0)
 {
   testValid();
   m_CreationTime = QFileInfo(path.absolutePath()).created();
@@ -70,19 +82,26 @@ bool ModInfoRegular::isEmpty() const
 
 void ModInfoRegular::readMeta()
 {
-  QSettings metaFile(m_Path + "/meta.ini", QSettings::IniFormat);
+  // meta.ini is only parsed if the store doesn't have its current contents
+  QVariantMap metaFile;
+  if (!ModMetaStore::instance().read(m_Path, metaFile)) {
+    QSettings metaSettings(m_Path + "/meta.ini", QSettings::IniFormat);
+    metaFile = allValues(metaSettings);
+    ModMetaStore::instance().update(m_Path, metaFile);
+  }
+
   m_Notes            = metaFile.value("notes", "").toString();
-  QString tempGameName = metaFile.value("gameName", m_GameName).toString();
+  QString tempGameName = metaFile.value("gamename", m_GameName).toString();
   if (tempGameName != "") m_GameName = tempGameName;
   m_NexusID          = metaFile.value("modid", -1).toInt();
   m_Version.parse(metaFile.value("version", "").toString());
-  m_NewestVersion    = metaFile.value("newestVersion", "").toString();
-  m_IgnoredVersion   = metaFile.value("ignoredVersion", "").toString();
-  m_InstallationFile = metaFile.value("installationFile", "").toString();
-  m_NexusDescription = metaFile.value("nexusDescription", "").toString();
+  m_NewestVersion    = metaFile.value("newestversion", "").toString();
+  m_IgnoredVersion   = metaFile.value("ignoredversion", "").toString();
+  m_InstallationFile = metaFile.value("installationfile", "").toString();
+  m_NexusDescription = metaFile.value("nexusdescription", "").toString();
   m_Repository = metaFile.value("repository", "Nexus").toString();
   m_URL = metaFile.value("url", "").toString();
-  m_LastNexusQuery = QDateTime::fromString(metaFile.value("lastNexusQuery", "").toString(), Qt::ISODate);
+  m_LastNexusQuery = QDateTime::fromString(metaFile.value("lastnexusquery", "").toString(), Qt::ISODate);
   if (metaFile.contains("endorsed")) {
     if (metaFile.value("endorsed").canConvert<int>()) {
       switch (metaFile.value("endorsed").toInt()) {
@@ -114,12 +133,12 @@ void ModInfoRegular::readMeta()
     }
   }
 
-  int numFiles = metaFile.beginReadArray("installedFiles");
-  for (int i = 0; i < numFiles; ++i) {
-    metaFile.setArrayIndex(i);
-    m_InstalledFileIDs.insert(std::make_pair(metaFile.value("modid").toInt(), metaFile.value("fileid").toInt()));
+  // same keys QSettings::beginReadArray uses, the array indices in the keys start at 1
+  int numFiles = metaFile.value("installedfiles/size", 0).toInt();
+  for (int i = 1; i <= numFiles; ++i) {
+    QString prefix = QString("installedfiles/%1/").arg(i);
+    m_InstalledFileIDs.insert(std::make_pair(metaFile.value(prefix + "modid").toInt(), metaFile.value(prefix + "fileid").toInt()));
   }
-  metaFile.endArray();
 
   m_MetaInfoChanged = false;
 }
@@ -161,6 +180,7 @@ void ModInfoRegular::saveMeta()
 
       if (metaFile.status() == QSettings::NoError) {
         m_MetaInfoChanged = false;
+        ModMetaStore::instance().update(absolutePath(), allValues(metaFile));
       } else {
         reportError(tr("failed to write %1/meta.ini: error %2").arg(absolutePath()).arg(metaFile.status()));
       }
@@ -293,9 +313,10 @@ bool ModInfoRegular::setName(const QString &name)
     }
   }
 
-  std::map<QString, unsigned int>::iterator nameIter = s_ModsByName.find(m_Name);
+  QWriteLocker locker(&s_Lock);
+  auto nameIter = s_ModsByName.find(m_Name);
   if (nameIter != s_ModsByName.end()) {
-    unsigned int index = nameIter->second;
+    unsigned int index = *nameIter;
     s_ModsByName.erase(nameIter);
 
     m_Name = name;
@@ -433,46 +454,27 @@ std::vector<ModInfo::EFlag> ModInfoRegular::getFlags() const
 
 std::vector<ModInfo::EContent> ModInfoRegular::getContents() const
 {
-  QTime now = QTime::currentTime();
-  if (m_LastContentCheck.isNull() || (m_LastContentCheck.secsTo(now) > 60)) {
-    m_CachedContent.clear();
-    QDir dir(absolutePath());
-    if (dir.entryList(QStringList() << "*.esp" << "*.esm" << "*.esl").size() > 0) {
-      m_CachedContent.push_back(CONTENT_PLUGIN);
-    }
-    if (dir.entryList(QStringList() << "*.bsa" << "*.ba2").size() > 0) {
-      m_CachedContent.push_back(CONTENT_BSA);
-    }
-
-    ScriptExtender *extender = qApp->property("managed_game")
-                                   .value<IPluginGame *>()
-                                   ->feature<ScriptExtender>();
+  return contentsFromMask(getContentsMask());
+}
 
-    if (extender != nullptr) {
-      QString sePluginPath = extender->PluginPath();
-      if (dir.exists(sePluginPath))
-        m_CachedContent.push_back(CONTENT_SKSE);
+unsigned int ModInfoRegular::getContentsMask() const
+{
+  unsigned int contents;
+  if (!contentsFromStructure(contents)) {
+    // the mod isn't part of the directory structure (i.e. it's inactive), look at the disk
+    QTime now = QTime::currentTime();
+    if (m_LastContentCheck.isNull() || (m_LastContentCheck.secsTo(now) > 60)) {
+      QDir dir(absolutePath());
+      QString sePluginPath = scriptExtenderPluginPath();
+      m_CachedContents = classifyContents(dir.entryList(QDir::Files),
+                                          dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot),
+                                          !sePluginPath.isEmpty() && dir.exists(sePluginPath));
+      m_LastContentCheck = now;
     }
-    if (dir.exists("textures"))
-      m_CachedContent.push_back(CONTENT_TEXTURE);
-    if (dir.exists("meshes"))
-      m_CachedContent.push_back(CONTENT_MESH);
-    if (dir.exists("interface") || dir.exists("menus"))
-      m_CachedContent.push_back(CONTENT_INTERFACE);
-    if (dir.exists("music") || dir.exists("sound"))
-      m_CachedContent.push_back(CONTENT_SOUND);
-    if (dir.exists("scripts"))
-      m_CachedContent.push_back(CONTENT_SCRIPT);
-    if (dir.exists("SkyProc Patchers"))
-      m_CachedContent.push_back(CONTENT_SKYPROC);
-    if (dir.exists("MCM"))
-      m_CachedContent.push_back(CONTENT_MCM);
-
-    m_LastContentCheck = QTime::currentTime();
+    contents = m_CachedContents;
   }
 
-  return m_CachedContent;
-
+  return contents;
 }
 
 
@@ -551,16 +553,53 @@ QString ModInfoRegular::getURL() const
 
 
 
+static void sortArchives(QStringList &archives)
+{
+  // the list is taken either from the disk or from a scan, both have to produce the same order
+  std::sort(archives.begin(), archives.end(), [](const QString &lhs, const QString &rhs) {
+    return lhs.compare(rhs, Qt::CaseInsensitive) < 0;
+  });
+}
+
 QStringList ModInfoRegular::archives() const
 {
+  QString path = this->absolutePath();
+  // adding, removing or renaming an archive changes the modification time of the directory,
+  // which is a lot cheaper to query than the listing
+  QFileInfo dirInfo(path);
+  qint64 lastModified = dirInfo.exists() ? dirInfo.lastModified().toMSecsSinceEpoch() : -1;
+  {
+    QMutexLocker locker(&m_ArchivesMutex);
+    if ((lastModified != -1) && (lastModified == m_ArchivesTime) && (path == m_ArchivesPath)) {
+      return m_Archives;
+    }
+  }
+
   QStringList result;
-  QDir dir(this->absolutePath());
-  for (const QString &archive : dir.entryList(QStringList({ "*.bsa", "*.ba2" }))) {
-    result.append(this->absolutePath() + "/" + archive);
+  QDir dir(path);
+  for (const QString &archive : dir.entryList(QStringList({ "*.bsa", "*.ba2" }), QDir::Files)) {
+    result.append(path + "/" + archive);
   }
+  sortArchives(result);
+
+  QMutexLocker locker(&m_ArchivesMutex);
+  m_ArchivesPath = path;
+  m_ArchivesTime = lastModified;
+  m_Archives = result;
   return result;
 }
 
+void ModInfoRegular::recordArchives(const QString &modPath, const QStringList &archives, qint64 lastModified)
+{
+  QStringList sorted = archives;
+  sortArchives(sorted);
+
+  QMutexLocker locker(&m_ArchivesMutex);
+  m_ArchivesPath = modPath;
+  m_ArchivesTime = lastModified;
+  m_Archives = sorted;
+}
+
 void ModInfoRegular::addInstalledFile(int modId, int fileId)
 {
   m_InstalledFileIDs.insert(std::make_pair(modId, fileId));
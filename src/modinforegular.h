@@ -244,6 +244,8 @@ public:
 
   virtual std::vector<EContent> getContents() const;
 
+  virtual unsigned int getContentsMask() const;
+
   /**
    * @return an indicator if and how this mod should be highlighted by the UI
    */
@@ -291,6 +293,8 @@ public:
 
   virtual QStringList archives() const;
 
+  virtual void recordArchives(const QString &modPath, const QStringList &archives, qint64 lastModified);
+
   virtual void addInstalledFile(int modId, int fileId);
 
   /**
@@ -349,9 +353,16 @@ private:
 
   NexusBridge m_NexusBridge;
 
-  mutable std::vector<ModInfo::EContent> m_CachedContent;
+  // contents of the mod while it isn't part of the directory structure
+  mutable unsigned int m_CachedContents;
   mutable QTime m_LastContentCheck;
 
+  // archives of the mod directory, valid while the directory has the recorded modification time
+  mutable QMutex m_ArchivesMutex;
+  mutable QString m_ArchivesPath;
+  mutable qint64 m_ArchivesTime;
+  mutable QStringList m_Archives;
+
 };
 
 
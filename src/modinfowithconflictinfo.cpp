@@ -7,11 +7,15 @@ using namespace MOBase;
 using namespace MOShared;
 
 ModInfoWithConflictInfo::ModInfoWithConflictInfo(PluginContainer *pluginContainer, DirectoryEntry **directoryStructure)
-  : ModInfo(pluginContainer), m_DirectoryStructure(directoryStructure) {}
+  : ModInfo(pluginContainer), m_DirectoryStructure(directoryStructure)
+  , m_CurrentConflictState(CONFLICT_NONE), m_ArchiveConflictState(CONFLICT_NONE)
+  , m_Redundant(false), m_ConflictGeneration(0ULL)
+  , m_StructureContentsChecked(false), m_StructureContentsKnown(false), m_StructureContents(0) {}
 
 void ModInfoWithConflictInfo::clearCaches()
 {
-  m_LastConflictCheck = QTime();
+  m_ConflictGeneration = 0ULL;
+  m_StructureContentsChecked = false;
 }
 
 std::vector<ModInfo::EFlag> ModInfoWithConflictInfo::getFlags() const
@@ -50,134 +54,93 @@ std::vector<ModInfo::EFlag> ModInfoWithConflictInfo::getFlags() const
 
 void ModInfoWithConflictInfo::doConflictCheck() const
 {
+  const ConflictGraph &graph = (*m_DirectoryStructure)->getFileRegister()->conflictGraph();
+  if (graph.generation() == m_ConflictGeneration) {
+    return;
+  }
+  m_ConflictGeneration = graph.generation();
+
   m_OverwriteList.clear();
   m_OverwrittenList.clear();
   m_ArchiveOverwriteList.clear();
   m_ArchiveOverwrittenList.clear();
 
-  bool providesAnything = false;
-
-  int dataID = 0;
-  if ((*m_DirectoryStructure)->originExists(L"data")) {
-    dataID = (*m_DirectoryStructure)->getOriginByName(L"data").getID();
-  }
+  m_CurrentConflictState = CONFLICT_NONE;
+  m_ArchiveConflictState = CONFLICT_NONE;
+  m_Redundant = false;
 
   std::wstring name = ToWString(this->name());
+  if (!(*m_DirectoryStructure)->originExists(name)) {
+    return;
+  }
 
-  m_CurrentConflictState = CONFLICT_NONE;
-  m_ArchiveConflictState = CONFLICT_NONE;
+  const ConflictGraph::Node *node = graph.node((*m_DirectoryStructure)->getOriginByName(name).getID());
+  if (node == nullptr) {
+    // the origin provides no files
+    m_Redundant = true;
+    return;
+  }
 
-  if ((*m_DirectoryStructure)->originExists(name)) {
-    FilesOrigin &origin = (*m_DirectoryStructure)->getOriginByName(name);
-    std::vector<FileEntry::Ptr> files = origin.getFiles();
-    // for all files in this origin
-    for (FileEntry::Ptr file : files) {
-      const std::vector<std::pair<int, std::pair<std::wstring, int>>> &alternatives = file->getAlternatives();
-      if ((alternatives.size() == 0) || (alternatives.begin()->first == dataID)) {
-        // no alternatives -> no conflict
-        providesAnything = true;
-      } else {
-        if (file->getOrigin() != origin.getID()) {
-          FilesOrigin &altOrigin = (*m_DirectoryStructure)->getOriginByID(file->getOrigin());
-          unsigned int altIndex = ModInfo::getIndex(ToQString(altOrigin.getName()));
-          if (file->getArchive().first.size() == 0)
-              m_OverwrittenList.insert(altIndex);
-          else
-              m_ArchiveOverwriteList.insert(altIndex);
-        } else {
-          providesAnything = true;
-        }
-
-        // for all non-providing alternative origins
-        bool found = file->getOrigin() == origin.getID();
-        std::pair<std::wstring, int> archiveData;
-        if (found)
-            archiveData = file->getArchive();
-        for (auto altInfo : alternatives) {
-          if ((altInfo.first != dataID) && (altInfo.first != origin.getID())) {
-            FilesOrigin &altOrigin = (*m_DirectoryStructure)->getOriginByID(altInfo.first);
-            unsigned int altIndex = ModInfo::getIndex(ToQString(altOrigin.getName()));
-            if (!found) {
-                if (altInfo.second.first.size() == 0)
-                    m_OverwrittenList.insert(altIndex);
-                else
-                    m_ArchiveOverwrittenList.insert(altIndex);
-            } else {
-                if (archiveData.first.size() == 0)
-                    m_OverwriteList.insert(altIndex);
-                else
-                    m_ArchiveOverwrittenList.insert(altIndex);
-            }
-            /*if (origin.getPriority() > altOrigin.getPriority()) {
-              m_OverwriteList.insert(altIndex);
-            } else {
-              m_OverwrittenList.insert(altIndex);
-            }*/
-          } else {
-            found = true;
-            archiveData = altInfo.second;
-          }
-        }
-      }
-    }
-    m_LastConflictCheck = QTime::currentTime();
-
-    if (files.size() != 0) {
-      if (!providesAnything)
-        m_CurrentConflictState = CONFLICT_REDUNDANT;
-      else if (!m_OverwriteList.empty() && !m_OverwrittenList.empty())
-        m_CurrentConflictState = CONFLICT_MIXED;
-      else if (!m_OverwriteList.empty())
-        m_CurrentConflictState = CONFLICT_OVERWRITE;
-      else if (!m_OverwrittenList.empty())
-        m_CurrentConflictState = CONFLICT_OVERWRITTEN;
-    }
-
-    if (!m_ArchiveOverwriteList.empty() && !m_ArchiveOverwrittenList.empty())
-        m_ArchiveConflictState = CONFLICT_MIXED;
-    else if (!m_ArchiveOverwriteList.empty())
-        m_ArchiveConflictState = CONFLICT_OVERWRITE;
-    else if (!m_ArchiveOverwrittenList.empty())
-        m_ArchiveConflictState = CONFLICT_OVERWRITTEN;
+  m_Redundant = node->numPrimary == 0;
+
+  for (const ConflictGraph::Edge &edge : node->edges) {
+    FilesOrigin &altOrigin = (*m_DirectoryStructure)->getOriginByID(edge.origin);
+    unsigned int altIndex = ModInfo::getIndex(altOrigin);
+    if (edge.counts.overwrite != 0)
+      m_OverwriteList.insert(altIndex);
+    if (edge.counts.overwritten != 0)
+      m_OverwrittenList.insert(altIndex);
+    if (edge.counts.archiveOverwrite != 0)
+      m_ArchiveOverwriteList.insert(altIndex);
+    if (edge.counts.archiveOverwritten != 0)
+      m_ArchiveOverwrittenList.insert(altIndex);
   }
+
+  if (node->numProvided == 0)
+    m_CurrentConflictState = CONFLICT_REDUNDANT;
+  else if ((node->numOverwrite != 0) && (node->numOverwritten != 0))
+    m_CurrentConflictState = CONFLICT_MIXED;
+  else if (node->numOverwrite != 0)
+    m_CurrentConflictState = CONFLICT_OVERWRITE;
+  else if (node->numOverwritten != 0)
+    m_CurrentConflictState = CONFLICT_OVERWRITTEN;
+
+  if ((node->numArchiveOverwrite != 0) && (node->numArchiveOverwritten != 0))
+    m_ArchiveConflictState = CONFLICT_MIXED;
+  else if (node->numArchiveOverwrite != 0)
+    m_ArchiveConflictState = CONFLICT_OVERWRITE;
+  else if (node->numArchiveOverwritten != 0)
+    m_ArchiveConflictState = CONFLICT_OVERWRITTEN;
 }
 
 ModInfoWithConflictInfo::EConflictType ModInfoWithConflictInfo::isConflicted() const
 {
-  // this is costy so cache the result
-  QTime now = QTime::currentTime();
-  if (m_LastConflictCheck.isNull() || (m_LastConflictCheck.secsTo(now) > 10)) {
-    doConflictCheck();
-  }
-
+  doConflictCheck();
   return m_CurrentConflictState;
 }
 
 ModInfoWithConflictInfo::EConflictType ModInfoWithConflictInfo::isArchiveConflicted() const
 {
-    QTime now = QTime::currentTime();
-    if (m_LastConflictCheck.isNull() || (m_LastConflictCheck.secsTo(now) > 10)) {
-        doConflictCheck();
-    }
+  doConflictCheck();
+  return m_ArchiveConflictState;
+}
+
 
-    return m_ArchiveConflictState;
+bool ModInfoWithConflictInfo::contentsFromStructure(unsigned int &contents) const
+{
+  if (!m_StructureContentsChecked) {
+    std::wstring name = ToWString(this->name());
+    m_StructureContentsKnown = (*m_DirectoryStructure)->originExists(name)
+        && (*m_DirectoryStructure)->getOriginByName(name).getContents(m_StructureContents);
+    m_StructureContentsChecked = true;
+  }
+  contents = m_StructureContents;
+  return m_StructureContentsKnown;
 }
 
 
 bool ModInfoWithConflictInfo::isRedundant() const
 {
-  std::wstring name = ToWString(this->name());
-  if ((*m_DirectoryStructure)->originExists(name)) {
-    FilesOrigin &origin = (*m_DirectoryStructure)->getOriginByName(name);
-    std::vector<FileEntry::Ptr> files = origin.getFiles();
-    bool ignore = false;
-    for (auto iter = files.begin(); iter != files.end(); ++iter) {
-      if ((*iter)->getOrigin(ignore) == origin.getID()) {
-        return false;
-      }
-    }
-    return true;
-  } else {
-    return false;
-  }
+  doConflictCheck();
+  return m_Redundant;
 }
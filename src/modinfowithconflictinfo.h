@@ -3,8 +3,6 @@
 
 #include "modinfo.h"
 
-#include <QTime>
-
 class ModInfoWithConflictInfo : public ModInfo
 {
 
@@ -19,16 +17,30 @@ public:
    */
   virtual void clearCaches();
 
-  virtual std::set<unsigned int> getModOverwrite() { return m_OverwriteList; }
+  virtual std::set<unsigned int> getModOverwrite() { doConflictCheck(); return m_OverwriteList; }
 
-  virtual std::set<unsigned int> getModOverwritten() { return m_OverwrittenList; }
+  virtual std::set<unsigned int> getModOverwritten() { doConflictCheck(); return m_OverwrittenList; }
 
-  virtual std::set<unsigned int> getModArchiveOverwrite() { return m_ArchiveOverwriteList; }
+  virtual std::set<unsigned int> getModArchiveOverwrite() { doConflictCheck(); return m_ArchiveOverwriteList; }
 
-  virtual std::set<unsigned int> getModArchiveOverwritten() { return m_ArchiveOverwrittenList; }
+  virtual std::set<unsigned int> getModArchiveOverwritten() { doConflictCheck(); return m_ArchiveOverwrittenList; }
 
+  /**
+   * @brief update the conflict state from the conflict graph of the directory structure if the
+   *        graph was rebuilt since the last check
+   */
   virtual void doConflictCheck() const;
 
+protected:
+
+  /**
+   * @brief retrieve the contents recorded for this mod when the directory structure was built.
+   *        The origin is only looked up once until the caches are cleared
+   * @param contents receives the bitmask produced by ModInfo::classifyContents
+   * @return false if the mod isn't part of the structure or its contents weren't recorded
+   */
+  bool contentsFromStructure(unsigned int &contents) const;
+
 private:
 
   enum EConflictType {
@@ -62,7 +74,14 @@ private:
 
   mutable EConflictType m_CurrentConflictState;
   mutable EConflictType m_ArchiveConflictState;
-  mutable QTime m_LastConflictCheck;
+  mutable bool m_Redundant;
+  // generation of the conflict graph the state was taken from
+  mutable unsigned long long m_ConflictGeneration;
+
+  // contents taken from the origin of this mod, cleared along with the conflict state
+  mutable bool m_StructureContentsChecked;
+  mutable bool m_StructureContentsKnown;
+  mutable unsigned int m_StructureContents;
 
   mutable std::set<unsigned int> m_OverwriteList;   // indices of mods overritten by this mod
   mutable std::set<unsigned int> m_OverwrittenList; // indices of mods overwriting this mod
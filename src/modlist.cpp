@@ -740,18 +740,12 @@ void ModList::highlightMods(const QItemSelection &selected, const MOShared::Dire
     if (fileEntry.get() != nullptr) {
       QString fileName;
       bool archive = false;
-      std::vector<std::pair<int, std::pair<std::wstring, int>>> origins;
-      {
-        std::vector<std::pair<int, std::pair<std::wstring, int>>> alternatives = fileEntry->getAlternatives();
-        origins.insert(origins.end(), std::pair<int, std::pair<std::wstring, int>>(fileEntry->getOrigin(archive), fileEntry->getArchive()));
-      }
-      for (auto originInfo : origins) {
-        MOShared::FilesOrigin &origin = directoryEntry.getOriginByID(originInfo.first);
-        for (unsigned int i = 0; i < ModInfo::getNumMods(); ++i) {
-          if (ModInfo::getByIndex(i)->internalName() == QString::fromStdWString(origin.getName())) {
-            ModInfo::getByIndex(i)->setPluginSelected(true);
-            break;
-          }
+      // only the origin that actually provides the file is highlighted
+      MOShared::FilesOrigin &origin = directoryEntry.getOriginByID(fileEntry->getOrigin(archive));
+      for (unsigned int i = 0; i < ModInfo::getNumMods(); ++i) {
+        if (ModInfo::getByIndex(i)->internalName() == QString::fromStdWString(origin.getName())) {
+          ModInfo::getByIndex(i)->setPluginSelected(true);
+          break;
         }
       }
     }
@@ -877,9 +871,7 @@ bool ModList::dropURLs(const QMimeData *mimeData, int row, const QModelIndex &pa
   QDir modDirectory(modInfo->absolutePath());
   QDir gameDirectory(Settings::instance().getOverwriteDirectory());
 
-  unsigned int overwriteIndex = ModInfo::findMod([] (ModInfo::Ptr mod) -> bool {
-    std::vector<ModInfo::EFlag> flags = mod->getFlags();
-    return std::find(flags.begin(), flags.end(), ModInfo::FLAG_OVERWRITE) != flags.end(); });
+  unsigned int overwriteIndex = ModInfo::getOverwriteIndex();
 
   QString overwriteName = ModInfo::getByIndex(overwriteIndex)->name();
 
@@ -0,0 +1,369 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modmetastore.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <cstring>
+
+
+static const char STORE_MAGIC[8] = { 'M', 'O', 'M', 'E', 'T', 'A', 'D', 'B' };
+// increase whenever the layout or the meaning of the data changes
+static const quint32 STORE_VERSION = 2;
+
+// the file is compacted when it holds more outdated records than this on top of the current ones
+static const int MAX_OUTDATED_RECORDS = 256;
+
+
+static quint64 checksum(const uchar *data, size_t size, quint64 hash = 14695981039346656037ULL)
+{
+  // FNV-1a, only meant to detect records that weren't written completely
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+static size_t padded(size_t size)
+{
+  // records start at 8 byte boundaries
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+
+ModMetaStore &ModMetaStore::instance()
+{
+  // never destroyed, mods save their meta data when they are destroyed during shutdown
+  static ModMetaStore *s_Instance = new ModMetaStore;
+  return *s_Instance;
+}
+
+ModMetaStore::ModMetaStore()
+  : m_Data(nullptr)
+  , m_MappedSize(0)
+  , m_NumRecords(0)
+{
+}
+
+QString ModMetaStore::key(const QString &modPath)
+{
+  return QDir::fromNativeSeparators(modPath).toCaseFolded();
+}
+
+void ModMetaStore::metaFileState(const QString &modPath, qint64 &time, qint64 &size)
+{
+  QFileInfo metaFile(modPath + "/meta.ini");
+  if (metaFile.exists()) {
+    time = metaFile.lastModified().toMSecsSinceEpoch();
+    size = metaFile.size();
+  } else {
+    time = 0;
+    size = -1;
+  }
+}
+
+void ModMetaStore::open(const QString &fileName)
+{
+  QMutexLocker locker(&m_Mutex);
+  if (m_File.isOpen() && (m_FileName == fileName)) {
+    return;
+  }
+
+  unmap();
+  m_File.close();
+  m_Added.clear();
+
+  m_FileName = fileName;
+  m_File.setFileName(fileName);
+  if (!m_File.open(QIODevice::ReadWrite)) {
+    qWarning("failed to open mod meta data store %s: %s",
+             qPrintable(fileName), qPrintable(m_File.errorString()));
+    return;
+  }
+
+  if (!map()) {
+    // missing, outdated or damaged beyond repair, start over
+    unmap();
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header.version = STORE_VERSION;
+    if (!m_File.resize(0)
+        || (m_File.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+        || !m_File.flush()
+        || !map()) {
+      qWarning("failed to create mod meta data store %s: %s",
+               qPrintable(fileName), qPrintable(m_File.errorString()));
+      unmap();
+      m_File.close();
+      return;
+    }
+  }
+
+  qint64 validSize = scan();
+  if (validSize < m_MappedSize) {
+    // the last update didn't complete, later records are appended after the intact ones
+    qWarning("mod meta data store %s is damaged, dropping %lld bytes",
+             qPrintable(fileName), m_MappedSize - validSize);
+    unmap();
+    m_File.resize(validSize);
+    map();
+    scan();
+  }
+
+  if (m_NumRecords > m_Index.size() + MAX_OUTDATED_RECORDS) {
+    compact();
+  }
+}
+
+void ModMetaStore::close()
+{
+  QMutexLocker locker(&m_Mutex);
+  unmap();
+  m_File.close();
+  m_Added.clear();
+  m_FileName.clear();
+}
+
+bool ModMetaStore::map()
+{
+  m_MappedSize = m_File.size();
+  if (m_MappedSize < static_cast<qint64>(sizeof(Header))) {
+    return false;
+  }
+  m_Data = m_File.map(0, m_MappedSize);
+  if (m_Data == nullptr) {
+    return false;
+  }
+  const Header *header = reinterpret_cast<const Header*>(m_Data);
+  return (memcmp(header->magic, STORE_MAGIC, sizeof(STORE_MAGIC)) == 0)
+      && (header->version == STORE_VERSION);
+}
+
+void ModMetaStore::unmap()
+{
+  m_Index.clear();
+  m_NumRecords = 0;
+  if (m_Data != nullptr) {
+    m_File.unmap(const_cast<uchar*>(m_Data));
+    m_Data = nullptr;
+  }
+  m_MappedSize = 0;
+}
+
+qint64 ModMetaStore::scan()
+{
+  m_Index.clear();
+  m_NumRecords = 0;
+
+  qint64 offset = sizeof(Header);
+  while (offset + static_cast<qint64>(sizeof(RecordHeader)) <= m_MappedSize) {
+    RecordHeader header;
+    memcpy(&header, m_Data + offset, sizeof(RecordHeader));
+    quint64 pathSize = static_cast<quint64>(header.pathLength) * sizeof(ushort);
+    quint64 size = padded(sizeof(RecordHeader) + pathSize + header.dataLength);
+    if (static_cast<quint64>(offset) + size > static_cast<quint64>(m_MappedSize)) {
+      break;
+    }
+    const uchar *path = m_Data + offset + sizeof(RecordHeader);
+    if (checksum(path, pathSize + header.dataLength) != header.checksum) {
+      break;
+    }
+    QString modPath = QString::fromUtf16(reinterpret_cast<const ushort*>(path), header.pathLength);
+    m_Index[key(modPath)] = offset;
+    ++m_NumRecords;
+    offset += size;
+  }
+  return offset;
+}
+
+bool ModMetaStore::readRecord(qint64 offset, Record &record) const
+{
+  RecordHeader header;
+  memcpy(&header, m_Data + offset, sizeof(RecordHeader));
+  QByteArray data = QByteArray::fromRawData(
+        reinterpret_cast<const char*>(m_Data + offset + sizeof(RecordHeader) + header.pathLength * sizeof(ushort)),
+        static_cast<int>(header.dataLength));
+  QDataStream stream(data);
+  stream.setVersion(QDataStream::Qt_5_0);
+  record.metaTime = header.metaTime;
+  record.metaSize = header.metaSize;
+  record.values.clear();
+  stream >> record.values;
+  return stream.status() == QDataStream::Ok;
+}
+
+QByteArray ModMetaStore::serialize(const QString &modPath, const Record &record) const
+{
+  QByteArray data;
+  {
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << record.values;
+  }
+
+  RecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.pathLength = static_cast<quint32>(modPath.length());
+  header.dataLength = static_cast<quint32>(data.size());
+  header.metaTime = record.metaTime;
+  header.metaSize = record.metaSize;
+
+  QByteArray result;
+  result.reserve(static_cast<int>(padded(sizeof(header) + modPath.length() * sizeof(ushort) + data.size())));
+  result.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  result.append(reinterpret_cast<const char*>(modPath.utf16()), modPath.length() * static_cast<int>(sizeof(ushort)));
+  result.append(data);
+  header.checksum = checksum(reinterpret_cast<const uchar*>(result.constData()) + sizeof(header),
+                             result.size() - sizeof(header));
+  memcpy(result.data(), &header, sizeof(header));
+  result.append(QByteArray(static_cast<int>(padded(result.size()) - result.size()), '\0'));
+  return result;
+}
+
+void ModMetaStore::compact()
+{
+  // the current records are collected before the file is closed, it can't be replaced while open
+  QByteArray data;
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+  header.version = STORE_VERSION;
+  data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (qint64 offset : m_Index) {
+    RecordHeader recordHeader;
+    memcpy(&recordHeader, m_Data + offset, sizeof(RecordHeader));
+    data.append(reinterpret_cast<const char*>(m_Data + offset),
+                static_cast<int>(padded(sizeof(RecordHeader) + recordHeader.pathLength * sizeof(ushort)
+                                        + recordHeader.dataLength)));
+  }
+
+  int numOutdated = m_NumRecords - m_Index.size();
+  unmap();
+  m_File.close();
+
+  QSaveFile file(m_FileName);
+  if (!file.open(QIODevice::WriteOnly)
+      || (file.write(data) != data.size())
+      || !file.commit()) {
+    qWarning("failed to compact mod meta data store %s: %s",
+             qPrintable(m_FileName), qPrintable(file.errorString()));
+  } else {
+    qDebug("mod meta data store compacted, %d outdated records removed", numOutdated);
+  }
+
+  if (!m_File.open(QIODevice::ReadWrite) || !map()) {
+    qWarning("failed to open mod meta data store %s: %s",
+             qPrintable(m_FileName), qPrintable(m_File.errorString()));
+    unmap();
+    m_File.close();
+    return;
+  }
+  scan();
+}
+
+bool ModMetaStore::read(const QString &modPath, QVariantMap &values) const
+{
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (!m_File.isOpen()) {
+      return false;
+    }
+  }
+
+  // the disk is accessed without holding the lock, mods are read on several threads
+  qint64 time, size;
+  metaFileState(modPath, time, size);
+
+  QMutexLocker locker(&m_Mutex);
+  if (!m_File.isOpen()) {
+    return false;
+  }
+  QString modKey = key(modPath);
+  Record record;
+  auto added = m_Added.find(modKey);
+  if (added != m_Added.end()) {
+    record = *added;
+  } else {
+    auto iter = m_Index.find(modKey);
+    if ((iter == m_Index.end()) || !readRecord(*iter, record)) {
+      return false;
+    }
+  }
+  if ((record.metaTime != time) || (record.metaSize != size)) {
+    // meta.ini was changed, probably by a different tool
+    return false;
+  }
+  values = record.values;
+  return true;
+}
+
+void ModMetaStore::update(const QString &modPath, const QVariantMap &values)
+{
+  {
+    QMutexLocker locker(&m_Mutex);
+    if (!m_File.isOpen()) {
+      return;
+    }
+  }
+
+  Record record;
+  metaFileState(modPath, record.metaTime, record.metaSize);
+  record.values = values;
+
+  QMutexLocker locker(&m_Mutex);
+  if (!m_File.isOpen()) {
+    return;
+  }
+  QString modKey = key(modPath);
+  Record current;
+  auto added = m_Added.find(modKey);
+  bool exists = (added != m_Added.end());
+  if (exists) {
+    current = *added;
+  } else {
+    auto iter = m_Index.find(modKey);
+    exists = (iter != m_Index.end()) && readRecord(*iter, current);
+  }
+  if (exists && (current.metaTime == record.metaTime) && (current.metaSize == record.metaSize)
+      && (current.values == record.values)) {
+    return;
+  }
+
+  QByteArray data = serialize(modPath, record);
+  qint64 size = m_File.size();
+  if (!m_File.seek(size)
+      || (m_File.write(data) != data.size())
+      || !m_File.flush()) {
+    qWarning("failed to update mod meta data store %s: %s",
+             qPrintable(m_FileName), qPrintable(m_File.errorString()));
+    // don't leave a partial record that would hide the ones appended after it
+    m_File.resize(size);
+    return;
+  }
+  m_Added[modKey] = record;
+  ++m_NumRecords;
+}
@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MODMETASTORE_H
+#define MODMETASTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+
+
+/**
+ * @brief single file that holds the contents of the meta.ini files of all mods
+ *
+ * Reading thousands of small ini files is slow, so the values of each meta.ini are recorded in
+ * one memory mapped file. The meta.ini files remain the reference: a record is only used while
+ * the meta.ini it was taken from is unchanged (same modification time and size), otherwise the
+ * caller reads the ini file and updates the record. Changes made by other tools are picked up
+ * that way the next time the mod is read.
+ * Records are only ever appended, the file is compacted when it's opened and mostly consists
+ * of outdated records.
+ * All functions can be called from multiple threads concurrently.
+ **/
+class ModMetaStore
+{
+
+public:
+
+  static ModMetaStore &instance();
+
+  /**
+   * @brief open the store. A missing or damaged file is replaced by an empty store
+   * @param fileName path of the store
+   **/
+  void open(const QString &fileName);
+
+  /**
+   * @brief close the store. Afterwards nothing is read from or recorded in it
+   **/
+  void close();
+
+  /**
+   * @brief retrieve the meta data of a mod if meta.ini didn't change since it was recorded
+   * @param modPath absolute path of the mod directory
+   * @param values receives the values of meta.ini, as they were recorded
+   * @return true if the values are valid, false if meta.ini has to be read
+   **/
+  bool read(const QString &modPath, QVariantMap &values) const;
+
+  /**
+   * @brief record the meta data of a mod. Has to be called after meta.ini was read or written
+   * @param modPath absolute path of the mod directory
+   * @param values the values of meta.ini
+   **/
+  void update(const QString &modPath, const QVariantMap &values);
+
+private:
+
+  struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 reserved;
+  };
+
+  struct RecordHeader {
+    quint32 pathLength;   // in characters
+    quint32 dataLength;   // in bytes
+    qint64 metaTime;      // modification time of meta.ini in ms, 0 if it doesn't exist
+    qint64 metaSize;      // size of meta.ini, -1 if it doesn't exist
+    quint64 checksum;     // of the path and data
+  };
+
+  struct Record {
+    qint64 metaTime;
+    qint64 metaSize;
+    QVariantMap values;
+  };
+
+private:
+
+  ModMetaStore();
+
+  ModMetaStore(const ModMetaStore &reference);
+  ModMetaStore &operator=(const ModMetaStore &reference);
+
+  static QString key(const QString &modPath);
+  static void metaFileState(const QString &modPath, qint64 &time, qint64 &size);
+
+  bool map();
+  void unmap();
+  qint64 scan();
+  void compact();
+  bool readRecord(qint64 offset, Record &record) const;
+  QByteArray serialize(const QString &modPath, const Record &record) const;
+
+private:
+
+  mutable QMutex m_Mutex;
+  QString m_FileName;
+  QFile m_File;
+  const uchar *m_Data;
+  qint64 m_MappedSize;
+
+  int m_NumRecords;
+  // offset of the latest record of each mod in the mapped part of the file
+  QHash<QString, qint64> m_Index;
+  // records added since the file was mapped
+  QHash<QString, Record> m_Added;
+
+};
+
+#endif // MODMETASTORE_H
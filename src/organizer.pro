@@ -58,6 +58,7 @@ SOURCES += \
     downloadlistsortproxy.cpp \
     downloadlist.cpp \
     directoryrefresher.cpp \
+    directorysnapshot.cpp \
     credentialsdialog.cpp \
     categoriesdialog.cpp \
     categories.cpp \
@@ -89,6 +90,7 @@ SOURCES += \
     organizercore.cpp \
     modinfowithconflictinfo.cpp \
     modinforegular.cpp \
+    modmetastore.cpp \
     modinfobackup.cpp \
     modinfooverwrite.cpp \
     modinfoforeign.cpp
@@ -133,6 +135,7 @@ HEADERS  += \
     downloadlistsortproxy.h \
     downloadlist.h \
     directoryrefresher.h \
+    directorysnapshot.h \
     credentialsdialog.h \
     categoriesdialog.h \
     categories.h \
@@ -165,6 +168,7 @@ HEADERS  += \
     iuserinterface.h \
     modinfowithconflictinfo.h \
     modinforegular.h \
+    modmetastore.h \
     modinfobackup.h \
     modinfooverwrite.h \
     modinfoforeign.h
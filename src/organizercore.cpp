@@ -42,6 +42,8 @@
 #include <QMessageBox>
 #include <QNetworkInterface>
 #include <QProcess>
+#include <QThread>
+#include <QTime>
 #include <QTimer>
 #include <QUrl>
 #include <QWidget>
@@ -199,7 +201,7 @@ OrganizerCore::OrganizerCore(const QSettings &initSettings)
   , m_ModList(m_PluginContainer, this)
   , m_PluginList(this)
   , m_DirectoryRefresher()
-  , m_DirectoryStructure(new DirectoryEntry(L"data", nullptr, 0))
+  , m_DirectoryStructure(nullptr)
   , m_DownloadManager(NexusInterface::instance(m_PluginContainer), this)
   , m_InstallationManager()
   , m_RefresherThread()
@@ -208,6 +210,8 @@ OrganizerCore::OrganizerCore(const QSettings &initSettings)
   , m_ArchivesInit(false)
   , m_PluginListsWriter(std::bind(&OrganizerCore::savePluginList, this))
 {
+  publishStructure(new DirectoryEntry(L"data", nullptr, 0));
+
   m_DownloadManager.setOutputDirectory(m_Settings.getDownloadDirectory());
   m_DownloadManager.setPreferredServers(m_Settings.getPreferredServers());
 
@@ -270,7 +274,54 @@ OrganizerCore::~OrganizerCore()
   m_ModList.setProfile(nullptr);
   //  NexusInterface::instance()->cleanup();
 
-  delete m_DirectoryStructure;
+  std::atomic_store(&m_PublishedStructure, std::shared_ptr<DirectoryEntry>());
+  m_CurrentStructure.reset();
+  m_DirectoryStructure = nullptr;
+}
+
+std::shared_ptr<DirectoryEntry> OrganizerCore::directoryStructureSnapshot() const
+{
+  if (QThread::currentThread() == thread()) {
+    // the main thread is the one making changes, it sees them before they are published
+    return m_CurrentStructure;
+  }
+  return std::atomic_load(&m_PublishedStructure);
+}
+
+DirectoryEntry *OrganizerCore::modifiableStructure()
+{
+  if (m_CurrentStructure == std::atomic_load(&m_PublishedStructure)) {
+    // other threads may be reading the published structure. All changes until control returns to
+    // the event loop go to the same copy
+    setCurrentStructure(m_DirectoryStructure->clone());
+    QTimer::singleShot(0, this, SLOT(publishStructureChanges()));
+  }
+  return m_DirectoryStructure;
+}
+
+void OrganizerCore::setCurrentStructure(DirectoryEntry *structure)
+{
+  // the previous structure is freed in the background once no reader holds it any more
+  DirectoryRefresher *refresher = &m_DirectoryRefresher;
+  m_CurrentStructure.reset(structure, [refresher] (DirectoryEntry *discarded) {
+    refresher->discardStructure(discarded);
+  });
+  m_DirectoryStructure = structure;
+}
+
+void OrganizerCore::publishStructure(DirectoryEntry *structure)
+{
+  setCurrentStructure(structure);
+  publishStructureChanges();
+}
+
+void OrganizerCore::publishStructureChanges()
+{
+  if (m_CurrentStructure != std::atomic_load(&m_PublishedStructure)) {
+    // the graph is built on first use otherwise, which would change a structure others read
+    m_DirectoryStructure->getFileRegister()->conflictGraph();
+    std::atomic_store(&m_PublishedStructure, m_CurrentStructure);
+  }
 }
 
 QString OrganizerCore::commitSettings(const QString &iniFile)
@@ -634,8 +685,10 @@ void OrganizerCore::downloadRequested(QNetworkReply *reply, QString gameName, in
 
 void OrganizerCore::removeOrigin(const QString &name)
 {
-  FilesOrigin &origin = m_DirectoryStructure->getOriginByName(ToWString(name));
+  DirectoryEntry *structure = modifiableStructure();
+  FilesOrigin &origin = structure->getOriginByName(ToWString(name));
   origin.enable(false);
+  structure->pruneOrigin(origin.getID());
   refreshLists();
 }
 
@@ -979,11 +1032,12 @@ void OrganizerCore::installDownload(int index)
 
 QString OrganizerCore::resolvePath(const QString &fileName) const
 {
-  if (m_DirectoryStructure == nullptr) {
+  std::shared_ptr<DirectoryEntry> structure = directoryStructureSnapshot();
+  if (structure == nullptr) {
     return QString();
   }
   const FileEntry::Ptr file
-      = m_DirectoryStructure->searchFile(ToWString(fileName), nullptr);
+      = structure->searchFile(ToWString(fileName), nullptr);
   if (file.get() != nullptr) {
     return ToQString(file->getFullPath());
   } else {
@@ -994,13 +1048,12 @@ QString OrganizerCore::resolvePath(const QString &fileName) const
 QStringList OrganizerCore::listDirectories(const QString &directoryName) const
 {
   QStringList result;
-  DirectoryEntry *dir = m_DirectoryStructure->findSubDirectoryRecursive(
+  std::shared_ptr<DirectoryEntry> structure = directoryStructureSnapshot();
+  DirectoryEntry *dir = structure->findSubDirectoryRecursive(
       ToWString(directoryName));
   if (dir != nullptr) {
-    std::vector<DirectoryEntry *>::iterator current, end;
-    dir->getSubDirectories(current, end);
-    for (; current != end; ++current) {
-      result.append(ToQString((*current)->getName()));
+    for (const DirectoryEntry *current : dir->getSubDirectories()) {
+      result.append(ToQString(current->getName()));
     }
   }
   return result;
@@ -1011,15 +1064,21 @@ QStringList OrganizerCore::findFiles(
     const std::function<bool(const QString &)> &filter) const
 {
   QStringList result;
+  std::shared_ptr<DirectoryEntry> structure = directoryStructureSnapshot();
   DirectoryEntry *dir
-      = m_DirectoryStructure->findSubDirectoryRecursive(ToWString(path));
+      = structure->findSubDirectoryRecursive(ToWString(path));
   if (dir != nullptr) {
-    std::vector<FileEntry::Ptr> files = dir->getFiles();
-    foreach (FileEntry::Ptr file, files) {
-      if (filter(ToQString(file->getFullPath()))) {
-        result.append(ToQString(file->getFullPath()));
+    std::wstring fullPath;
+    dir->forEachFile([&] (const FileEntry &file) -> bool {
+      file.getFullPath(fullPath);
+      QString filePath = ToQString(fullPath);
+      if (filter(filePath)) {
+        result.append(filePath);
       }
-    }
+      return true;
+    });
+    // files are visited in no particular order
+    result.sort(Qt::CaseInsensitive);
   } else {
     qWarning("directory %s not found", qPrintable(path));
   }
@@ -1029,15 +1088,16 @@ QStringList OrganizerCore::findFiles(
 QStringList OrganizerCore::getFileOrigins(const QString &fileName) const
 {
   QStringList result;
-  const FileEntry::Ptr file = m_DirectoryStructure->searchFile(
+  std::shared_ptr<DirectoryEntry> structure = directoryStructureSnapshot();
+  const FileEntry::Ptr file = structure->searchFile(
       ToWString(QFileInfo(fileName).fileName()), nullptr);
 
   if (file.get() != nullptr) {
     result.append(ToQString(
-        m_DirectoryStructure->getOriginByID(file->getOrigin()).getName()));
+        structure->getOriginByID(file->getOrigin()).getName()));
     foreach (auto i, file->getAlternatives()) {
       result.append(
-          ToQString(m_DirectoryStructure->getOriginByID(i.first).getName()));
+          ToQString(structure->getOriginByID(i.first).getName()));
     }
   } else {
     qDebug("%s not found", qPrintable(fileName));
@@ -1051,27 +1111,31 @@ QList<MOBase::IOrganizer::FileInfo> OrganizerCore::findFileInfos(
     const
 {
   QList<IOrganizer::FileInfo> result;
+  std::shared_ptr<DirectoryEntry> structure = directoryStructureSnapshot();
   DirectoryEntry *dir
-      = m_DirectoryStructure->findSubDirectoryRecursive(ToWString(path));
+      = structure->findSubDirectoryRecursive(ToWString(path));
   if (dir != nullptr) {
-    std::vector<FileEntry::Ptr> files = dir->getFiles();
-    foreach (FileEntry::Ptr file, files) {
+    std::wstring fullPath;
+    dir->forEachFileSorted([&] (const FileEntry &entry) -> bool {
+      const FileEntry *file = &entry;
       IOrganizer::FileInfo info;
-      info.filePath    = ToQString(file->getFullPath());
+      file->getFullPath(fullPath);
+      info.filePath    = ToQString(fullPath);
       bool fromArchive = false;
       info.origins.append(ToQString(
-          m_DirectoryStructure->getOriginByID(file->getOrigin(fromArchive))
+          structure->getOriginByID(file->getOrigin(fromArchive))
               .getName()));
-      info.archive = fromArchive ? ToQString(file->getArchive().first) : "";
+      info.archive = fromArchive ? ToQString(file->getArchiveName()) : "";
       foreach (auto idx, file->getAlternatives()) {
         info.origins.append(
-            ToQString(m_DirectoryStructure->getOriginByID(idx.first).getName()));
+            ToQString(structure->getOriginByID(idx.first).getName()));
       }
 
       if (filter(info)) {
         result.append(info);
       }
-    }
+      return true;
+    });
   }
   return result;
 }
@@ -1207,9 +1271,10 @@ HANDLE OrganizerCore::spawnBinaryProcess(const QFileInfo &binary,
     }
   }
 
-  while (m_DirectoryUpdate) {
-    ::Sleep(100);
-    QCoreApplication::processEvents();
+  if (m_DirectoryUpdate) {
+    // the refresh isn't waited for, the program sees the structure and lists as they are now
+    qWarning("starting %s while the directory structure is being refreshed",
+             qPrintable(binary.fileName()));
   }
 
   // need to make sure all data is saved before we start the application
@@ -1687,11 +1752,12 @@ void OrganizerCore::updateModInDirectoryStructure(unsigned int index,
                                                   ModInfo::Ptr modInfo)
 {
   // add files of the bsa to the directory structure
+  DirectoryEntry *structure = modifiableStructure();
   m_DirectoryRefresher.addModFilesToStructure(
-      m_DirectoryStructure, modInfo->name(),
+      structure, modInfo->name(),
       m_CurrentProfile->getModPriority(index), modInfo->absolutePath(),
       modInfo->stealFiles());
-  DirectoryRefresher::cleanStructure(m_DirectoryStructure);
+  DirectoryRefresher::cleanStructure(structure);
   // need to refresh plugin list now so we can activate esps
   refreshESPList(true);
   // activate all esps of the specified mod so the bsas get activated along with
@@ -1709,9 +1775,10 @@ void OrganizerCore::updateModInDirectoryStructure(unsigned int index,
       m_CurrentProfile->getActiveMods(),
       std::set<QString>(archives.begin(), archives.end()));
 
-  // finally also add files from bsas to the directory structure
+  // finally also add files from bsas to the directory structure. The lists may have let the
+  // event loop publish the changes so far, the structure is looked up again
   m_DirectoryRefresher.addModBSAToStructure(
-      m_DirectoryStructure, modInfo->name(),
+      modifiableStructure(), modInfo->name(),
       m_CurrentProfile->getModPriority(index), modInfo->absolutePath(),
       modInfo->archives());
 }
@@ -1807,23 +1874,85 @@ void OrganizerCore::refreshDirectoryStructure()
     auto archives = enabledArchives();
     m_DirectoryRefresher.setMods(
         activeModList, std::set<QString>(archives.begin(), archives.end()));
+    m_DirectoryRefresher.setThreadCount(m_Settings.refreshThreadCount());
+    m_DirectoryRefresher.setPathIndexEnabled(m_Settings.pathIndexEnabled());
 
     QTimer::singleShot(0, &m_DirectoryRefresher, SLOT(refresh()));
   }
 }
 
+void OrganizerCore::updateModPriorities()
+{
+  std::map<int, int> priorities;
+  for (unsigned int i = 0; i < m_CurrentProfile->numMods(); ++i) {
+    ModInfo::Ptr modInfo = ModInfo::getByIndex(i);
+    // origins are named after the internal name, like the mod index is
+    std::wstring name = ToWString(modInfo->internalName());
+    if (m_DirectoryStructure->originExists(name)) {
+      // priorities in the directory structure are one higher because data is 0
+      priorities[m_DirectoryStructure->getOriginByName(name).getID()]
+          = m_CurrentProfile->getModPriority(i) + 1;
+    }
+  }
+
+  bool changed = false;
+  for (const auto &priority : priorities) {
+    changed = changed || (m_DirectoryStructure->getOriginPriority(priority.first) != priority.second);
+  }
+  if (!changed) {
+    // nothing moved, the structure doesn't have to be copied
+    return;
+  }
+
+  std::vector<int> moved = modifiableStructure()->setOriginPriorities(priorities);
+
+  // a move changes the conflicts of the moved mods and of every mod they share files with. Mods
+  // that share no files with a moved one keep their conflicts. setOriginPriorities updated the
+  // graph with the re-sorted files, reading it doesn't rebuild it
+  std::set<int> affected(moved.begin(), moved.end());
+  const ConflictGraph &graph = m_DirectoryStructure->getFileRegister()->conflictGraph();
+  for (int originID : moved) {
+    const ConflictGraph::Node *node = graph.node(originID);
+    if (node != nullptr) {
+      for (const ConflictGraph::Edge &edge : node->edges) {
+        affected.insert(edge.origin);
+      }
+    }
+  }
+
+  QStringList modNames;
+  for (int originID : affected) {
+    QString name = ToQString(m_DirectoryStructure->getOriginByID(originID).getName());
+    unsigned int index = ModInfo::getIndex(name);
+    if (index != UINT_MAX) {
+      ModInfo::getByIndex(index)->clearCaches();
+      modNames.append(name);
+    }
+  }
+  if (!modNames.isEmpty()) {
+    emit modPrioritiesChanged(modNames);
+  }
+}
+
 void OrganizerCore::directory_refreshed()
 {
   DirectoryEntry *newStructure = m_DirectoryRefresher.getDirectoryStructure();
   Q_ASSERT(newStructure != m_DirectoryStructure);
-  if (newStructure != nullptr) {
-    std::swap(m_DirectoryStructure, newStructure);
-    delete newStructure;
-  } else {
+  if ((newStructure == nullptr)
+      && !m_DirectoryRefresher.applyIncrementalUpdate(m_DirectoryStructure, newStructure)
+      && !m_DirectoryUpdate) {
     // TODO: don't know why this happens, this slot seems to get called twice
-    // with only one emit
+    // with only one emit. A refresh that is still marked as running is finished below either way
     return;
   }
+  if (newStructure != nullptr) {
+    QTime time;
+    time.start();
+    // freeing the previous structure takes long for big setups, this happens in the background
+    publishStructure(newStructure);
+    qDebug("directory structure swapped in %d ms", time.elapsed());
+    ModInfo::logLookupStatistics();
+  }
   m_DirectoryUpdate = false;
 
   for (int i = 0; i < m_ModList.rowCount(); ++i) {
@@ -1861,9 +1990,11 @@ void OrganizerCore::modStatusChanged(unsigned int index)
       updateModActiveState(index, false);
       refreshESPList(true);
       if (m_DirectoryStructure->originExists(ToWString(modInfo->name()))) {
+        DirectoryEntry *structure = modifiableStructure();
         FilesOrigin &origin
-            = m_DirectoryStructure->getOriginByName(ToWString(modInfo->name()));
+            = structure->getOriginByName(ToWString(modInfo->name()));
         origin.enable(false);
+        structure->pruneOrigin(origin.getID());
       }
       if (m_UserInterface != nullptr) {
         m_UserInterface->archivesWriter().write();
@@ -1871,17 +2002,7 @@ void OrganizerCore::modStatusChanged(unsigned int index)
     }
     modInfo->clearCaches();
 
-    for (unsigned int i = 0; i < m_CurrentProfile->numMods(); ++i) {
-      ModInfo::Ptr modInfo = ModInfo::getByIndex(i);
-      int priority = m_CurrentProfile->getModPriority(i);
-      if (m_DirectoryStructure->originExists(ToWString(modInfo->name()))) {
-        // priorities in the directory structure are one higher because data is
-        // 0
-        m_DirectoryStructure->getOriginByName(ToWString(modInfo->name()))
-            .setPriority(priority + 1);
-      }
-    }
-    m_DirectoryStructure->getFileRegister()->sortOrigins();
+    updateModPriorities();
 
     refreshLists();
   } catch (const std::exception &e) {
@@ -1951,11 +2072,7 @@ void OrganizerCore::loginFailedUpdate(const QString &message)
 
 void OrganizerCore::syncOverwrite()
 {
-  unsigned int overwriteIndex         = ModInfo::findMod([](ModInfo::Ptr mod) -> bool {
-    std::vector<ModInfo::EFlag> flags = mod->getFlags();
-    return std::find(flags.begin(), flags.end(), ModInfo::FLAG_OVERWRITE)
-           != flags.end();
-  });
+  unsigned int overwriteIndex = ModInfo::getOverwriteIndex();
 
   ModInfo::Ptr modInfo = ModInfo::getByIndex(overwriteIndex);
   SyncOverwriteDialog syncDialog(modInfo->absolutePath(), m_DirectoryStructure,
@@ -2061,7 +2178,10 @@ void OrganizerCore::savePluginList()
   m_PluginList.saveTo(m_CurrentProfile->getLockedOrderFileName(),
                       m_CurrentProfile->getDeleterFileName(),
                       m_Settings.hideUncheckedPlugins());
-  m_PluginList.saveLoadOrder(*m_DirectoryStructure);
+  if (m_GamePlugin->loadOrderMechanism() == IPluginGame::LoadOrderMechanism::FileTime) {
+    // the new file times of the plugins are recorded in the structure too
+    m_PluginList.saveLoadOrder(*modifiableStructure());
+  }
 }
 
 void OrganizerCore::prepareStart()
@@ -2079,12 +2199,7 @@ void OrganizerCore::prepareStart()
 std::vector<Mapping> OrganizerCore::fileMapping(const QString &profileName,
                                                 const QString &customOverwrite)
 {
-  // need to wait until directory structure
-  while (m_DirectoryUpdate) {
-    ::Sleep(100);
-    QCoreApplication::processEvents();
-  }
-
+  // only the mod list is mapped, this doesn't depend on the directory structure
   IPluginGame *game  = qApp->property("managed_game").value<IPluginGame *>();
   Profile profile(QDir(m_Settings.getProfileDirectory() + "/" + profileName),
                   game);
@@ -2158,11 +2273,12 @@ std::vector<Mapping> OrganizerCore::fileMapping(
 {
   std::vector<Mapping> result;
 
-  for (FileEntry::Ptr current : directoryEntry->getFiles()) {
+  directoryEntry->forEachFile([&] (const FileEntry &file) -> bool {
+    const FileEntry *current = &file;
     bool isArchive = false;
     int origin = current->getOrigin(isArchive);
     if (isArchive || (origin == 0)) {
-      continue;
+      return true;
     }
 
     QString originPath
@@ -2174,17 +2290,16 @@ std::vector<Mapping> OrganizerCore::fileMapping(
     if (source != target) {
       result.push_back({source, target, false, false});
     }
-  }
+    return true;
+  });
 
   // recurse into subdirectories
-  std::vector<DirectoryEntry *>::const_iterator current, end;
-  directoryEntry->getSubDirectories(current, end);
-  for (; current != end; ++current) {
-    int origin = (*current)->anyOrigin();
+  for (const DirectoryEntry *current : directoryEntry->getSubDirectories()) {
+    int origin = current->anyOrigin();
 
     QString originPath
         = QString::fromStdWString(base->getOriginByID(origin).getPath());
-    QString dirName = QString::fromStdWString((*current)->getName());
+    QString dirName = QString::fromStdWString(current->getName());
     QString source  = originPath + relPath + dirName;
     QString target  = dataPath + relPath + dirName;
 
@@ -2193,7 +2308,7 @@ std::vector<Mapping> OrganizerCore::fileMapping(
 
     result.push_back({source, target, true, writeDestination});
     std::vector<Mapping> subRes = fileMapping(
-        dataPath, relPath + dirName + "\\", base, *current, createDestination);
+        dataPath, relPath + dirName + "\\", base, current, createDestination);
     result.insert(result.end(), subRes.begin(), subRes.end());
   }
   return result;
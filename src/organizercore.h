@@ -47,6 +47,7 @@ class QWidget;
 #include <Windows.h> //for HANDLE, LPDWORD
 
 #include <functional>
+#include <memory>
 #include <vector>
 
 class PluginContainer;
@@ -106,6 +107,21 @@ public:
   SelfUpdater *updater() { return &m_Updater; }
   InstallationManager *installationManager();
   MOShared::DirectoryEntry *directoryStructure() { return m_DirectoryStructure; }
+
+  /**
+   * @brief the directory structure to make changes to, from the main thread only. The first
+   *        change after the structure was published copies it, the copy is published once
+   *        control returns to the event loop
+   */
+  MOShared::DirectoryEntry *modifiableStructure();
+
+  /**
+   * @brief the directory structure currently in use. Holding the pointer keeps the structure alive
+   *        if a refresh replaces it in the meantime, e.g. while a plugin call processes events.
+   *        Other threads get the published structure, which isn't changed any more. The main
+   *        thread gets the one it makes its changes to
+   */
+  std::shared_ptr<MOShared::DirectoryEntry> directoryStructureSnapshot() const;
   DirectoryRefresher *directoryRefresher() { return &m_DirectoryRefresher; }
   ExecutablesList *executablesList() { return &m_ExecutablesList; }
   void setExecutablesList(const ExecutablesList &executablesList) {
@@ -134,6 +150,12 @@ public:
   void refreshBSAList();
 
   void refreshDirectoryStructure();
+
+  /**
+   * @brief apply the mod priorities of the current profile to the directory structure
+   *        without rebuilding it
+   */
+  void updateModPriorities();
   void updateModInDirectoryStructure(unsigned int index, ModInfo::Ptr modInfo);
 
   void doAfterLogin(const std::function<void()> &function) { m_PostLoginTasks.append(function); }
@@ -246,6 +268,14 @@ signals:
    */
   void modInstalled(const QString &modName);
 
+  /**
+   * @brief emitted after mods changed their position relative to other mods in the
+   *        directory structure
+   * @param modNames names of the mods whose conflicts may have changed: the mods that moved and
+   *                 all mods that share files with them
+   */
+  void modPrioritiesChanged(const QStringList &modNames);
+
   void managedGameChanged(MOBase::IPluginGame const *gamePlugin);
 
   void close();
@@ -282,8 +312,12 @@ private:
 
   bool waitForProcessCompletion(HANDLE handle, LPDWORD exitCode, ILockedWaitingForProcess* uilock);
 
+  void setCurrentStructure(MOShared::DirectoryEntry *structure);
+  void publishStructure(MOShared::DirectoryEntry *structure);
+
 private slots:
 
+  void publishStructureChanges();
   void directory_refreshed();
   void downloadRequested(QNetworkReply *reply, QString gameName, int modID, const QString &fileName);
   void removeOrigin(const QString &name);
@@ -325,6 +359,10 @@ private:
 
   DirectoryRefresher m_DirectoryRefresher;
   MOShared::DirectoryEntry *m_DirectoryStructure;
+  // owns m_DirectoryStructure, see modifiableStructure
+  std::shared_ptr<MOShared::DirectoryEntry> m_CurrentStructure;
+  // the structure other threads read, only accessed through std::atomic_load and atomic_store
+  std::shared_ptr<MOShared::DirectoryEntry> m_PublishedStructure;
 
   DownloadManager m_DownloadManager;
   InstallationManager m_InstallationManager;
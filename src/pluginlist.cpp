@@ -123,8 +123,8 @@ void PluginList::highlightPlugins(const QItemSelection &selected, const MOShared
         for (auto plugin : plugins) {
           MOShared::FileEntry::Ptr file = directoryEntry.findFile(plugin.toStdWString());
           if (file->getOrigin() != origin.getID()) {
-            const std::vector<std::pair<int, std::pair<std::wstring, int>>> alternatives = file->getAlternatives();
-            if (std::find_if(alternatives.begin(), alternatives.end(), [&](const std::pair<int, std::pair<std::wstring, int>>& element) { return element.first == origin.getID(); }) == alternatives.end())
+            MOShared::FileEntry::Alternatives alternatives = file->getAlternatives();
+            if (std::find_if(alternatives.begin(), alternatives.end(), [&](const MOShared::FileEntry::AlternativeInfo& element) { return element.first == origin.getID(); }) == alternatives.end())
               continue;
           }
           std::map<QString, int>::iterator iter = m_ESPsByName.find(plugin.toLower());
@@ -157,11 +157,25 @@ void PluginList::refresh(const QString &profileName
 
   QStringList availablePlugins;
 
-  std::vector<FileEntry::Ptr> files = baseDirectory.getFiles();
-  for (FileEntry::Ptr current : files) {
-    if (current.get() == nullptr) {
-      continue;
+  // only plugins are of interest. They are added in the order of their names so new plugins
+  // get their initial priorities the same way every time
+  std::vector<const FileEntry*> pluginFiles;
+  baseDirectory.forEachFile([&] (const FileEntry &file) -> bool {
+    PooledString name = file.getName();
+    if (name.length() >= 3) {
+      const wchar_t *extension = name.c_str() + name.length() - 3;
+      if ((_wcsicmp(extension, L"esp") == 0) || (_wcsicmp(extension, L"esm") == 0)
+          || (_wcsicmp(extension, L"esl") == 0)) {
+        pluginFiles.push_back(&file);
+      }
     }
+    return true;
+  });
+  std::sort(pluginFiles.begin(), pluginFiles.end(), [] (const FileEntry *lhs, const FileEntry *rhs) {
+    return *lhs < *rhs;
+  });
+
+  for (const FileEntry *current : pluginFiles) {
     QString filename = ToQString(current->getName());
 
     availablePlugins.append(filename.toLower());
@@ -170,31 +184,27 @@ void PluginList::refresh(const QString &profileName
       continue;
     }
 
-    QString extension = filename.right(3).toLower();
-
-    if ((extension == "esp") || (extension == "esm") || (extension == "esl")) {
-      bool forceEnabled = Settings::instance().forceEnableCoreFiles() &&
-                            std::find(primaryPlugins.begin(), primaryPlugins.end(), filename.toLower()) != primaryPlugins.end();
+    bool forceEnabled = Settings::instance().forceEnableCoreFiles() &&
+                          std::find(primaryPlugins.begin(), primaryPlugins.end(), filename.toLower()) != primaryPlugins.end();
 
-      bool archive = false;
-      try {
-        FilesOrigin &origin = baseDirectory.getOriginByID(current->getOrigin(archive));
-
-        QString iniPath = QFileInfo(filename).baseName() + ".ini";
-        bool hasIni = baseDirectory.findFile(ToWString(iniPath)).get() != nullptr;
+    bool archive = false;
+    try {
+      FilesOrigin &origin = baseDirectory.getOriginByID(current->getOrigin(archive));
 
-        QString originName = ToQString(origin.getName());
-        unsigned int modIndex = ModInfo::getIndex(originName);
-        if (modIndex != UINT_MAX) {
-          ModInfo::Ptr modInfo = ModInfo::getByIndex(modIndex);
-          originName = modInfo->name();
-        }
+      QString iniPath = QFileInfo(filename).baseName() + ".ini";
+      bool hasIni = baseDirectory.findFile(ToWString(iniPath)).get() != nullptr;
 
-        m_ESPs.push_back(ESPInfo(filename, forceEnabled, originName, ToQString(current->getFullPath()), hasIni));
-        m_ESPs.rbegin()->m_Priority = -1;
-      } catch (const std::exception &e) {
-        reportError(tr("failed to update esp info for file %1 (source id: %2), error: %3").arg(filename).arg(current->getOrigin(archive)).arg(e.what()));
+      QString originName = ToQString(origin.getName());
+      unsigned int modIndex = ModInfo::getIndex(origin);
+      if (modIndex != UINT_MAX) {
+        ModInfo::Ptr modInfo = ModInfo::getByIndex(modIndex);
+        originName = modInfo->name();
       }
+
+      m_ESPs.push_back(ESPInfo(filename, forceEnabled, originName, ToQString(current->getFullPath()), hasIni));
+      m_ESPs.rbegin()->m_Priority = -1;
+    } catch (const std::exception &e) {
+      reportError(tr("failed to update esp info for file %1 (source id: %2), error: %3").arg(filename).arg(current->getOrigin(archive)).arg(e.what()));
     }
   }
 
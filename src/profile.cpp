@@ -482,9 +482,7 @@ std::vector<std::tuple<QString, QString, int> > Profile::getActiveMods()
     }
   }
 
-  unsigned int overwriteIndex = ModInfo::findMod([](ModInfo::Ptr mod) -> bool {
-    std::vector<ModInfo::EFlag> flags = mod->getFlags();
-    return std::find(flags.begin(), flags.end(), ModInfo::FLAG_OVERWRITE) != flags.end(); });
+  unsigned int overwriteIndex = ModInfo::getOverwriteIndex();
 
   if (overwriteIndex != UINT_MAX) {
     ModInfo::Ptr overwriteInfo = ModInfo::getByIndex(overwriteIndex);
@@ -400,6 +400,21 @@ bool Settings::displayForeign() const
   return m_Settings.value("Settings/display_foreign", true).toBool();
 }
 
+int Settings::refreshThreadCount() const
+{
+  return m_Settings.value("Settings/refresh_thread_count", 0).toInt();
+}
+
+bool Settings::pathIndexEnabled() const
+{
+  return m_Settings.value("Settings/path_index", true).toBool();
+}
+
+bool Settings::modMetaStoreEnabled() const
+{
+  return m_Settings.value("Settings/mod_meta_store", false).toBool();
+}
+
 void Settings::setMotDHash(uint hash)
 {
   m_Settings.setValue("motd_hash", hash);
@@ -949,6 +964,9 @@ Settings::WorkaroundsTab::WorkaroundsTab(Settings *m_parent,
   , m_hideUncheckedBox(m_dialog.findChild<QCheckBox *>("hideUncheckedBox"))
   , m_forceEnableBox(m_dialog.findChild<QCheckBox *>("forceEnableBox"))
   , m_displayForeignBox(m_dialog.findChild<QCheckBox *>("displayForeignBox"))
+  , m_refreshThreadsEdit(m_dialog.findChild<QSpinBox *>("refreshThreadsEdit"))
+  , m_pathIndexBox(m_dialog.findChild<QCheckBox *>("pathIndexBox"))
+  , m_metaStoreBox(m_dialog.findChild<QCheckBox *>("metaStoreBox"))
 {
   m_appIDEdit->setText(m_parent->getSteamAppID());
 
@@ -982,6 +1000,9 @@ Settings::WorkaroundsTab::WorkaroundsTab(Settings *m_parent,
   m_hideUncheckedBox->setChecked(m_parent->hideUncheckedPlugins());
   m_forceEnableBox->setChecked(m_parent->forceEnableCoreFiles());
   m_displayForeignBox->setChecked(m_parent->displayForeign());
+  m_refreshThreadsEdit->setValue(m_parent->refreshThreadCount());
+  m_pathIndexBox->setChecked(m_parent->pathIndexEnabled());
+  m_metaStoreBox->setChecked(m_parent->modMetaStoreEnabled());
 
 }
 
@@ -997,4 +1018,7 @@ void Settings::WorkaroundsTab::update()
   m_Settings.setValue("Settings/hide_unchecked_plugins", m_hideUncheckedBox->isChecked());
   m_Settings.setValue("Settings/force_enable_core_files", m_forceEnableBox->isChecked());
   m_Settings.setValue("Settings/display_foreign", m_displayForeignBox->isChecked());
+  m_Settings.setValue("Settings/refresh_thread_count", m_refreshThreadsEdit->value());
+  m_Settings.setValue("Settings/path_index", m_pathIndexBox->isChecked());
+  m_Settings.setValue("Settings/mod_meta_store", m_metaStoreBox->isChecked());
 }
@@ -253,6 +253,24 @@ public:
    */
   bool displayForeign() const;
 
+  /**
+   * @return number of threads used to scan mods when refreshing the directory structure.
+   *         0 means the number is chosen automatically
+   */
+  int refreshThreadCount() const;
+
+  /**
+   * @return true if an index of all file paths in the virtual data directory should be kept so
+   *         paths can be resolved quickly, at the cost of some memory
+   */
+  bool pathIndexEnabled() const;
+
+  /**
+   * @return true if the meta data of all mods should be kept in a single file so the meta.ini
+   *         files don't have to be parsed on every refresh
+   */
+  bool modMetaStoreEnabled() const;
+
   /**
    * @brief sets the new motd hash
    **/
@@ -478,6 +496,9 @@ private:
     QCheckBox *m_hideUncheckedBox;
     QCheckBox *m_forceEnableBox;
     QCheckBox *m_displayForeignBox;
+    QSpinBox *m_refreshThreadsEdit;
+    QCheckBox *m_pathIndexBox;
+    QCheckBox *m_metaStoreBox;
   };
 
 private slots:
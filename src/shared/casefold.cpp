@@ -0,0 +1,195 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "casefold.h"
+#include <locale>
+#include <cwchar>
+
+#if (defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)) && (WCHAR_MAX == 0xFFFF)
+#define CASEFOLD_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace MOShared {
+
+
+namespace {
+
+class FoldTable
+{
+
+public:
+
+  FoldTable()
+    : m_Locale("")
+    , m_StandardASCII(true)
+  {
+    for (unsigned int ch = 0; ch < SIZE; ++ch) {
+      m_Table[ch] = std::tolower(static_cast<wchar_t>(ch), m_Locale);
+    }
+    // the vectorized path assumes the ascii range is folded the usual way. That is true for
+    // pretty much every locale but it's cheap to verify
+    for (unsigned int ch = 0; ch < 0x80; ++ch) {
+      unsigned int expected = ((ch >= L'A') && (ch <= L'Z')) ? ch + (L'a' - L'A') : ch;
+      if (static_cast<unsigned int>(m_Table[ch]) != expected) {
+        m_StandardASCII = false;
+      }
+    }
+  }
+
+  wchar_t fold(wchar_t ch) const
+  {
+    // only reached for characters outside the BMP where wchar_t is wider than 16 bits
+    return static_cast<unsigned long>(ch) < SIZE ? m_Table[static_cast<unsigned long>(ch)]
+                                                 : std::tolower(ch, m_Locale);
+  }
+
+  bool standardASCII() const { return m_StandardASCII; }
+
+private:
+
+  static const unsigned int SIZE = 0x10000;
+
+private:
+
+  std::locale m_Locale;
+  wchar_t m_Table[SIZE];
+  bool m_StandardASCII;
+
+};
+
+
+const FoldTable &foldTable()
+{
+  static const FoldTable table;
+  return table;
+}
+
+
+#ifdef CASEFOLD_SSE2
+
+// fold 8 characters if they are all ascii. Returns false, leaving result undefined, otherwise
+inline bool foldASCII8(const wchar_t *text, __m128i &result)
+{
+  __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+  __m128i nonASCII = _mm_and_si128(chars, _mm_set1_epi16(static_cast<short>(0xFF80)));
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonASCII, _mm_setzero_si128())) != 0xFFFF) {
+    return false;
+  }
+  __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'A' - 1)),
+                                _mm_cmplt_epi16(chars, _mm_set1_epi16(L'Z' + 1)));
+  result = _mm_add_epi16(chars, _mm_and_si128(upper, _mm_set1_epi16(L'a' - L'A')));
+  return true;
+}
+
+#endif
+
+} // namespace
+
+
+wchar_t FoldCase(wchar_t ch)
+{
+  return foldTable().fold(ch);
+}
+
+
+void FoldCase(wchar_t *text, size_t length)
+{
+  const FoldTable &table = foldTable();
+  size_t i = 0;
+#ifdef CASEFOLD_SSE2
+  if (table.standardASCII()) {
+    for (; i + 8 <= length; i += 8) {
+      __m128i folded;
+      if (foldASCII8(text + i, folded)) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(text + i), folded);
+      } else {
+        for (size_t j = i; j < i + 8; ++j) {
+          text[j] = table.fold(text[j]);
+        }
+      }
+    }
+  }
+#endif
+  for (; i < length; ++i) {
+    text[i] = table.fold(text[i]);
+  }
+}
+
+
+bool FoldedEqual(const wchar_t *lhs, const wchar_t *rhs, size_t length)
+{
+  const FoldTable &table = foldTable();
+  size_t i = 0;
+#ifdef CASEFOLD_SSE2
+  if (table.standardASCII()) {
+    for (; i + 8 <= length; i += 8) {
+      __m128i lhsFolded;
+      __m128i rhsFolded;
+      if (foldASCII8(lhs + i, lhsFolded) && foldASCII8(rhs + i, rhsFolded)) {
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(lhsFolded, rhsFolded)) != 0xFFFF) {
+          return false;
+        }
+      } else {
+        for (size_t j = i; j < i + 8; ++j) {
+          if (table.fold(lhs[j]) != table.fold(rhs[j])) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+#endif
+  for (; i < length; ++i) {
+    if (table.fold(lhs[i]) != table.fold(rhs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+int FoldedCompare(const wchar_t *lhs, size_t lhsLength, const wchar_t *rhs, size_t rhsLength)
+{
+  const FoldTable &table = foldTable();
+  size_t length = lhsLength < rhsLength ? lhsLength : rhsLength;
+  for (size_t i = 0; i < length; ++i) {
+    wchar_t l = table.fold(lhs[i]);
+    wchar_t r = table.fold(rhs[i]);
+    if (l != r) {
+      return l < r ? -1 : 1;
+    }
+  }
+  return lhsLength < rhsLength ? -1 : (lhsLength > rhsLength ? 1 : 0);
+}
+
+
+unsigned long long FoldedHashAppend(unsigned long long state, const wchar_t *text, size_t length)
+{
+  const FoldTable &table = foldTable();
+  for (size_t i = 0; i < length; ++i) {
+    state ^= static_cast<unsigned long long>(table.fold(text[i]));
+    state *= 1099511628211ULL;
+  }
+  return state;
+}
+
+
+} // namespace MOShared
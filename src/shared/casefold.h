@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CASEFOLD_H
+#define CASEFOLD_H
+
+
+#include <cstddef>
+
+
+namespace MOShared {
+
+
+/**
+ * Case folding for names in the directory structure.
+ *
+ * The results are identical to std::tolower with the user's locale, which is what names have
+ * always been compared with. On first use the folding of every character is stored in a table, so
+ * folding no longer consults the locale for each character, and runs of ASCII characters are
+ * processed 8 at a time where SSE2 is available.
+ * All functions are thread-safe.
+ */
+
+/**
+ * @brief fold a single character
+ */
+wchar_t FoldCase(wchar_t ch);
+
+/**
+ * @brief fold a string in place
+ */
+void FoldCase(wchar_t *text, size_t length);
+
+/**
+ * @brief test if two strings of the same length are equal after folding, without copying them
+ */
+bool FoldedEqual(const wchar_t *lhs, const wchar_t *rhs, size_t length);
+
+/**
+ * @brief compare two strings after folding
+ * @return negative, zero or positive like wcscmp
+ */
+int FoldedCompare(const wchar_t *lhs, size_t lhsLength, const wchar_t *rhs, size_t rhsLength);
+
+/**
+ * @brief continue a FNV-1a hash with the folded characters of the text, folding and hashing in
+ *        one pass
+ */
+unsigned long long FoldedHashAppend(unsigned long long state, const wchar_t *text, size_t length);
+
+
+} // namespace MOShared
+
+#endif // CASEFOLD_H
@@ -0,0 +1,212 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "conflictgraph.h"
+#include "directoryentry.h"
+#include <algorithm>
+#include <atomic>
+
+
+namespace MOShared {
+
+
+static std::atomic<unsigned long long> s_NextGeneration(1ULL);
+
+
+static void adjust(unsigned int &value, bool add)
+{
+  if (add) {
+    ++value;
+  } else {
+    --value;
+  }
+}
+
+
+static unsigned long long pairKey(int originID, int otherID)
+{
+  return (static_cast<unsigned long long>(static_cast<unsigned int>(originID)) << 32)
+         | static_cast<unsigned int>(otherID);
+}
+
+
+ConflictGraph::ConflictGraph()
+  : m_DataID(-1)
+  , m_Generation(0ULL)
+{
+}
+
+
+void ConflictGraph::begin(int dataID)
+{
+  m_Nodes.clear();
+  m_Pending.clear();
+  m_DataID = dataID;
+  m_Generation = 0ULL;
+}
+
+
+ConflictGraph::Node &ConflictGraph::nodeFor(int originID)
+{
+  if (static_cast<size_t>(originID) >= m_Nodes.size()) {
+    m_Nodes.resize(originID + 1, Node());
+  }
+  return m_Nodes[originID];
+}
+
+
+void ConflictGraph::count(int originID, int otherID, ECategory category, bool add)
+{
+  unsigned long long key = pairKey(originID, otherID);
+  auto iter = m_Pending.find(key);
+  if (iter == m_Pending.end()) {
+    iter = m_Pending.insert(std::make_pair(key, Counts())).first;
+  }
+  Counts &counts = iter->second;
+  switch (category) {
+    case OVERWRITE:           adjust(counts.overwrite, add); break;
+    case OVERWRITTEN:         adjust(counts.overwritten, add); break;
+    case ARCHIVE_OVERWRITE:   adjust(counts.archiveOverwrite, add); break;
+    case ARCHIVE_OVERWRITTEN: adjust(counts.archiveOverwritten, add); break;
+  }
+}
+
+
+void ConflictGraph::addFile(const FileEntry &file)
+{
+  applyFile(file, true);
+}
+
+
+void ConflictGraph::removeFile(const FileEntry &file)
+{
+  applyFile(file, false);
+}
+
+
+void ConflictGraph::reopen()
+{
+  // the edges go back to the pending counts, end() rebuilds them from there. That's one step per
+  // pair of origins instead of one per file
+  for (size_t originID = 0; originID < m_Nodes.size(); ++originID) {
+    Node &node = m_Nodes[originID];
+    for (const Edge &edge : node.edges) {
+      m_Pending[pairKey(static_cast<int>(originID), edge.origin)] = edge.counts;
+    }
+    node.edges.clear();
+    node.numOverwrite = 0;
+    node.numOverwritten = 0;
+    node.numArchiveOverwrite = 0;
+    node.numArchiveOverwritten = 0;
+  }
+  m_Generation = 0ULL;
+}
+
+
+void ConflictGraph::applyFile(const FileEntry &file, bool add)
+{
+  int primary = file.getOrigin();
+  if (primary < 0) {
+    return;
+  }
+  FileEntry::Alternatives alternatives = file.getAlternatives();
+  bool conflicted = !alternatives.empty() && (alternatives.front().first != m_DataID);
+
+  // the primary origin followed by the alternatives
+  for (size_t i = 0; i <= alternatives.size(); ++i) {
+    int originID = (i == 0) ? primary : alternatives[i - 1].first;
+    Node &node = nodeFor(originID);
+    adjust(node.numFiles, add);
+    if (originID == primary) {
+      adjust(node.numPrimary, add);
+      adjust(node.numProvided, add);
+    } else if (!conflicted) {
+      adjust(node.numProvided, add);
+    }
+    if (!conflicted) {
+      continue;
+    }
+
+    if (originID != primary) {
+      count(originID, primary, file.getArchive().first == StringPool::EMPTY ? OVERWRITTEN
+                                                                           : ARCHIVE_OVERWRITE, add);
+    }
+
+    // alternatives are sorted by ascending priority. Up to the origin itself (or the data
+    // directory) they are categorized by their own archive, after that by the archive the origin
+    // provides the file from
+    bool found = originID == primary;
+    StringPool::Handle archive = found ? file.getArchive().first : StringPool::EMPTY;
+    for (const FileEntry::AlternativeInfo &altInfo : alternatives) {
+      if ((altInfo.first != m_DataID) && (altInfo.first != originID)) {
+        if (!found) {
+          count(originID, altInfo.first, altInfo.second.first == StringPool::EMPTY ? OVERWRITTEN
+                                                                                  : ARCHIVE_OVERWRITTEN, add);
+        } else {
+          count(originID, altInfo.first, archive == StringPool::EMPTY ? OVERWRITE
+                                                                      : ARCHIVE_OVERWRITTEN, add);
+        }
+      } else {
+        found = true;
+        archive = altInfo.second.first;
+      }
+    }
+  }
+}
+
+
+void ConflictGraph::end()
+{
+  for (const auto &pending : m_Pending) {
+    Edge edge;
+    edge.origin = static_cast<int>(pending.first & 0xFFFFFFFFULL);
+    edge.counts = pending.second;
+    if ((edge.counts.overwrite == 0) && (edge.counts.overwritten == 0)
+        && (edge.counts.archiveOverwrite == 0) && (edge.counts.archiveOverwritten == 0)) {
+      // the files the pair conflicted over were removed or re-sorted during an update
+      continue;
+    }
+    Node &node = m_Nodes[static_cast<size_t>(pending.first >> 32)];
+    node.edges.push_back(edge);
+    if (edge.counts.overwrite != 0) ++node.numOverwrite;
+    if (edge.counts.overwritten != 0) ++node.numOverwritten;
+    if (edge.counts.archiveOverwrite != 0) ++node.numArchiveOverwrite;
+    if (edge.counts.archiveOverwritten != 0) ++node.numArchiveOverwritten;
+  }
+  m_Pending.clear();
+
+  for (Node &node : m_Nodes) {
+    std::sort(node.edges.begin(), node.edges.end(),
+              [] (const Edge &lhs, const Edge &rhs) { return lhs.origin < rhs.origin; });
+  }
+  m_Generation = s_NextGeneration++;
+}
+
+
+const ConflictGraph::Node *ConflictGraph::node(int originID) const
+{
+  if ((originID < 0) || (static_cast<size_t>(originID) >= m_Nodes.size())
+      || (m_Nodes[originID].numFiles == 0)) {
+    return nullptr;
+  }
+  return &m_Nodes[originID];
+}
+
+
+} // namespace MOShared
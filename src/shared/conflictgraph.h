@@ -0,0 +1,151 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFLICTGRAPH_H
+#define CONFLICTGRAPH_H
+
+
+#include <vector>
+#include <unordered_map>
+
+
+namespace MOShared {
+
+
+class FileEntry;
+
+
+/**
+ * @brief which origins overwrite files of which other origins.
+ *
+ * The graph is built in a single pass over all files of a directory structure. For every pair of
+ * origins that share files it stores how many loose and archive files one overwrites or is
+ * overwritten by, so the conflict state of an origin can be read without looking at its files.
+ * Pairs without shared files aren't stored. A finished graph can be reopened to replace the
+ * contributions of some files, i.e. those whose origins were re-sorted.
+ */
+class ConflictGraph
+{
+
+public:
+
+  // number of files shared with another origin, by the way they conflict
+  struct Counts {
+    unsigned int overwrite;
+    unsigned int overwritten;
+    unsigned int archiveOverwrite;
+    unsigned int archiveOverwritten;
+  };
+
+  struct Edge {
+    int origin;
+    Counts counts;
+  };
+
+  struct Node {
+    // origins this one shares files with, sorted by id
+    std::vector<Edge> edges;
+    // number of files provided by the origin
+    unsigned int numFiles;
+    // number of files that are either not in conflict or provided by this origin
+    unsigned int numProvided;
+    // number of files for which this origin is the primary one
+    unsigned int numPrimary;
+    // number of origins with a non-zero count in the respective category
+    unsigned int numOverwrite;
+    unsigned int numOverwritten;
+    unsigned int numArchiveOverwrite;
+    unsigned int numArchiveOverwritten;
+  };
+
+public:
+
+  ConflictGraph();
+
+  /**
+   * @brief start building a new graph, discarding the current one
+   * @param dataID id of the origin of the data directory. Files aren't considered conflicted if
+   *               only the data directory provides them as well
+   */
+  void begin(int dataID);
+
+  /**
+   * @brief add the origins of a file. The origins of the file have to be sorted
+   */
+  void addFile(const FileEntry &file);
+
+  /**
+   * @brief start updating the finished graph. Files are removed with the origins they were added
+   *        with and added again, end() finishes the update
+   */
+  void reopen();
+
+  /**
+   * @brief remove the contributions of a file added earlier. The origins of the file have to be in
+   *        the order they had when it was added
+   */
+  void removeFile(const FileEntry &file);
+
+  /**
+   * @brief finish building or updating the graph after all files have been added
+   */
+  void end();
+
+  /**
+   * @return the node of an origin or nullptr if the origin provides no files
+   */
+  const Node *node(int originID) const;
+
+  /**
+   * @return identifies the build of the graph. Unique for the runtime of the application so it can
+   *         be used to tell if data derived from the graph is outdated
+   */
+  unsigned long long generation() const { return m_Generation; }
+
+private:
+
+  enum ECategory {
+    OVERWRITE,
+    OVERWRITTEN,
+    ARCHIVE_OVERWRITE,
+    ARCHIVE_OVERWRITTEN
+  };
+
+private:
+
+  Node &nodeFor(int originID);
+
+  void count(int originID, int otherID, ECategory category, bool add);
+
+  void applyFile(const FileEntry &file, bool add);
+
+private:
+
+  std::vector<Node> m_Nodes; // by origin id
+  // counts by origin pair while the graph is being built
+  std::unordered_map<unsigned long long, Counts> m_Pending;
+  int m_DataID;
+  unsigned long long m_Generation;
+
+};
+
+
+} // namespace MOShared
+
+#endif // CONFLICTGRAPH_H
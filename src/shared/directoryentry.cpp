@@ -28,9 +28,10 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #include <Windows.h>
 #include <sstream>
 #include <ctime>
+#include <cstdint>
 #include <algorithm>
 #include <map>
-#include <atomic>
+#include <unordered_map>
 
 
 namespace MOShared {
@@ -57,13 +58,30 @@ public:
     LEAK_UNTRACE;
   }
 
+  // take over the origins of reference, the copies refer to the specified register and connection
+  void assign(const OriginConnection &reference, boost::shared_ptr<FileRegister> fileRegister,
+              boost::shared_ptr<OriginConnection> originConnection)
+  {
+    m_NextID = reference.m_NextID;
+    m_Origins.clear();
+    for (const FilesOrigin &origin : reference.m_Origins) {
+      m_Origins.push_back(origin);
+      // the copy constructor leaves out the files
+      m_Origins.back().m_Files = origin.m_Files;
+      m_Origins.back().m_FileRegister = fileRegister;
+      m_Origins.back().m_OriginConnection = originConnection;
+    }
+    m_Priorities = reference.m_Priorities;
+    m_OriginsNameMap = reference.m_OriginsNameMap;
+  }
+
   FilesOrigin& createOrigin(const std::wstring &originName, const std::wstring &directory, int priority,
                             boost::shared_ptr<FileRegister> fileRegister, boost::shared_ptr<OriginConnection> originConnection) {
     int newID = createID();
-    m_Origins[newID] = FilesOrigin(newID, originName, directory, priority, fileRegister, originConnection);
+    m_Origins.push_back(FilesOrigin(newID, originName, directory, priority, fileRegister, originConnection));
+    m_Priorities.push_back(priority);
     m_OriginsNameMap[originName] = newID;
-    m_OriginsPriorityMap[priority] = newID;
-    return m_Origins[newID];
+    return m_Origins.back();
   }
 
   bool exists(const std::wstring &name) {
@@ -71,11 +89,22 @@ public:
   }
 
   FilesOrigin &getByID(Index ID) {
+    if (!isValid(ID)) {
+      // used to be a map that silently added an empty origin for unknown ids, some callers
+      // still rely on getting one
+      return m_InvalidOrigin;
+    }
     return m_Origins[ID];
   }
 
+  // priority of an origin without going through the origin itself. This is what the comparators
+  // sorting the origins of files use
+  int getPriority(Index ID) const {
+    return isValid(ID) ? m_Priorities[ID] : 0;
+  }
+
   FilesOrigin &getByName(const std::wstring &name) {
-    std::map<std::wstring, int>::iterator iter = m_OriginsNameMap.find(name);
+    auto iter = m_OriginsNameMap.find(name);
     if (iter != m_OriginsNameMap.end()) {
       return m_Origins[iter->second];
     } else {
@@ -85,13 +114,62 @@ public:
     }
   }
 
-  void changePriorityLookup(int oldPriority, int newPriority)
+  std::vector<Index> changePriorities(const std::map<Index, int> &priorities)
   {
-    auto iter = m_OriginsPriorityMap.find(oldPriority);
-    if (iter != m_OriginsPriorityMap.end()) {
-      Index idx = iter->second;
-      m_OriginsPriorityMap.erase(iter);
-      m_OriginsPriorityMap[newPriority] = idx;
+    // enabled origins in their current order along with their new position. Negative priorities
+    // sort last, same as in FileEntry::originLess
+    typedef std::pair<int, Index> Key;
+    auto key = [] (int priority, Index id) { return Key(priority < 0 ? INT_MAX : priority, id); };
+    std::vector<std::pair<Key, Key>> order;
+    for (const FilesOrigin &origin : m_Origins) {
+      if (!origin.isDisabled()) {
+        auto newPriority = priorities.find(origin.getID());
+        order.push_back(std::make_pair(key(origin.getPriority(), origin.getID()),
+                                       key(newPriority != priorities.end() ? newPriority->second
+                                                                           : origin.getPriority(), origin.getID())));
+      }
+    }
+    std::sort(order.begin(), order.end());
+
+    // the longest subsequence that keeps its order relative to each other doesn't have to be
+    // touched, every file whose origins need re-sorting has at least one of the remaining ones
+    std::vector<size_t> tails;
+    std::vector<size_t> predecessors(order.size(), SIZE_MAX);
+    for (size_t i = 0; i < order.size(); ++i) {
+      auto pos = std::lower_bound(tails.begin(), tails.end(), i, [&] (size_t lhs, size_t rhs) {
+        return order[lhs].second < order[rhs].second;
+      });
+      if (pos != tails.begin()) {
+        predecessors[i] = *(pos - 1);
+      }
+      if (pos == tails.end()) {
+        tails.push_back(i);
+      } else {
+        *pos = i;
+      }
+    }
+    std::vector<bool> unmoved(order.size(), false);
+    for (size_t i = tails.empty() ? SIZE_MAX : tails.back(); i != SIZE_MAX; i = predecessors[i]) {
+      unmoved[i] = true;
+    }
+
+    for (auto &iter : priorities) {
+      getByID(iter.first).setPriority(iter.second);
+    }
+
+    std::vector<Index> result;
+    for (size_t i = 0; i < order.size(); ++i) {
+      if (!unmoved[i]) {
+        result.push_back(order[i].first.second);
+      }
+    }
+    return result;
+  }
+
+  void changePriorityLookup(Index ID, int newPriority)
+  {
+    if (isValid(ID)) {
+      m_Priorities[ID] = newPriority;
     }
   }
 
@@ -113,13 +191,20 @@ private:
     return m_NextID++;
   }
 
+  bool isValid(Index ID) const {
+    return (ID >= 0) && (ID < m_NextID);
+  }
+
 private:
 
   Index m_NextID;
 
-  std::map<Index, FilesOrigin> m_Origins;
-  std::map<std::wstring, Index> m_OriginsNameMap;
-  std::map<int, Index> m_OriginsPriorityMap;
+  // ids are handed out sequentially and origins are never removed so the id is the position in
+  // the table. The deque doesn't move origins when it grows, references to them stay valid
+  std::deque<FilesOrigin> m_Origins;
+  std::vector<int> m_Priorities;
+  std::unordered_map<std::wstring, Index> m_OriginsNameMap;
+  FilesOrigin m_InvalidOrigin;
 
 };
 
@@ -161,7 +246,7 @@ static std::wstring tail(const std::wstring &source, const size_t count)
 
 
 FilesOrigin::FilesOrigin()
-  : m_ID(0), m_Disabled(false), m_Name(), m_Path(), m_Priority(0)
+  : m_ID(0), m_Disabled(false), m_Name(), m_Path(), m_Priority(0), m_Contents(0), m_ContentsKnown(false)
 {
   LEAK_TRACE;
 }
@@ -172,6 +257,8 @@ FilesOrigin::FilesOrigin(const FilesOrigin &reference)
   , m_Name(reference.m_Name)
   , m_Path(reference.m_Path)
   , m_Priority(reference.m_Priority)
+  , m_Contents(reference.m_Contents)
+  , m_ContentsKnown(reference.m_ContentsKnown)
   , m_FileRegister(reference.m_FileRegister)
   , m_OriginConnection(reference.m_OriginConnection)
 {
@@ -181,7 +268,7 @@ FilesOrigin::FilesOrigin(const FilesOrigin &reference)
 
 FilesOrigin::FilesOrigin(int ID, const std::wstring &name, const std::wstring &path, int priority, boost::shared_ptr<MOShared::FileRegister> fileRegister, boost::shared_ptr<MOShared::OriginConnection> originConnection)
   : m_ID(ID), m_Disabled(false), m_Name(name), m_Path(path), m_Priority(priority),
-    m_FileRegister(fileRegister), m_OriginConnection(originConnection)
+    m_Contents(0), m_ContentsKnown(false), m_FileRegister(fileRegister), m_OriginConnection(originConnection)
 {
   LEAK_TRACE;
 }
@@ -194,7 +281,7 @@ FilesOrigin::~FilesOrigin()
 
 void FilesOrigin::setPriority(int priority)
 {
-  m_OriginConnection.lock()->changePriorityLookup(m_Priority, priority);
+  m_OriginConnection.lock()->changePriorityLookup(m_ID, priority);
 
   m_Priority = priority;
 }
@@ -213,119 +300,105 @@ void FilesOrigin::setName(const std::wstring &name)
 std::vector<FileEntry::Ptr> FilesOrigin::getFiles() const
 {
   std::vector<FileEntry::Ptr> result;
-  for (FileEntry::Index fileIdx : m_Files)
-    if (FileEntry::Ptr p = m_FileRegister.lock()->getFile(fileIdx))
-      result.push_back(p);
-
+  result.reserve(m_Files.size());
+  forEachFile([&] (const FileEntry &file) -> bool {
+    result.push_back(FileEntry::Ptr(const_cast<FileEntry*>(&file)));
+    return true;
+  });
   return result;
 }
 
 bool FilesOrigin::containsArchive(std::wstring archiveName)
 {
-  for (FileEntry::Index fileIdx : m_Files)
-    if (FileEntry::Ptr p = m_FileRegister.lock()->getFile(fileIdx))
-      if (p->isFromArchive(archiveName)) return true;
-  return false;
+  return !forEachFile([&] (const FileEntry &file) -> bool {
+    return !file.isFromArchive(archiveName);
+  });
 }
 
 //
 // FileEntry
 //
 
-void FileEntry::addOrigin(int origin, FILETIME fileTime, const std::wstring &archive, int order)
+void FileEntry::addOrigin(int origin, FILETIME fileTime, StringPool::Handle archive, int order)
 {
-  m_LastAccessed = time(nullptr);
   if (m_Parent != nullptr) {
     m_Parent->propagateOrigin(origin);
   }
+  insertOrigin(origin, fileTime, archive, order);
+}
+
+void FileEntry::insertOrigin(int origin, FILETIME fileTime, StringPool::Handle archive, int order)
+{
+  m_LastAccessed = time(nullptr);
+  if (m_Parent != nullptr) {
+    m_Parent->m_FileRegister->touch();
+  }
   if (m_Origin == -1) {
     m_Origin = origin;
     m_FileTime = fileTime;
-    m_Archive = std::pair<std::wstring, int>(archive, order);
-  } else if ((m_Parent != nullptr)
-             && (m_Parent->getOriginByID(origin).getPriority() > m_Parent->getOriginByID(m_Origin).getPriority())
-             && (archive.size() == 0 || m_Archive.first.size() > 0 )) {
-    if (std::find_if(m_Alternatives.begin(), m_Alternatives.end(), [&](const std::pair<int, std::pair<std::wstring, int>> &i) -> bool { return i.first == m_Origin; }) == m_Alternatives.end()) {
-      m_Alternatives.push_back(std::pair<int, std::pair<std::wstring, int>>(m_Origin, m_Archive));
-    }
+    m_Archive = ArchiveInfo(archive, order);
+    return;
+  }
+
+  if ((m_Origin == origin)
+      || (std::find_if(m_Alternatives.begin(), m_Alternatives.end(),
+                       [&](const AlternativeInfo &i) -> bool { return i.first == origin; }) != m_Alternatives.end())) {
+    // already an origin
+    return;
+  }
+
+  AlternativeInfo added(origin, ArchiveInfo(archive, order), fileTime);
+  if (m_Parent == nullptr) {
+    m_Alternatives.push_back(added);
+  } else if (originLess(AlternativeInfo(m_Origin, m_Archive, m_FileTime), added)) {
+    // the structure is built in priority order so this is the common case
+    m_Alternatives.push_back(AlternativeInfo(m_Origin, m_Archive, m_FileTime));
     m_Origin = origin;
     m_FileTime = fileTime;
-    m_Archive = std::pair<std::wstring, int>(archive, order);
+    m_Archive = added.second;
   } else {
-    bool found = false;
-    if (m_Origin == origin) {
-      // already an origin
-      return;
-    }
-    for (std::vector<std::pair<int, std::pair<std::wstring, int>>>::iterator iter = m_Alternatives.begin(); iter != m_Alternatives.end(); ++iter) {
-      if (iter->first == origin) {
-        // already an origin
-        return;
-      }
-      if ((m_Parent != nullptr)
-          && (m_Parent->getOriginByID(iter->first).getPriority() < m_Parent->getOriginByID(origin).getPriority())) {
-        m_Alternatives.insert(iter, std::pair<int, std::pair<std::wstring, int>>(origin, std::pair<std::wstring, int>(archive, order)));
-        found = true;
-        break;
-      }
-    }
-    if (!found) {
-      m_Alternatives.push_back(std::pair<int, std::pair<std::wstring, int>>(origin, std::pair<std::wstring, int>(archive, order)));
+    // the origins are always kept in the order sortOrigins would put them in
+    AlternativeInfo *pos = m_Alternatives.end();
+    while ((pos != m_Alternatives.begin()) && originLess(added, *(pos - 1))) {
+      --pos;
     }
+    m_Alternatives.insert(pos, added);
   }
 }
 
 bool FileEntry::removeOrigin(int origin)
 {
+  if (m_Parent != nullptr) {
+    m_Parent->m_FileRegister->touch();
+  }
   if (m_Origin == origin) {
     if (!m_Alternatives.empty()) {
-      // find alternative with the highest priority
-      std::vector<std::pair<int, std::pair<std::wstring, int>>>::iterator currentIter = m_Alternatives.begin();
-      for (std::vector<std::pair<int, std::pair<std::wstring, int>>>::iterator iter = m_Alternatives.begin(); iter != m_Alternatives.end(); ++iter) {
-        if ((m_Parent->getOriginByID(iter->first).getPriority() > m_Parent->getOriginByID(currentIter->first).getPriority()) &&
-            (iter->first != origin)) {
-          currentIter = iter;
-        }
-      }
-      int currentID = currentIter->first;
-      m_Alternatives.erase(currentIter);
-
-      m_Origin = currentID;
-
-      // now we need to update the file time...
-      std::wstring filePath = getFullPath();
-      HANDLE file = ::CreateFile(filePath.c_str(), GENERIC_READ | GENERIC_WRITE,
-                                 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-      if (!::GetFileTime(file, nullptr, nullptr, &m_FileTime)) {
-        // maybe this file is in a bsa, but there is no easy way to find out which. User should refresh
-        // the view to find out
-        m_Archive = std::pair<std::wstring, int>(L"bsa?", -1);
-      } else {
-        m_Archive = std::pair<std::wstring, int>(L"", -1);
-      }
-
-      ::CloseHandle(file);
-
+      // the alternatives are sorted, the last one takes over along with the time it had for
+      // the file, so the result is the same as if the removed origin had never been added
+      m_Origin = m_Alternatives.back().first;
+      m_Archive = m_Alternatives.back().second;
+      m_FileTime = m_Alternatives.back().fileTime;
+      m_Alternatives.pop_back();
     } else {
       m_Origin = -1;
       return true;
     }
   } else {
-    std::vector<std::pair<int, std::pair<std::wstring, int>>>::iterator newEnd = std::find_if(m_Alternatives.begin(), m_Alternatives.end(), [&](const std::pair<int, std::pair<std::wstring, int>> &i) -> bool { return i.first == origin; });
-    if (newEnd != m_Alternatives.end())
-      m_Alternatives.erase(newEnd, m_Alternatives.end());
+    AlternativeInfo *iter = std::find_if(m_Alternatives.begin(), m_Alternatives.end(), [&](const AlternativeInfo &i) -> bool { return i.first == origin; });
+    if (iter != m_Alternatives.end())
+      m_Alternatives.erase(iter);
   }
   return false;
 }
 
 FileEntry::FileEntry()
-  : m_Index(UINT_MAX), m_Name(), m_Origin(-1), m_Parent(nullptr), m_LastAccessed(time(nullptr))
+  : m_Index(ULLONG_MAX), m_Name(StringPool::EMPTY), m_Origin(-1), m_Archive(StringPool::EMPTY, -1), m_Parent(nullptr), m_LastAccessed(time(nullptr))
 {
   LEAK_TRACE;
 }
 
-FileEntry::FileEntry(Index index, const std::wstring &name, DirectoryEntry *parent)
-  : m_Index(index), m_Name(name), m_Origin(-1), m_Archive(L"", -1), m_Parent(parent), m_LastAccessed(time(nullptr))
+FileEntry::FileEntry(Index index, StringPool::Handle name, DirectoryEntry *parent)
+  : m_Index(index), m_Name(name), m_Origin(-1), m_Archive(StringPool::EMPTY, -1), m_Parent(parent), m_LastAccessed(time(nullptr))
 {
   LEAK_TRACE;
 }
@@ -335,70 +408,115 @@ FileEntry::~FileEntry()
   LEAK_UNTRACE;
 }
 
-void FileEntry::sortOrigins()
+bool FileEntry::originLess(const AlternativeInfo &LHS, const AlternativeInfo &RHS) const
 {
-  m_Alternatives.push_back(std::pair<int, std::pair<std::wstring, int>>(m_Origin, m_Archive));
-  std::sort(m_Alternatives.begin(), m_Alternatives.end(), [&](const std::pair<int, std::pair<std::wstring, int>> &LHS, const std::pair<int, std::pair<std::wstring, int>> &RHS) -> bool {
-    if (!LHS.second.first.size() && !RHS.second.first.size()) {
-      int l = m_Parent->getOriginByID(LHS.first).getPriority(); if (l < 0) l = INT_MAX;
-      int r = m_Parent->getOriginByID(RHS.first).getPriority(); if (r < 0) r = INT_MAX;
-
-      return l < r;
-    }
+  // the order has to be total, otherwise the result would depend on the order in which origins were
+  // added and a partially updated structure could differ from a freshly built one
+  bool lArchive = LHS.second.first != StringPool::EMPTY;
+  bool rArchive = RHS.second.first != StringPool::EMPTY;
+  if (lArchive != rArchive) {
+    return lArchive;
+  }
 
-    if (LHS.second.first.size() && RHS.second.first.size()) {
-      int l = LHS.second.second; if (l < 0) l = INT_MAX;
-      int r = RHS.second.second; if (r < 0) r = INT_MAX;
+  int lPriority = m_Parent->getOriginPriority(LHS.first); if (lPriority < 0) lPriority = INT_MAX;
+  int rPriority = m_Parent->getOriginPriority(RHS.first); if (rPriority < 0) rPriority = INT_MAX;
 
+  if (lArchive) {
+    int l = LHS.second.second; if (l < 0) l = INT_MAX;
+    int r = RHS.second.second; if (r < 0) r = INT_MAX;
+    if (l != r) {
       return l > r;
     }
+    if (lPriority != rPriority) {
+      return lPriority < rPriority;
+    }
+    const StringPool &pool = m_Parent->getStringPool();
+    PooledString lhsArchive = pool.get(LHS.second.first);
+    PooledString rhsArchive = pool.get(RHS.second.first);
+    return FoldedCompare(lhsArchive.c_str(), lhsArchive.length(), rhsArchive.c_str(), rhsArchive.length()) < 0;
+  }
 
-    if (RHS.second.first.size()) return false;
-    return true;
+  if (lPriority != rPriority) {
+    return lPriority < rPriority;
+  }
+  return LHS.first < RHS.first;
+}
+
+void FileEntry::sortOrigins()
+{
+  m_Alternatives.push_back(AlternativeInfo(m_Origin, m_Archive, m_FileTime));
+  std::sort(m_Alternatives.begin(), m_Alternatives.end(), [&](const AlternativeInfo &LHS, const AlternativeInfo &RHS) -> bool {
+    return originLess(LHS, RHS);
   });
   if (!m_Alternatives.empty()) {
     m_Origin = m_Alternatives.back().first;
     m_Archive = m_Alternatives.back().second;
+    m_FileTime = m_Alternatives.back().fileTime;
     m_Alternatives.pop_back();
   }
 }
 
 
-bool FileEntry::recurseParents(std::wstring &path, const DirectoryEntry *parent) const
+std::wstring FileEntry::getFullPath() const
 {
-  if (parent == nullptr) {
-    return false;
-  } else {
-    // don't append the topmost parent because it is the virtual data-root
-    if (recurseParents(path, parent->getParent())) {
-      path.append(L"\\").append(parent->getName());
-    }
-    return true;
-  }
+  std::wstring result;
+  getFullPath(result);
+  return result;
 }
 
-std::wstring FileEntry::getFullPath() const
+std::wstring FileEntry::getRelativePath() const
 {
   std::wstring result;
+  getRelativePath(result);
+  return result;
+}
+
+void FileEntry::getFullPath(std::wstring &result) const
+{
   bool ignore = false;
-  result = m_Parent->getOriginByID(getOrigin(ignore)).getPath(); //base directory for origin
-  recurseParents(result, m_Parent); // all intermediate directories
-  return result + L"\\" + m_Name;
+  const std::wstring &originPath = m_Parent->getOriginByID(getOrigin(ignore)).getPath(); //base directory for origin
+  PooledString directoryPath = m_Parent->getRelativePath(); // all intermediate directories
+  PooledString name = getName();
+  result.clear();
+  result.reserve(originPath.length() + directoryPath.length() + name.length() + 1);
+  result.append(originPath).append(directoryPath.c_str(), directoryPath.length()).append(L"\\")
+        .append(name.c_str(), name.length());
 }
 
-std::wstring FileEntry::getRelativePath() const
+void FileEntry::getRelativePath(std::wstring &result) const
 {
-  std::wstring result;
-  recurseParents(result, m_Parent); // all intermediate directories
-  return result + L"\\" + m_Name;
+  PooledString directoryPath = m_Parent->getRelativePath(); // all intermediate directories
+  PooledString name = getName();
+  result.clear();
+  result.reserve(directoryPath.length() + name.length() + 1);
+  result.append(directoryPath.c_str(), directoryPath.length()).append(L"\\").append(name.c_str(), name.length());
 }
 
-bool FileEntry::isFromArchive(std::wstring archiveName)
+PooledString FileEntry::getName() const
 {
-  if (archiveName.length() == 0) return m_Archive.first.length() != 0;
-  if (m_Archive.first.compare(archiveName) == 0) return true;
-  for (auto alternative : m_Alternatives) {
-    if (alternative.second.first.compare(archiveName) == 0) return true;
+  return m_Parent != nullptr ? m_Parent->getStringPool().get(m_Name) : PooledString();
+}
+
+PooledString FileEntry::getArchiveName() const
+{
+  return m_Parent != nullptr ? m_Parent->getStringPool().get(m_Archive.first) : PooledString();
+}
+
+bool FileEntry::isFromArchive(std::wstring archiveName) const
+{
+  if (archiveName.length() == 0) return m_Archive.first != StringPool::EMPTY;
+  if (m_Parent == nullptr) return false;
+  StringPool::Handle archive = m_Parent->getStringPool().find(archiveName);
+  // an archive name that was never interned can't be referenced by any file
+  return (archive != StringPool::INVALID) && isFromArchive(archive);
+}
+
+bool FileEntry::isFromArchive(StringPool::Handle archive) const
+{
+  if (archive == StringPool::EMPTY) return m_Archive.first != StringPool::EMPTY;
+  if (m_Archive.first == archive) return true;
+  for (const AlternativeInfo &alternative : m_Alternatives) {
+    if (alternative.second.first == archive) return true;
   }
   return false;
 }
@@ -408,24 +526,75 @@ bool FileEntry::isFromArchive(std::wstring archiveName)
 // DirectoryEntry
 //
 DirectoryEntry::DirectoryEntry(const std::wstring &name, DirectoryEntry *parent, int originID)
-  : m_OriginConnection(new OriginConnection),
-    m_Name(name), m_Parent(parent), m_Populated(false), m_TopLevel(true)
+  : m_OriginConnection(new OriginConnection), m_StringPool(new StringPool),
+    m_Parent(parent), m_PathHash(CaseInsensitiveHashSeed), m_RelativePath(StringPool::EMPTY),
+    m_Populated(false), m_TopLevel(true)
 {
   m_FileRegister.reset(new FileRegister(m_OriginConnection));
+  m_Name = m_StringPool->intern(name);
+  if (parent != nullptr) {
+    m_RelativePath = m_StringPool->intern(parent->getRelativePath().str() + L"\\" + name);
+  }
   m_Origins.insert(originID);
   LEAK_TRACE;
 }
 
-DirectoryEntry::DirectoryEntry(const std::wstring &name, DirectoryEntry *parent, int originID,
-               boost::shared_ptr<FileRegister> fileRegister, boost::shared_ptr<OriginConnection> originConnection)
-  : m_FileRegister(fileRegister), m_OriginConnection(originConnection),
-    m_Name(name), m_Parent(parent), m_Populated(false), m_TopLevel(false)
+DirectoryEntry::DirectoryEntry(StringPool::Handle name, DirectoryEntry *parent, int originID,
+               boost::shared_ptr<FileRegister> fileRegister, boost::shared_ptr<OriginConnection> originConnection,
+               boost::shared_ptr<StringPool> stringPool)
+  : m_FileRegister(fileRegister), m_OriginConnection(originConnection), m_StringPool(stringPool),
+    m_Name(name), m_Parent(parent), m_PathHash(CaseInsensitiveHashSeed), m_RelativePath(StringPool::EMPTY),
+    m_Populated(false), m_TopLevel(false)
 {
   LEAK_TRACE;
+  if (parent != nullptr) {
+    m_PathHash = parent->m_PathHash;
+    if (parent->m_Parent != nullptr) {
+      m_PathHash = CaseInsensitiveHashAppend(m_PathHash, L"\\", 1);
+    }
+    PooledString nameString = m_StringPool->get(name);
+    m_PathHash = CaseInsensitiveHashAppend(m_PathHash, nameString.c_str(), nameString.length());
+    // computed here rather than on first use, the pool can't be written to once the structure is
+    // read from other threads
+    std::wstring relativePath = parent->getRelativePath();
+    relativePath.append(L"\\").append(nameString.c_str(), nameString.length());
+    m_RelativePath = m_StringPool->intern(relativePath);
+  }
   m_Origins.insert(originID);
 }
 
 
+DirectoryEntry::DirectoryEntry(const DirectoryEntry &reference, DirectoryEntry *parent,
+               boost::shared_ptr<FileRegister> fileRegister, boost::shared_ptr<OriginConnection> originConnection,
+               boost::shared_ptr<StringPool> stringPool)
+  : m_FileRegister(fileRegister), m_OriginConnection(originConnection), m_StringPool(stringPool),
+    m_Name(reference.m_Name), m_Files(reference.m_Files), m_Parent(parent), m_PathHash(reference.m_PathHash),
+    m_RelativePath(reference.m_RelativePath), m_Origins(reference.m_Origins),
+    m_Populated(reference.m_Populated), m_TopLevel(reference.m_TopLevel)
+{
+  LEAK_TRACE;
+  // the register was copied with the files still pointing into the original tree
+  m_Files.forEach([this] (FileEntry::Index index) {
+    FileEntry::Ptr file = m_FileRegister->getFile(index);
+    if (file.get() != nullptr) {
+      file->m_Parent = this;
+    }
+  });
+  try {
+    m_SubDirectories.reserve(reference.m_SubDirectories.size());
+    for (const DirectoryEntry *directory : reference.m_SubDirectories) {
+      DirectoryEntry *copy = new DirectoryEntry(*directory, this, fileRegister, originConnection, stringPool);
+      m_SubDirectories.push_back(copy);
+      PooledString name = copy->getName();
+      m_SubDirectoryIndex.insert(name.c_str(), name.length(), copy);
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+
 DirectoryEntry::~DirectoryEntry()
 {
   LEAK_UNTRACE;
@@ -433,9 +602,20 @@ DirectoryEntry::~DirectoryEntry()
 }
 
 
-const std::wstring &DirectoryEntry::getName() const
+DirectoryEntry *DirectoryEntry::clone() const
 {
-  return m_Name;
+  assert(m_TopLevel);
+  boost::shared_ptr<OriginConnection> originConnection(new OriginConnection);
+  boost::shared_ptr<FileRegister> fileRegister(new FileRegister(*m_FileRegister, originConnection));
+  originConnection->assign(*m_OriginConnection, fileRegister, originConnection);
+  boost::shared_ptr<StringPool> stringPool(new StringPool(*m_StringPool));
+  return new DirectoryEntry(*this, m_Parent, fileRegister, originConnection, stringPool);
+}
+
+
+PooledString DirectoryEntry::getName() const
+{
+  return m_StringPool->get(m_Name);
 }
 
 
@@ -446,6 +626,7 @@ void DirectoryEntry::clear()
     delete entry;
   }
   m_SubDirectories.clear();
+  m_SubDirectoryIndex.clear();
 }
 
 
@@ -462,27 +643,56 @@ FilesOrigin &DirectoryEntry::createOrigin(const std::wstring &originName, const
 
 
 void DirectoryEntry::addFromOrigin(const std::wstring &originName, const std::wstring &directory, int priority)
+{
+  OriginScan scan;
+  if (directory.length() != 0) {
+    scan.scanDirectory(directory);
+  }
+  addFromOrigin(originName, directory, priority, scan);
+}
+
+
+void DirectoryEntry::addFromOrigin(const std::wstring &originName, const std::wstring &directory, int priority,
+                                   const OriginScan &scan)
 {
   FilesOrigin &origin = createOrigin(originName, directory, priority);
   if (directory.length() != 0) {
-    boost::scoped_array<wchar_t> buffer(new wchar_t[MAXPATH_UNICODE + 1]);
-    memset(buffer.get(), L'\0', MAXPATH_UNICODE + 1);
-    int offset = _snwprintf(buffer.get(), MAXPATH_UNICODE, L"%ls", directory.c_str());
-    buffer.get()[offset] = L'\0';
-    addFiles(origin, buffer.get(), offset);
+    addFiles(origin, scan, StringPool::EMPTY, -1);
   }
   m_Populated = true;
 }
 
 
 void DirectoryEntry::addFromBSA(const std::wstring &originName, std::wstring &directory, const std::wstring &fileName, int priority, int order)
+{
+  // parsing the archive is the expensive part, skip it if the result would be discarded anyway
+  WIN32_FILE_ATTRIBUTE_DATA fileData;
+  if (::GetFileAttributesExW(fileName.c_str(), GetFileExInfoStandard, &fileData)
+      && !archiveNeedsUpdate(fileName, fileData.ftLastWriteTime)) {
+    createOrigin(originName, directory, priority);
+    return;
+  }
+  OriginScan scan;
+  scan.scanArchive(fileName);
+  addFromBSA(originName, directory, fileName, priority, order, scan);
+}
+
+
+void DirectoryEntry::addFromBSA(const std::wstring &originName, std::wstring &directory, const std::wstring &fileName,
+                                int priority, int order, const OriginScan &scan)
 {
   FilesOrigin &origin = createOrigin(originName, directory, priority);
 
-  WIN32_FILE_ATTRIBUTE_DATA fileData;
-  if (::GetFileAttributesExW(fileName.c_str(), GetFileExInfoStandard, &fileData) == 0) {
-    throw windows_error("failed to determine file time");
+  if (archiveNeedsUpdate(fileName, scan.lastWriteTime())) {
+    size_t namePos = fileName.find_last_of(L"\\/");
+    namePos = (namePos == std::wstring::npos) ? 0 : namePos + 1;
+    addFiles(origin, scan, m_StringPool->intern(fileName.c_str() + namePos, fileName.length() - namePos), order);
+    m_Populated = true;
   }
+}
+
+bool DirectoryEntry::archiveNeedsUpdate(const std::wstring &fileName, FILETIME archiveTime)
+{
   FILETIME now;
   ::GetSystemTimeAsFileTime(&now);
 
@@ -498,18 +708,7 @@ void DirectoryEntry::addFromBSA(const std::wstring &originName, std::wstring &di
     ++namePos;
   }
 
-  if (!containsArchive(fileName.substr(namePos)) || ::CompareFileTime(&fileData.ftLastWriteTime, &now) > 0) {
-    BSA::Archive archive;
-    BSA::EErrorCode res = archive.read(ToString(fileName, false).c_str(), false);
-    if ((res != BSA::ERROR_NONE) && (res != BSA::ERROR_INVALIDHASHES)) {
-      std::ostringstream stream;
-      stream << "invalid bsa file: " << ToString(fileName, false) << " errorcode " << res << " - " << ::GetLastError();
-      throw std::runtime_error(stream.str());
-    }
-
-    addFiles(origin, archive.getRoot(), fileData.ftLastWriteTime, fileName.substr(namePos), order);
-    m_Populated = true;
-  }
+  return !containsArchive(fileName.substr(namePos)) || ::CompareFileTime(&archiveTime, &now) > 0;
 }
 
 void DirectoryEntry::propagateOrigin(int origin)
@@ -540,24 +739,120 @@ static bool SupportOptimizedFind()
 
 static bool DirCompareByName(const DirectoryEntry *lhs, const DirectoryEntry *rhs)
 {
-  return _wcsicmp(lhs->getName().c_str(), rhs->getName().c_str()) < 0;
+  PooledString lhsName = lhs->getName();
+  PooledString rhsName = rhs->getName();
+  return FoldedCompare(lhsName.c_str(), lhsName.length(), rhsName.c_str(), rhsName.length()) < 0;
 }
 
 
-void DirectoryEntry::addFiles(FilesOrigin &origin, wchar_t *buffer, int bufferOffset)
+void DirectoryEntry::addFiles(FilesOrigin &origin, const OriginScan &scan, StringPool::Handle archiveName, int order)
 {
-  WIN32_FIND_DATAW findData;
+  // replays the scan, the directory stack mirrors the recursion that generated it. The stack also
+  // tracks which directories received files so the origin is recorded once per directory instead
+  // of walking up the tree for every file
+  struct Level {
+    DirectoryEntry *directory;
+    bool hasFiles;
+  };
 
-  _snwprintf_s(buffer + bufferOffset, MAXPATH_UNICODE - bufferOffset, _TRUNCATE, L"\\*");
+  const int originID = origin.getID();
+  std::vector<Level> directories;
+  directories.push_back({ this, false });
+
+  auto leaveDirectory = [&] () {
+    Level level = directories.back();
+    directories.pop_back();
+    if (level.hasFiles) {
+      // directories between the levels of the stack were created with the origin already
+      level.directory->m_Origins.insert(originID);
+      directories.back().hasFiles = true;
+    }
+  };
+
+  for (const OriginScan::Entry &entry : scan.entries()) {
+    DirectoryEntry *current = directories.back().directory;
+    switch (entry.type) {
+      case OriginScan::ENTRY_DIRECTORY: {
+        if (scan.isArchive()) {
+          // folder names in archives may span multiple levels
+          directories.push_back({ current->getSubDirectoryRecursive(entry.name, true, originID), false });
+        } else {
+          directories.push_back({ current->getSubDirectory(entry.name, true, originID), false });
+        }
+      } break;
+      case OriginScan::ENTRY_FILE: {
+        current->insert(entry.name, origin, entry.fileTime, archiveName, order);
+        directories.back().hasFiles = true;
+      } break;
+      case OriginScan::ENTRY_END_DIRECTORY: {
+        leaveDirectory();
+      } break;
+    }
+  }
+
+  while (directories.size() > 1) {
+    leaveDirectory();
+  }
+  if (directories.back().hasFiles) {
+    propagateOrigin(originID);
+  }
+}
 
-  HANDLE searchHandle = nullptr;
 
+//
+// OriginScan
+//
+
+OriginScan::OriginScan()
+  : m_Archive(false), m_Size(0)
+{
+  m_LastWriteTime.dwLowDateTime = 0;
+  m_LastWriteTime.dwHighDateTime = 0;
+}
+
+
+static FILETIME GetLastWriteTime(const wchar_t *path)
+{
+  WIN32_FILE_ATTRIBUTE_DATA fileData;
+  if (::GetFileAttributesExW(path, GetFileExInfoStandard, &fileData) == 0) {
+    FILETIME none = { 0, 0 };
+    return none;
+  }
+  return fileData.ftLastWriteTime;
+}
+
+
+HANDLE OriginScan::findFirstFile(const wchar_t *pattern, WIN32_FIND_DATAW &findData)
+{
   if (SupportOptimizedFind()) {
-    searchHandle = ::FindFirstFileExW(buffer, FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr,
-                                      FIND_FIRST_EX_LARGE_FETCH);
+    return ::FindFirstFileExW(pattern, FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr,
+                              FIND_FIRST_EX_LARGE_FETCH);
   } else {
-    searchHandle = ::FindFirstFileExW(buffer, FindExInfoStandard, &findData, FindExSearchNameMatch, nullptr, 0);
+    return ::FindFirstFileExW(pattern, FindExInfoStandard, &findData, FindExSearchNameMatch, nullptr, 0);
   }
+}
+
+
+void OriginScan::scanDirectory(const std::wstring &directory)
+{
+  m_Archive = false;
+  m_Size = 0;
+  m_LastWriteTime = GetLastWriteTime(directory.c_str());
+  boost::scoped_array<wchar_t> buffer(new wchar_t[MAXPATH_UNICODE + 1]);
+  memset(buffer.get(), L'\0', MAXPATH_UNICODE + 1);
+  int offset = _snwprintf(buffer.get(), MAXPATH_UNICODE, L"%ls", directory.c_str());
+  buffer.get()[offset] = L'\0';
+  scanDirectory(buffer.get(), offset);
+}
+
+
+void OriginScan::scanDirectory(wchar_t *buffer, int bufferOffset)
+{
+  WIN32_FIND_DATAW findData;
+
+  _snwprintf_s(buffer + bufferOffset, MAXPATH_UNICODE - bufferOffset, _TRUNCATE, L"\\*");
+
+  HANDLE searchHandle = findFirstFile(buffer, findData);
 
   if (searchHandle != INVALID_HANDLE_VALUE) {
     BOOL result = true;
@@ -566,38 +861,73 @@ void DirectoryEntry::addFiles(FilesOrigin &origin, wchar_t *buffer, int bufferOf
         if ((wcscmp(findData.cFileName, L".") != 0) &&
             (wcscmp(findData.cFileName, L"..") != 0)) {
           int offset = _snwprintf(buffer + bufferOffset, MAXPATH_UNICODE, L"\\%ls", findData.cFileName);
+          // the time in findData may be outdated (it's a copy in the parent directory), ask the
+          // directory itself so the time can later be compared to detect changes
+          m_Entries.push_back({ ENTRY_DIRECTORY, findData.cFileName, GetLastWriteTime(buffer) });
           // recurse into subdirectories
-          getSubDirectory(findData.cFileName, true, origin.getID())->addFiles(origin, buffer, bufferOffset + offset);
+          scanDirectory(buffer, bufferOffset + offset);
+          m_Entries.push_back({ ENTRY_END_DIRECTORY, std::wstring(), findData.ftLastWriteTime });
         }
       } else {
-        insert(findData.cFileName, origin, findData.ftLastWriteTime, L"", -1);
+        m_Entries.push_back({ ENTRY_FILE, findData.cFileName, findData.ftLastWriteTime });
       }
       result = ::FindNextFileW(searchHandle, &findData);
     }
   }
-  std::sort(m_SubDirectories.begin(), m_SubDirectories.end(), &DirCompareByName);
   ::FindClose(searchHandle);
 }
 
 
-void DirectoryEntry::addFiles(FilesOrigin &origin, BSA::Folder::Ptr archiveFolder, FILETIME &fileTime, const std::wstring &archiveName, int order)
+void OriginScan::scanArchive(const std::wstring &fileName)
+{
+  m_Archive = true;
+
+  WIN32_FILE_ATTRIBUTE_DATA fileData;
+  if (::GetFileAttributesExW(fileName.c_str(), GetFileExInfoStandard, &fileData) == 0) {
+    throw windows_error("failed to determine file time");
+  }
+  m_LastWriteTime = fileData.ftLastWriteTime;
+  m_Size = (static_cast<unsigned long long>(fileData.nFileSizeHigh) << 32) | fileData.nFileSizeLow;
+
+  BSA::Archive archive;
+  BSA::EErrorCode res = archive.read(ToString(fileName, false).c_str(), false);
+  if ((res != BSA::ERROR_NONE) && (res != BSA::ERROR_INVALIDHASHES)) {
+    std::ostringstream stream;
+    stream << "invalid bsa file: " << ToString(fileName, false) << " errorcode " << res << " - " << ::GetLastError();
+    throw std::runtime_error(stream.str());
+  }
+
+  scanFolder(archive.getRoot());
+}
+
+
+void OriginScan::scanFolder(BSA::Folder::Ptr archiveFolder)
 {
   // add files
   for (unsigned int fileIdx = 0; fileIdx < archiveFolder->getNumFiles(); ++fileIdx) {
     BSA::File::Ptr file = archiveFolder->getFile(fileIdx);
-    insert(ToWString(file->getName(), true), origin, fileTime, archiveName, order);
+    m_Entries.push_back({ ENTRY_FILE, ToWString(file->getName(), true), m_LastWriteTime });
   }
 
   // recurse into subdirectories
   for (unsigned int folderIdx = 0; folderIdx < archiveFolder->getNumSubFolders(); ++folderIdx) {
     BSA::Folder::Ptr folder = archiveFolder->getSubFolder(folderIdx);
-    DirectoryEntry *folderEntry = getSubDirectoryRecursive(ToWString(folder->getName(), true), true, origin.getID());
-
-    folderEntry->addFiles(origin, folder, fileTime, archiveName, order);
+    m_Entries.push_back({ ENTRY_DIRECTORY, ToWString(folder->getName(), true), m_LastWriteTime });
+    scanFolder(folder);
+    m_Entries.push_back({ ENTRY_END_DIRECTORY, std::wstring(), m_LastWriteTime });
   }
 }
 
 
+void OriginScan::restore(bool archive, FILETIME lastWriteTime, unsigned long long size, std::vector<Entry> &&entries)
+{
+  m_Archive = archive;
+  m_LastWriteTime = lastWriteTime;
+  m_Size = size;
+  m_Entries = std::move(entries);
+}
+
+
 bool DirectoryEntry::removeFile(const std::wstring &filePath, int *origin)
 {
   size_t pos = filePath.find_first_of(L"\\/");
@@ -617,29 +947,32 @@ bool DirectoryEntry::removeFile(const std::wstring &filePath, int *origin)
 
 void DirectoryEntry::removeDirRecursive()
 {
-  while (!m_Files.empty()) {
-    m_FileRegister->removeFile(m_Files.begin()->second);
+  std::vector<FileEntry::Index> files;
+  files.reserve(m_Files.size());
+  m_Files.forEach([&files] (FileEntry::Index index) { files.push_back(index); });
+  for (FileEntry::Index index : files) {
+    m_FileRegister->removeFile(index);
   }
+  m_Files.clear();
 
   for (DirectoryEntry *entry : m_SubDirectories) {
     entry->removeDirRecursive();
     delete entry;
   }
   m_SubDirectories.clear();
+  m_SubDirectoryIndex.clear();
 }
 
 void DirectoryEntry::removeDir(const std::wstring &path)
 {
   size_t pos = path.find_first_of(L"\\/");
   if (pos == std::string::npos) {
-    for (auto iter = m_SubDirectories.begin(); iter != m_SubDirectories.end(); ++iter) {
-      DirectoryEntry *entry = *iter;
-      if (CaseInsensitiveEqual(entry->getName(), path)) {
-        entry->removeDirRecursive();
-        m_SubDirectories.erase(iter);
-        delete entry;
-        break;
-      }
+    DirectoryEntry *entry = findSubDirectory(path.c_str(), path.length());
+    if (entry != nullptr) {
+      entry->removeDirRecursive();
+      m_SubDirectoryIndex.erase(entry->getName().c_str(), entry->getName().length(), entry);
+      m_SubDirectories.erase(std::find(m_SubDirectories.begin(), m_SubDirectories.end(), entry));
+      delete entry;
     }
   } else {
     std::wstring dirName = path.substr(0, pos);
@@ -651,16 +984,43 @@ void DirectoryEntry::removeDir(const std::wstring &path)
   }
 }
 
+void DirectoryEntry::pruneOrigin(int originID)
+{
+  for (auto iter = m_SubDirectories.begin(); iter != m_SubDirectories.end();) {
+    DirectoryEntry *entry = *iter;
+    entry->pruneOrigin(originID);
+    // -1 is recorded for folders created from archive paths, it doesn't stand for an origin
+    bool provided = std::find_if(entry->m_Origins.begin(), entry->m_Origins.end(),
+                                 [] (int origin) { return origin != -1; }) != entry->m_Origins.end();
+    if (!provided && entry->isEmpty()) {
+      m_SubDirectoryIndex.erase(entry->getName().c_str(), entry->getName().length(), entry);
+      iter = m_SubDirectories.erase(iter);
+      delete entry;
+    } else {
+      ++iter;
+    }
+  }
+  m_Origins.erase(originID);
+}
+
+std::vector<int> DirectoryEntry::setOriginPriorities(const std::map<int, int> &priorities)
+{
+  std::vector<int> moved = m_OriginConnection->changePriorities(priorities);
+  m_FileRegister->sortOrigins(moved);
+  return moved;
+}
+
 bool DirectoryEntry::hasContentsFromOrigin(int originID) const
 {
-  return m_Origins.find(originID) != m_Origins.end();
+  return m_Origins.contains(originID);
 }
 
 void DirectoryEntry::insertFile(const std::wstring &filePath, FilesOrigin &origin, FILETIME fileTime)
 {
   size_t pos = filePath.find_first_of(L"\\/");
   if (pos == std::string::npos) {
-    this->insert(filePath, origin, fileTime, std::wstring(), -1);
+    this->insert(filePath, origin, fileTime, StringPool::EMPTY, -1);
+    propagateOrigin(origin.getID());
   } else {
     std::wstring dirName = filePath.substr(0, pos);
     std::wstring rest = filePath.substr(pos + 1);
@@ -672,12 +1032,8 @@ void DirectoryEntry::insertFile(const std::wstring &filePath, FilesOrigin &origi
 void DirectoryEntry::removeFile(FileEntry::Index index)
 {
   if (!m_Files.empty()) {
-    auto iter = std::find_if(m_Files.begin(), m_Files.end(),
-                             [&index](const std::pair<std::wstring, FileEntry::Index> &iter) -> bool {
-                               return iter.second == index; } );
-    if (iter != m_Files.end()) {
-      m_Files.erase(iter);
-    } else {
+    PooledString name = fileName(index);
+    if (!m_Files.erase(name.c_str(), name.length(), index)) {
       log("file \"%ls\" not in directory \"%ls\"",
           m_FileRegister->getFile(index)->getName().c_str(),
           this->getName().c_str());
@@ -692,32 +1048,42 @@ void DirectoryEntry::removeFile(FileEntry::Index index)
 
 void DirectoryEntry::removeFiles(const std::set<FileEntry::Index> &indices)
 {
-  for (auto iter = m_Files.begin(); iter != m_Files.end();) {
-    if (indices.find(iter->second) != indices.end()) {
-      m_Files.erase(iter++);
-    } else {
-      ++iter;
-    }
-  }
+  m_Files.eraseIf([&indices] (FileEntry::Index index) -> bool {
+    return indices.find(index) != indices.end();
+  });
 }
 
 bool DirectoryEntry::containsArchive(std::wstring archiveName)
 {
-  for (auto iter = m_Files.begin(); iter != m_Files.end(); ++iter) {
-    FileEntry::Ptr entry = m_FileRegister->getFile(iter->second);
-    if (entry->isFromArchive(archiveName)) return true;
+  StringPool::Handle archive = m_StringPool->find(archiveName);
+  if (archive == StringPool::INVALID) {
+    // no file refers to an archive that was never interned
+    return false;
   }
-  return false;
+  bool found = false;
+  m_Files.forEach([&] (FileEntry::Index index) {
+    if (!found) {
+      FileEntry::Ptr entry = m_FileRegister->getFile(index);
+      found = entry->isFromArchive(archive);
+    }
+  });
+  return found;
 }
 
 int DirectoryEntry::anyOrigin() const
 {
-  bool ignore;
-  for (auto iter = m_Files.begin(); iter != m_Files.end(); ++iter) {
-    FileEntry::Ptr entry = m_FileRegister->getFile(iter->second);
-    if ((entry.get() != nullptr) && !entry->isFromArchive()) {
-      return entry->getOrigin(ignore);
+  // the loose file that comes first by name determines the origin. The index isn't ordered, so
+  // taking the first file visited would make the result depend on the hashes
+  const FileEntry *first = nullptr;
+  forEachFile([&] (const FileEntry &file) -> bool {
+    if ((file.getArchive().first == StringPool::EMPTY)
+        && ((first == nullptr) || (file < *first))) {
+      first = &file;
     }
+    return true;
+  });
+  if (first != nullptr) {
+    return first->getOrigin();
   }
 
   // if we got here, no file directly within this directory is a valid indicator for a mod, thus
@@ -744,6 +1110,12 @@ FilesOrigin &DirectoryEntry::getOriginByID(int ID) const
 }
 
 
+int DirectoryEntry::getOriginPriority(int ID) const
+{
+  return m_OriginConnection->getPriority(ID);
+}
+
+
 FilesOrigin &DirectoryEntry::getOriginByName(const std::wstring &name) const
 {
   return m_OriginConnection->getByName(name);
@@ -768,20 +1140,36 @@ int DirectoryEntry::getOrigin(const std::wstring &path, bool &archive)
 std::vector<FileEntry::Ptr> DirectoryEntry::getFiles() const
 {
   std::vector<FileEntry::Ptr> result;
-  for (auto iter = m_Files.begin(); iter != m_Files.end(); ++iter) {
-    result.push_back(m_FileRegister->getFile(iter->second));
-  }
+  result.reserve(m_Files.size());
+  m_Files.forEach([&] (FileEntry::Index index) {
+    result.push_back(m_FileRegister->getFile(index));
+  });
+  // the index is unordered, callers expect files sorted by name
+  std::sort(result.begin(), result.end(), [] (const FileEntry::Ptr &lhs, const FileEntry::Ptr &rhs) -> bool {
+    return *lhs < *rhs;
+  });
   return result;
 }
 
 
 const FileEntry::Ptr DirectoryEntry::searchFile(const std::wstring &path, const DirectoryEntry **directory) const
 {
+  return searchFile(path.c_str(), path.length(), directory);
+}
+
+
+const FileEntry::Ptr DirectoryEntry::searchFile(const wchar_t *path, size_t length, const DirectoryEntry **directory) const
+{
+  if (m_TopLevel && (directory == nullptr) && m_FileRegister->pathIndexEnabled()) {
+    // a single lookup instead of one per path component
+    return m_FileRegister->findByPath(path, length);
+  }
+
   if (directory != nullptr) {
     *directory = nullptr;
   }
 
-  if ((path.length() == 0) || (path == L"*")) {
+  if ((length == 0) || ((length == 1) && (path[0] == L'*'))) {
     // no file name -> the path ended on a (back-)slash
     if (directory != nullptr) {
       *directory = this;
@@ -789,29 +1177,27 @@ const FileEntry::Ptr DirectoryEntry::searchFile(const std::wstring &path, const
     return FileEntry::Ptr();
   }
 
-  size_t len =  path.find_first_of(L"\\/");
+  const wchar_t *separator = std::find_if(path, path + length, [] (wchar_t ch) -> bool {
+    return (ch == L'\\') || (ch == L'/');
+  });
 
-  if (len == std::string::npos) {
+  if (separator == path + length) {
     // no more path components
-    auto iter = m_Files.find(ToLower(path));
-    if (iter != m_Files.end()) {
-      return m_FileRegister->getFile(iter->second);
+    const FileEntry::Index *index = findFileIndex(path, length);
+    if (index != nullptr) {
+      return m_FileRegister->getFile(*index);
     } else if (directory != nullptr) {
-      DirectoryEntry *temp = findSubDirectory(path);
+      DirectoryEntry *temp = findSubDirectory(path, length);
       if (temp != nullptr) {
         *directory = temp;
       }
     }
   } else {
     // file is in in a subdirectory, recurse into the matching subdirectory
-    std::wstring pathComponent = path.substr(0, len);
-    DirectoryEntry *temp = findSubDirectory(pathComponent);
+    size_t len = separator - path;
+    DirectoryEntry *temp = findSubDirectory(path, len);
     if (temp != nullptr) {
-      if (len >= path.size()) {
-        log("unexpected end of path");
-        return FileEntry::Ptr();
-      }
-      return temp->searchFile(path.substr(len + 1), directory);
+      return temp->searchFile(separator + 1, length - len - 1, directory);
     }
   }
   return FileEntry::Ptr();
@@ -820,12 +1206,31 @@ const FileEntry::Ptr DirectoryEntry::searchFile(const std::wstring &path, const
 
 DirectoryEntry *DirectoryEntry::findSubDirectory(const std::wstring &name) const
 {
-  for (DirectoryEntry *entry : m_SubDirectories) {
-    if (CaseInsensitiveEqual(entry->getName(), name)) {
-      return entry;
-    }
-  }
-  return nullptr;
+  return findSubDirectory(name.c_str(), name.length());
+}
+
+
+DirectoryEntry *DirectoryEntry::findSubDirectory(const wchar_t *name, size_t length) const
+{
+  DirectoryEntry * const *entry = m_SubDirectoryIndex.find(name, length, [] (const DirectoryEntry *dir) -> PooledString {
+    return dir->getName();
+  });
+  return entry != nullptr ? *entry : nullptr;
+}
+
+
+const FileEntry::Index *DirectoryEntry::findFileIndex(const wchar_t *name, size_t length) const
+{
+  return m_Files.find(name, length, [this] (FileEntry::Index index) -> PooledString {
+    return fileName(index);
+  });
+}
+
+
+PooledString DirectoryEntry::fileName(FileEntry::Index index) const
+{
+  FileEntry::Ptr file = m_FileRegister->getFile(index);
+  return file.get() != nullptr ? file->getName() : PooledString();
 }
 
 
@@ -837,9 +1242,9 @@ DirectoryEntry *DirectoryEntry::findSubDirectoryRecursive(const std::wstring &pa
 
 const FileEntry::Ptr DirectoryEntry::findFile(const std::wstring &name) const
 {
-  auto iter = m_Files.find(ToLower(name));
-  if (iter != m_Files.end()) {
-    return m_FileRegister->getFile(iter->second);
+  const FileEntry::Index *index = findFileIndex(name.c_str(), name.length());
+  if (index != nullptr) {
+    return m_FileRegister->getFile(*index);
   } else {
     return FileEntry::Ptr();
   }
@@ -847,15 +1252,27 @@ const FileEntry::Ptr DirectoryEntry::findFile(const std::wstring &name) const
 
 DirectoryEntry *DirectoryEntry::getSubDirectory(const std::wstring &name, bool create, int originID)
 {
-  for (DirectoryEntry *entry : m_SubDirectories) {
-    if (CaseInsensitiveEqual(entry->getName(), name)) {
-      return entry;
+  return getSubDirectory(name.c_str(), name.length(), create, originID);
+}
+
+DirectoryEntry *DirectoryEntry::getSubDirectory(const wchar_t *name, size_t length, bool create, int originID)
+{
+  DirectoryEntry *entry = findSubDirectory(name, length);
+  if (entry != nullptr) {
+    if (create && (originID != -1)) {
+      // remember every origin that provides the directory, not just the one that created it
+      entry->m_Origins.insert(originID);
     }
+    return entry;
   }
   if (create) {
-    std::vector<DirectoryEntry*>::iterator iter = m_SubDirectories.insert(m_SubDirectories.end(),
-          new DirectoryEntry(name, this, originID, m_FileRegister, m_OriginConnection));
-    return *iter;
+    entry = new DirectoryEntry(m_StringPool->intern(name, length), this, originID, m_FileRegister, m_OriginConnection,
+                               m_StringPool);
+    // keep the directories sorted at all times so the order doesn't depend on the order origins were added in
+    m_SubDirectories.insert(std::upper_bound(m_SubDirectories.begin(), m_SubDirectories.end(), entry, &DirCompareByName),
+                            entry);
+    m_SubDirectoryIndex.insert(name, length, entry);
+    return entry;
   } else {
     return nullptr;
   }
@@ -864,28 +1281,37 @@ DirectoryEntry *DirectoryEntry::getSubDirectory(const std::wstring &name, bool c
 
 DirectoryEntry *DirectoryEntry::getSubDirectoryRecursive(const std::wstring &path, bool create, int originID)
 {
-  if (path.length() == 0) {
-    // path ended with a backslash?
-    return this;
-  }
-
-  size_t pos = path.find_first_of(L"\\/");
-  if (pos == std::wstring::npos) {
-    return getSubDirectory(path, create);
-  } else {
-    DirectoryEntry *nextChild = getSubDirectory(path.substr(0, pos), create, originID);
-    if (nextChild == nullptr) {
+  DirectoryEntry *current = this;
+  size_t start = 0;
+  // an empty remainder means the path ended with a backslash
+  while (start < path.length()) {
+    size_t pos = path.find_first_of(L"\\/", start);
+    if (pos == std::wstring::npos) {
+      return current->getSubDirectory(path.c_str() + start, path.length() - start, create);
+    }
+    current = current->getSubDirectory(path.c_str() + start, pos - start, create, originID);
+    if (current == nullptr) {
       return nullptr;
-    } else {
-      return nextChild->getSubDirectoryRecursive(path.substr(pos + 1), create, originID);
     }
+    start = pos + 1;
   }
+  return current;
 }
 
 
 
 FileRegister::FileRegister(boost::shared_ptr<OriginConnection> originConnection)
-  : m_OriginConnection(originConnection)
+  : m_Size(0), m_PathIndexEnabled(false), m_OriginConnection(originConnection)
+  , m_Revision(0ULL), m_ConflictGraphRevision(ULLONG_MAX)
+{
+  LEAK_TRACE;
+}
+
+FileRegister::FileRegister(const FileRegister &reference, boost::shared_ptr<OriginConnection> originConnection)
+  : m_Files(reference.m_Files), m_Generations(reference.m_Generations), m_FreeSlots(reference.m_FreeSlots)
+  , m_Size(reference.m_Size), m_PathIndex(reference.m_PathIndex), m_PathIndexEnabled(reference.m_PathIndexEnabled)
+  , m_OriginConnection(originConnection), m_Revision(reference.m_Revision)
+  , m_ConflictGraphRevision(reference.m_ConflictGraphRevision), m_ConflictGraph(reference.m_ConflictGraph)
 {
   LEAK_TRACE;
 }
@@ -899,40 +1325,152 @@ FileRegister::~FileRegister()
 
 FileEntry::Index FileRegister::generateIndex()
 {
-  static std::atomic<FileEntry::Index> sIndex(0);
-  return sIndex++;
+  if (!m_FreeSlots.empty()) {
+    FileEntry::Index slot = m_FreeSlots.back();
+    m_FreeSlots.pop_back();
+    return slot | (static_cast<FileEntry::Index>(m_Generations[slot]) << SLOT_BITS);
+  }
+
+  FileEntry::Index slot = static_cast<FileEntry::Index>(m_Files.size());
+  if (slot >= SLOT_MASK) {
+    throw std::runtime_error("too many files");
+  }
+  m_Files.push_back(FileEntry());
+  m_Generations.push_back(0);
+  return slot;
 }
 
 bool FileRegister::indexValid(FileEntry::Index index) const
 {
-  return m_Files.find(index) != m_Files.end();
+  FileEntry::Index slot = slotOf(index);
+  // released slots have an invalid index so this also checks that the slot is in use
+  return (slot < m_Files.size()) && (m_Files[slot].getIndex() == index);
 }
 
-FileEntry::Ptr FileRegister::createFile(const std::wstring &name, DirectoryEntry *parent)
+FileEntry::Ptr FileRegister::createFile(StringPool::Handle name, DirectoryEntry *parent)
 {
   FileEntry::Index index = generateIndex();
-  m_Files[index] = FileEntry::Ptr(new FileEntry(index, name, parent));
-  return m_Files[index];
+  FileEntry &file = m_Files[slotOf(index)];
+  file = FileEntry(index, name, parent);
+  ++m_Size;
+  touch();
+  if (m_PathIndexEnabled) {
+    m_PathIndex.insertHashed(pathHash(file), index);
+  }
+  return FileEntry::Ptr(&file);
 }
 
 
 FileEntry::Ptr FileRegister::getFile(FileEntry::Index index) const
 {
-  auto iter = m_Files.find(index);
-  if (iter != m_Files.end()) {
-    return iter->second;
+  if (indexValid(index)) {
+    return FileEntry::Ptr(const_cast<FileEntry*>(&m_Files[slotOf(index)]));
   } else {
     return FileEntry::Ptr();
   }
 }
 
+void FileRegister::releaseSlot(FileEntry::Index index)
+{
+  FileEntry::Index slot = slotOf(index);
+  if (m_PathIndexEnabled) {
+    m_PathIndex.eraseHashed(pathHash(m_Files[slot]), index);
+  }
+  // moving the default-constructed entry in frees the alternatives, it has an invalid index
+  m_Files[slot] = FileEntry();
+  ++m_Generations[slot];
+  m_FreeSlots.push_back(slot);
+  --m_Size;
+  touch();
+}
+
+size_t FileRegister::pathHash(const FileEntry &file)
+{
+  // the parent directory already hashed its path, only the name has to be added
+  const DirectoryEntry *parent = file.getParent();
+  unsigned long long state = parent->getPathHash();
+  if (parent->getParent() != nullptr) {
+    state = CaseInsensitiveHashAppend(state, L"\\", 1);
+  }
+  PooledString name = file.getName();
+  return CaseInsensitiveHashFinish(CaseInsensitiveHashAppend(state, name.c_str(), name.length()));
+}
+
+bool FileRegister::pathMatches(const FileEntry &file, const wchar_t *path, size_t length)
+{
+  // compare the components back to front, walking up the tree
+  const wchar_t *end = path + length;
+  PooledString name = file.getName();
+  if ((length < name.length())
+      || !CaseInsensitiveEqual(end - name.length(), name.length(), name.c_str(), name.length())) {
+    return false;
+  }
+  end -= name.length();
+  for (const DirectoryEntry *directory = file.getParent(); directory->getParent() != nullptr;
+       directory = directory->getParent()) {
+    if ((end == path) || ((end[-1] != L'\\') && (end[-1] != L'/'))) {
+      return false;
+    }
+    --end;
+    PooledString directoryName = directory->getName();
+    if ((static_cast<size_t>(end - path) < directoryName.length())
+        || !CaseInsensitiveEqual(end - directoryName.length(), directoryName.length(),
+                                 directoryName.c_str(), directoryName.length())) {
+      return false;
+    }
+    end -= directoryName.length();
+  }
+  return end == path;
+}
+
+void FileRegister::setPathIndexEnabled(bool enabled)
+{
+  if (enabled == m_PathIndexEnabled) {
+    return;
+  }
+  m_PathIndex.clear();
+  m_PathIndexEnabled = enabled;
+  if (enabled) {
+    for (FileEntry::Index slot = 0; slot < m_Files.size(); ++slot) {
+      const FileEntry &file = m_Files[slot];
+      if (slotOf(file.getIndex()) == slot) {
+        m_PathIndex.insertHashed(pathHash(file), file.getIndex());
+      }
+    }
+  }
+}
+
+FileEntry::Ptr FileRegister::findByPath(const wchar_t *path, size_t length) const
+{
+  if (!m_PathIndexEnabled) {
+    return FileEntry::Ptr();
+  }
+  // separators are hashed as backslashes, the way pathHash assembles the path. The text between
+  // forward slashes is hashed in one piece
+  unsigned long long state = CaseInsensitiveHashSeed;
+  size_t start = 0;
+  for (size_t i = 0; i < length; ++i) {
+    if (path[i] == L'/') {
+      state = CaseInsensitiveHashAppend(state, path + start, i - start);
+      state = CaseInsensitiveHashAppend(state, L"\\", 1);
+      start = i + 1;
+    }
+  }
+  state = CaseInsensitiveHashAppend(state, path + start, length - start);
+  const FileEntry::Index *index = m_PathIndex.findHashed(CaseInsensitiveHashFinish(state),
+                                                         [&] (FileEntry::Index candidate) -> bool {
+    return pathMatches(m_Files[slotOf(candidate)], path, length);
+  });
+  return index != nullptr ? getFile(*index) : FileEntry::Ptr();
+}
+
 void FileRegister::unregisterFile(FileEntry::Ptr file)
 {
   bool ignore;
   // unregister from origin
   int originID = file->getOrigin(ignore);
   m_OriginConnection->getByID(originID).removeFile(file->getIndex());
-  const std::vector<std::pair<int, std::pair<std::wstring, int>>> &alternatives = file->getAlternatives();
+  FileEntry::Alternatives alternatives = file->getAlternatives();
   for (auto iter = alternatives.begin(); iter != alternatives.end(); ++iter) {
     m_OriginConnection->getByID(iter->first).removeFile(file->getIndex());
   }
@@ -946,46 +1484,32 @@ void FileRegister::unregisterFile(FileEntry::Ptr file)
 
 bool FileRegister::removeFile(FileEntry::Index index)
 {
-  auto iter = m_Files.find(index);
-  if (iter != m_Files.end()) {
-    unregisterFile(iter->second);
-    m_Files.erase(index);
+  FileEntry::Ptr file = getFile(index);
+  if (file) {
+    unregisterFile(file);
+    releaseSlot(index);
     return true;
   } else {
-    log("invalid file index for remove: %lu", index);
+    log("invalid file index for remove: %llu", index);
     return false;
   }
 }
 
 void FileRegister::removeOrigin(FileEntry::Index index, int originID)
 {
-  auto iter = m_Files.find(index);
-  if (iter != m_Files.end()) {
-    if (iter->second->removeOrigin(originID)) {
-      unregisterFile(iter->second);
-      m_Files.erase(iter);
+  FileEntry::Ptr file = getFile(index);
+  if (file) {
+    if (file->removeOrigin(originID)) {
+      unregisterFile(file);
+      releaseSlot(index);
     }
   } else {
-    log("invalid file index for remove (for origin): %lu", index);
+    log("invalid file index for remove (for origin): %llu", index);
   }
 }
 
 void FileRegister::removeOriginMulti(std::set<FileEntry::Index> indices, int originID, time_t notAfter)
 {
-  std::vector<FileEntry::Ptr> removedFiles;
-  for (auto iter = indices.begin(); iter != indices.end();) {
-    auto pos = m_Files.find(*iter);
-    if (pos != m_Files.end()
-        && (pos->second->lastAccessed() < notAfter)
-        && pos->second->removeOrigin(originID)) {
-      removedFiles.push_back(pos->second);
-      m_Files.erase(pos);
-      ++iter;
-    } else {
-      indices.erase(iter++);
-    }
-  }
-
   // optimization: this is only called when disabling an origin and in this case we don't have
   // to remove the file from the origin
 
@@ -995,21 +1519,74 @@ void FileRegister::removeOriginMulti(std::set<FileEntry::Index> indices, int ori
   // the latter should be faster when there are many files in few directories. since this is called
   // only when disabling an origin that is probably frequently the case
   std::set<DirectoryEntry*> parents;
-  for (const FileEntry::Ptr &file : removedFiles) {
-    if (file->getParent() != nullptr) {
-      parents.insert(file->getParent());
+  for (auto iter = indices.begin(); iter != indices.end();) {
+    FileEntry::Ptr file = getFile(*iter);
+    if (file
+        && (file->lastAccessed() < notAfter)
+        && file->removeOrigin(originID)) {
+      if (file->getParent() != nullptr) {
+        parents.insert(file->getParent());
+      }
+      releaseSlot(*iter);
+      ++iter;
+    } else {
+      indices.erase(iter++);
     }
   }
+
   for (DirectoryEntry *parent : parents) {
     parent->removeFiles(indices);
   }
 }
 
-void FileRegister::sortOrigins()
+void FileRegister::sortOrigins(const std::vector<int> &originIDs)
+{
+  // re-sorting changes which origin wins but not which origins share files. A graph that is up to
+  // date is updated with the re-sorted files instead of being rebuilt from all files
+  bool updateGraph = m_ConflictGraphRevision == m_Revision;
+  if (updateGraph) {
+    m_ConflictGraph.reopen();
+  } else {
+    touch();
+  }
+
+  // files provided by several of the origins are sorted only once
+  std::set<FileEntry::Index> indices;
+  for (int originID : originIDs) {
+    const std::set<FileEntry::Index> &files = m_OriginConnection->getByID(originID).getFileIndices();
+    indices.insert(files.begin(), files.end());
+  }
+  for (FileEntry::Index index : indices) {
+    FileEntry::Ptr file = getFile(index);
+    if (file.get() != nullptr) {
+      if (updateGraph) {
+        m_ConflictGraph.removeFile(*file);
+      }
+      file->sortOrigins();
+      if (updateGraph) {
+        m_ConflictGraph.addFile(*file);
+      }
+    }
+  }
+
+  if (updateGraph) {
+    m_ConflictGraph.end();
+  }
+}
+
+const ConflictGraph &FileRegister::conflictGraph() const
 {
-  for (auto iter = m_Files.begin(); iter != m_Files.end(); ++iter) {
-    iter->second->sortOrigins();
+  if (m_ConflictGraphRevision != m_Revision) {
+    m_ConflictGraph.begin(m_OriginConnection->exists(L"data") ? m_OriginConnection->getByName(L"data").getID() : -1);
+    for (FileEntry::Index slot = 0; slot < m_Files.size(); ++slot) {
+      if (slotOf(m_Files[slot].getIndex()) == slot) {
+        m_ConflictGraph.addFile(m_Files[slot]);
+      }
+    }
+    m_ConflictGraph.end();
+    m_ConflictGraphRevision = m_Revision;
   }
+  return m_ConflictGraph;
 }
 
 } // namespace MOShared
@@ -25,6 +25,8 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #include <set>
 #include <vector>
 #include <map>
+#include <deque>
+#include <algorithm>
 #include <cassert>
 #define WIN32_MEAN_AND_LEAN
 #include <Windows.h>
@@ -34,6 +36,11 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #include <boost/weak_ptr.hpp>
 #endif
 #include "util.h"
+#include "nameindex.h"
+#include "stringpool.h"
+#include "casefold.h"
+#include "smallvector.h"
+#include "conflictgraph.h"
 
 
 namespace MOShared {
@@ -44,19 +51,109 @@ class OriginConnection;
 class FileRegister;
 
 
+/**
+ * @brief set of origin ids, stored as a sorted vector. Most directories are provided by a few
+ *        origins, a vector is smaller than a node based set and faster to search at that size
+ */
+class OriginSet
+{
+
+public:
+
+  typedef SmallVector<int, 2>::const_iterator const_iterator;
+
+public:
+
+  // returns true if the origin wasn't in the set yet
+  bool insert(int origin)
+  {
+    SmallVector<int, 2>::iterator iter = std::lower_bound(m_Origins.begin(), m_Origins.end(), origin);
+    if ((iter != m_Origins.end()) && (*iter == origin)) {
+      return false;
+    }
+    m_Origins.insert(iter, origin);
+    return true;
+  }
+
+  void erase(int origin)
+  {
+    SmallVector<int, 2>::iterator iter = std::lower_bound(m_Origins.begin(), m_Origins.end(), origin);
+    if ((iter != m_Origins.end()) && (*iter == origin)) {
+      m_Origins.erase(iter);
+    }
+  }
+
+  bool contains(int origin) const
+  {
+    return std::binary_search(m_Origins.begin(), m_Origins.end(), origin);
+  }
+
+  bool empty() const { return m_Origins.empty(); }
+  size_t size() const { return m_Origins.size(); }
+
+  const_iterator begin() const { return m_Origins.begin(); }
+  const_iterator end() const { return m_Origins.end(); }
+
+private:
+
+  SmallVector<int, 2> m_Origins;
+
+};
+
+
 class FileEntry {
 
+  friend class DirectoryEntry;
+
 public:
 
-  typedef unsigned int Index;
+  // slot in the file register and generation of the slot, see FileRegister
+  typedef unsigned long long Index;
+
+  // archive a file is provided by: interned archive name (StringPool::EMPTY for loose files) and
+  // the load order of the archive
+  typedef std::pair<StringPool::Handle, int> ArchiveInfo;
+  // an origin providing the file and the archive in that origin. The modification time of the file
+  // in that origin is kept as well so it is known without accessing the disk when the origin
+  // becomes the primary one
+  struct AlternativeInfo : std::pair<int, ArchiveInfo> {
+    AlternativeInfo(int origin, const ArchiveInfo &archive, FILETIME fileTime)
+      : std::pair<int, ArchiveInfo>(origin, archive), fileTime(fileTime) {}
+    FILETIME fileTime;
+  };
+  // most files are provided by at most two origins, those don't need an allocation. Larger inline
+  // storage costs more for the files without alternatives than it saves
+  typedef SmallVector<AlternativeInfo, 1> AlternativeList;
+  typedef Span<AlternativeInfo> Alternatives;
 
-  typedef boost::shared_ptr<FileEntry> Ptr;
+  /**
+   * non-owning reference to a file. Files are owned by the FileRegister, a Ptr becomes invalid
+   * once the file is removed from the register so it should not be held on to
+   */
+  class Ptr {
+  public:
+    Ptr() : m_File(nullptr) {}
+    explicit Ptr(FileEntry *file) : m_File(file) {}
+    FileEntry *get() const { return m_File; }
+    FileEntry *operator->() const { return m_File; }
+    FileEntry &operator*() const { return *m_File; }
+    explicit operator bool() const { return m_File != nullptr; }
+  private:
+    FileEntry *m_File;
+  };
 
 public:
 
   FileEntry();
 
-  FileEntry(Index index, const std::wstring &name, DirectoryEntry *parent);
+  FileEntry(Index index, StringPool::Handle name, DirectoryEntry *parent);
+
+  // the destructor suppresses the implicit moves. Moving matters to the register, assigning a
+  // moved entry frees the alternatives while a copy keeps their buffer
+  FileEntry(const FileEntry &reference) = default;
+  FileEntry(FileEntry &&reference) = default;
+  FileEntry &operator=(const FileEntry &reference) = default;
+  FileEntry &operator=(FileEntry &&reference) = default;
 
   ~FileEntry();
 
@@ -64,51 +161,71 @@ public:
 
   time_t lastAccessed() const { return m_LastAccessed; }
 
-  void addOrigin(int origin, FILETIME fileTime, const std::wstring &archive, int order);
+  void addOrigin(int origin, FILETIME fileTime, StringPool::Handle archive, int order);
   // remove the specified origin from the list of origins that contain this file. if no origin is left,
   // the file is effectively deleted and true is returned. otherwise, false is returned
   bool removeOrigin(int origin);
+  // restore the order of the origins after their priorities changed. Adding and removing origins
+  // keeps them sorted
   void sortOrigins();
 
-  // gets the list of alternative origins (origins with lower priority than the primary one).
-  // if sortOrigins has been called, it is sorted by priority (ascending)
-  const std::vector<std::pair<int, std::pair<std::wstring, int>>> &getAlternatives() const { return m_Alternatives; }
+  // gets the list of alternative origins (origins with lower priority than the primary one),
+  // sorted by priority (ascending).
+  // The list is invalidated when origins of this file change
+  Alternatives getAlternatives() const { return m_Alternatives.span(); }
 
-  const std::wstring &getName() const { return m_Name; }
+  PooledString getName() const;
+  StringPool::Handle getNameHandle() const { return m_Name; }
   int getOrigin() const { return m_Origin; }
-  int getOrigin(bool &archive) const { archive = (m_Archive.first.length() != 0); return m_Origin; }
-  const std::pair<std::wstring, int> &getArchive() const { return m_Archive; }
-  bool isFromArchive(std::wstring archiveName = L"");
+  int getOrigin(bool &archive) const { archive = (m_Archive.first != StringPool::EMPTY); return m_Origin; }
+  const ArchiveInfo &getArchive() const { return m_Archive; }
+  // name of the archive the primary origin provides this file from, empty for loose files
+  PooledString getArchiveName() const;
+  bool isFromArchive(std::wstring archiveName = L"") const;
+  bool isFromArchive(StringPool::Handle archive) const;
   std::wstring getFullPath() const;
   std::wstring getRelativePath() const;
+  // same as above but writing into a buffer provided by the caller so it can be reused
+  void getFullPath(std::wstring &result) const;
+  void getRelativePath(std::wstring &result) const;
   DirectoryEntry *getParent() { return m_Parent; }
+  const DirectoryEntry *getParent() const { return m_Parent; }
 
   void setFileTime(FILETIME fileTime) const { m_FileTime = fileTime; }
   FILETIME getFileTime() const { return m_FileTime; }
 
 private:
 
-  bool recurseParents(std::wstring &path, const DirectoryEntry *parent) const;
+  // same as addOrigin but doesn't record the origin in the parent directories. Used when the caller
+  // does that once for many files
+  void insertOrigin(int origin, FILETIME fileTime, StringPool::Handle archive, int order);
+
+  // the order of origins, the primary origin is the greatest
+  bool originLess(const AlternativeInfo &LHS, const AlternativeInfo &RHS) const;
 
   void determineTime();
 
 private:
 
   Index m_Index;
-  std::wstring m_Name;
+  StringPool::Handle m_Name;
   int m_Origin = -1;
-  std::pair<std::wstring, int> m_Archive;
-  std::vector<std::pair<int, std::pair<std::wstring, int>>> m_Alternatives;
+  ArchiveInfo m_Archive;
+  AlternativeList m_Alternatives;
   DirectoryEntry *m_Parent;
   mutable FILETIME m_FileTime;
 
   time_t m_LastAccessed;
 
   friend bool operator<(const FileEntry &lhs, const FileEntry &rhs) {
-    return _wcsicmp(lhs.m_Name.c_str(), rhs.m_Name.c_str()) < 0;
+    PooledString lhsName = lhs.getName();
+    PooledString rhsName = rhs.getName();
+    return FoldedCompare(lhsName.c_str(), lhsName.length(), rhsName.c_str(), rhsName.length()) < 0;
   }
   friend bool operator==(const FileEntry &lhs, const FileEntry &rhs) {
-    return _wcsicmp(lhs.m_Name.c_str(), rhs.m_Name.c_str()) == 0;
+    PooledString lhsName = lhs.getName();
+    PooledString rhsName = rhs.getName();
+    return CaseInsensitiveEqual(lhsName.c_str(), lhsName.length(), rhsName.c_str(), rhsName.length());
   }
 };
 
@@ -135,6 +252,15 @@ public:
   const std::wstring &getPath() const { return m_Path; }
 
   std::vector<FileEntry::Ptr> getFiles() const;
+  const std::set<FileEntry::Index> &getFileIndices() const { return m_Files; }
+
+  /**
+   * @brief call a function for each file of this origin without building a list
+   * @param func called with a const FileEntry&, returns false to stop the iteration
+   * @return false if the iteration was stopped
+   */
+  template <typename Func>
+  bool forEachFile(Func func) const;
 
   void enable(bool enabled, time_t notAfter = LONG_MAX);
   bool isDisabled() const { return m_Disabled; }
@@ -144,6 +270,19 @@ public:
 
   bool containsArchive(std::wstring archiveName);
 
+  /**
+   * @brief record what kind of content the origin provides. The value isn't interpreted here,
+   *        the application determines it from the listing the origin is built from
+   * @param contents bitmask of content types
+   */
+  void setContents(unsigned int contents) { m_Contents = contents; m_ContentsKnown = true; }
+
+  /**
+   * @param contents receives the bitmask passed to setContents
+   * @return false if no contents were recorded for this origin
+   */
+  bool getContents(unsigned int &contents) const { contents = m_Contents; return m_ContentsKnown; }
+
 private:
 
   FilesOrigin(int ID, const std::wstring &name, const std::wstring &path, int priority,
@@ -160,60 +299,204 @@ private:
   std::wstring m_Name;
   std::wstring m_Path;
   int m_Priority;
+  unsigned int m_Contents;
+  bool m_ContentsKnown;
   boost::weak_ptr<FileRegister> m_FileRegister;
   boost::weak_ptr<OriginConnection> m_OriginConnection;
 
 };
 
 
+/**
+ * @brief listing of the files an origin (a mod directory or a single archive) provides.
+ *
+ * The listing is gathered without touching the directory tree so that scanning the disk can happen
+ * concurrently for multiple origins. DirectoryEntry replays it into the tree exactly as if the
+ * files had been added directly, which keeps the resulting tree independent of how it was scanned.
+ */
+class OriginScan
+{
+
+public:
+
+  enum EntryType {
+    ENTRY_DIRECTORY,
+    ENTRY_FILE,
+    ENTRY_END_DIRECTORY
+  };
+
+  struct Entry {
+    EntryType type;
+    std::wstring name;
+    FILETIME fileTime;
+  };
+
+public:
+
+  OriginScan();
+
+  /**
+   * @brief list all files below the specified directory
+   */
+  void scanDirectory(const std::wstring &directory);
+
+  /**
+   * @brief list all files in the specified bsa. throws if the archive can't be read
+   */
+  void scanArchive(const std::wstring &fileName);
+
+  /**
+   * @brief restore a listing that was generated earlier, i.e. by a previous session
+   */
+  void restore(bool archive, FILETIME lastWriteTime, unsigned long long size, std::vector<Entry> &&entries);
+
+  /**
+   * @brief start listing a directory the same way scanDirectory does
+   * @param pattern search pattern, the path of the directory followed by "\\*"
+   * @param findData receives the first entry
+   * @return the search handle, INVALID_HANDLE_VALUE if the directory can't be listed
+   */
+  static HANDLE findFirstFile(const wchar_t *pattern, WIN32_FIND_DATAW &findData);
+
+  bool isArchive() const { return m_Archive; }
+
+  // modification time of the scanned directory or archive, taken before the scan.
+  // Directory entries carry the modification time of that directory
+  FILETIME lastWriteTime() const { return m_LastWriteTime; }
+
+  // size of the archive, 0 for directories
+  unsigned long long size() const { return m_Size; }
+
+  const std::vector<Entry> &entries() const { return m_Entries; }
+
+private:
+
+  void scanDirectory(wchar_t *buffer, int bufferOffset);
+  void scanFolder(BSA::Folder::Ptr archiveFolder);
+
+private:
+
+  std::vector<Entry> m_Entries;
+  bool m_Archive;
+  FILETIME m_LastWriteTime;
+  unsigned long long m_Size;
+
+};
+
+
 class FileRegister
 {
 
 public:
 
   FileRegister(boost::shared_ptr<OriginConnection> originConnection);
+  // copy of all files, using a different connection. The files keep their parent directories,
+  // see DirectoryEntry::clone
+  FileRegister(const FileRegister &reference, boost::shared_ptr<OriginConnection> originConnection);
   ~FileRegister();
 
   bool indexValid(FileEntry::Index index) const;
 
-  FileEntry::Ptr createFile(const std::wstring &name, DirectoryEntry *parent);
+  FileEntry::Ptr createFile(StringPool::Handle name, DirectoryEntry *parent);
   FileEntry::Ptr getFile(FileEntry::Index index) const;
 
-  size_t size() const { return m_Files.size(); }
+  size_t size() const { return m_Size; }
 
   bool removeFile(FileEntry::Index index);
   void removeOrigin(FileEntry::Index index, int originID);
   void removeOriginMulti(std::set<FileEntry::Index> indices, int originID, time_t notAfter);
 
-  void sortOrigins();
+  // re-sort the files provided by the specified origins
+  void sortOrigins(const std::vector<int> &originIDs);
+
+  /**
+   * @brief maintain an index from the relative path of each file to the file so files can be found
+   *        with a single lookup. Enabling the index adds the files that are already registered
+   */
+  void setPathIndexEnabled(bool enabled);
+  bool pathIndexEnabled() const { return m_PathIndexEnabled; }
+
+  /**
+   * @brief find a file by its path relative to the data directory using the path index
+   * @param path the path. Both slashes and backslashes are accepted as separators
+   * @param length length of the path
+   * @return the file or an empty pointer if there is no such file or the index is disabled
+   */
+  FileEntry::Ptr findByPath(const wchar_t *path, size_t length) const;
+
+  /**
+   * @brief conflicts between the origins of all files. The graph is rebuilt in a single pass over
+   *        all files if files or their origins changed since it was last built. sortOrigins
+   *        updates a graph that is up to date with the re-sorted files instead
+   */
+  const ConflictGraph &conflictGraph() const;
+
+  // count a change to the files or their origins
+  void touch() { ++m_Revision; }
 
 private:
 
+  // a file index consists of the slot in m_Files and a generation counter for that slot.
+  // The generation changes whenever a slot is reused so stale indices can be detected. With 32 bits
+  // a slot has to be reused four billion times before a stale index could match again
+  static const unsigned int SLOT_BITS = 32;
+  static const FileEntry::Index SLOT_MASK = (1ULL << SLOT_BITS) - 1;
+
+  static FileEntry::Index slotOf(FileEntry::Index index) { return index & SLOT_MASK; }
+
   FileEntry::Index generateIndex();
 
   void unregisterFile(FileEntry::Ptr file);
 
+  void releaseSlot(FileEntry::Index index);
+
+  static size_t pathHash(const FileEntry &file);
+  static bool pathMatches(const FileEntry &file, const wchar_t *path, size_t length);
+
 private:
 
-  std::map<FileEntry::Index, FileEntry::Ptr> m_Files;
+  // files are stored in place and never move, the deque allocates them in blocks
+  std::deque<FileEntry> m_Files;
+  std::vector<unsigned int> m_Generations;
+  std::vector<FileEntry::Index> m_FreeSlots;
+  size_t m_Size;
+
+  // relative path of a file to its index, only maintained if enabled
+  NameIndex<FileEntry::Index> m_PathIndex;
+  bool m_PathIndexEnabled;
 
   boost::shared_ptr<OriginConnection> m_OriginConnection;
 
+  unsigned long long m_Revision;
+  mutable unsigned long long m_ConflictGraphRevision;
+  mutable ConflictGraph m_ConflictGraph;
+
 };
 
 
 class DirectoryEntry
 {
+
+  friend class FileEntry;
+
 public:
 
   DirectoryEntry(const std::wstring &name, DirectoryEntry *parent, int originID);
 
-  DirectoryEntry(const std::wstring &name, DirectoryEntry *parent, int originID,
+  DirectoryEntry(StringPool::Handle name, DirectoryEntry *parent, int originID,
                  boost::shared_ptr<FileRegister> fileRegister,
-                 boost::shared_ptr<OriginConnection> originConnection);
+                 boost::shared_ptr<OriginConnection> originConnection,
+                 boost::shared_ptr<StringPool> stringPool);
 
   ~DirectoryEntry();
 
+  /**
+   * @brief copy the whole structure, only valid on the top-level entry. The copy shares nothing
+   *        with this structure so it can be changed while this one is still being read
+   * @return the top-level entry of the copy, owned by the caller
+   */
+  DirectoryEntry *clone() const;
+
   void clear();
   bool isPopulated() const { return m_Populated; }
 
@@ -221,29 +504,140 @@ public:
 
   const DirectoryEntry *getParent() const { return m_Parent; }
 
+  // state of the case insensitive hash of the path relative to the top-level entry
+  unsigned long long getPathHash() const { return m_PathHash; }
+
+  // path relative to the top-level entry with a leading backslash, empty for the top-level entry
+  PooledString getRelativePath() const { return m_StringPool->get(m_RelativePath); }
+
   // add files to this directory (and subdirectories) from the specified origin. That origin may exist or not
   void addFromOrigin(const std::wstring &originName, const std::wstring &directory, int priority);
   void addFromBSA(const std::wstring &originName, std::wstring &directory, const std::wstring &fileName, int priority, int order);
 
+  // same as above but using a listing that was generated in advance (possibly in a different thread)
+  void addFromOrigin(const std::wstring &originName, const std::wstring &directory, int priority,
+                     const OriginScan &scan);
+  void addFromBSA(const std::wstring &originName, std::wstring &directory, const std::wstring &fileName,
+                  int priority, int order, const OriginScan &scan);
+
   void propagateOrigin(int origin);
 
-  const std::wstring &getName() const;
+  PooledString getName() const;
 
   boost::shared_ptr<FileRegister> getFileRegister() { return m_FileRegister; }
 
+  // names of all files, directories and archives in the tree. Owned by the top-level entry
+  StringPool &getStringPool() const { return *m_StringPool; }
+
   bool originExists(const std::wstring &name) const;
   FilesOrigin &getOriginByID(int ID) const;
+  // same as getOriginByID(ID).getPriority() but cheaper
+  int getOriginPriority(int ID) const;
   FilesOrigin &getOriginByName(const std::wstring &name) const;
 
+  // origin of the loose file with the lowest name in this directory, otherwise the first one found in
+  // the subdirectories in the order of their names. Without such files the origin with the lowest id
+  // that has the directory
   int anyOrigin() const;
 
   //int getOrigin(const std::wstring &path, bool &archive);
 
+  // all files in this directory, sorted by name. Builds a list, use forEachFile if the order
+  // doesn't matter
   std::vector<FileEntry::Ptr> getFiles() const;
 
-  void getSubDirectories(std::vector<DirectoryEntry*>::const_iterator &begin
-                         , std::vector<DirectoryEntry*>::const_iterator &end) const {
-    begin = m_SubDirectories.begin(); end = m_SubDirectories.end();
+  /**
+   * @brief call a function for each file in this directory, in no particular order, without
+   *        building a list
+   * @param func called with a const FileEntry&, returns false to stop the iteration
+   * @return false if the iteration was stopped
+   */
+  template <typename Func>
+  bool forEachFile(Func func) const
+  {
+    return m_Files.forEachWhile([&] (FileEntry::Index index) -> bool {
+      FileEntry::Ptr file = m_FileRegister->getFile(index);
+      return (file.get() == nullptr) || func(static_cast<const FileEntry&>(*file));
+    });
+  }
+
+  /**
+   * @brief call a function for each file in this directory, sorted by name. For callers whose
+   *        result depends on the order, it's the same order getFiles produces
+   * @param func called with a const FileEntry&, returns false to stop the iteration
+   * @return false if the iteration was stopped
+   */
+  template <typename Func>
+  bool forEachFileSorted(Func func) const
+  {
+    std::vector<const FileEntry*> files;
+    files.reserve(m_Files.size());
+    forEachFile([&] (const FileEntry &file) -> bool {
+      files.push_back(&file);
+      return true;
+    });
+    std::sort(files.begin(), files.end(), [] (const FileEntry *lhs, const FileEntry *rhs) -> bool {
+      return *lhs < *rhs;
+    });
+    for (const FileEntry *file : files) {
+      if (!func(*file)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // subdirectories, sorted by name. Invalid once directories are added or removed
+  Span<DirectoryEntry*> getSubDirectories() const {
+    return Span<DirectoryEntry*>(m_SubDirectories.data(), m_SubDirectories.size());
+  }
+
+  /**
+   * @brief call a function for each subdirectory, sorted by name
+   * @param func called with a const DirectoryEntry&, returns false to stop the iteration
+   * @return false if the iteration was stopped
+   */
+  template <typename Func>
+  bool forEachSubDirectory(Func func) const
+  {
+    for (const DirectoryEntry *directory : m_SubDirectories) {
+      if (!func(*directory)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief call a function for this directory and every directory below it, depth first
+   * @param func called with a const DirectoryEntry&, returns false to stop the walk
+   * @return false if the walk was stopped
+   */
+  template <typename Func>
+  bool walk(Func &&func) const
+  {
+    if (!func(*this)) {
+      return false;
+    }
+    for (const DirectoryEntry *directory : m_SubDirectories) {
+      if (!directory->walk(func)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief call a function for each file in this directory and all directories below it
+   * @param func called with a const FileEntry&, returns false to stop the iteration
+   * @return false if the iteration was stopped
+   */
+  template <typename Func>
+  bool forEachFileRecursive(Func func) const
+  {
+    return walk([&] (const DirectoryEntry &directory) -> bool {
+      return directory.forEachFile(func);
+    });
   }
 
   DirectoryEntry *findSubDirectory(const std::wstring &name) const;
@@ -260,6 +654,7 @@ public:
   /** search through this directory and all subdirectories for a file by the specified name (relative path).
       if directory is not nullptr, the referenced variable will be set to the path containing the file */
   const FileEntry::Ptr searchFile(const std::wstring &path, const DirectoryEntry **directory) const;
+  const FileEntry::Ptr searchFile(const wchar_t *path, size_t length, const DirectoryEntry **directory) const;
 
   void insertFile(const std::wstring &filePath, FilesOrigin &origin, FILETIME fileTime);
 
@@ -274,26 +669,50 @@ public:
    */
   void removeDir(const std::wstring &path);
 
+  /**
+   * @brief forget about an origin once its files were removed (see FilesOrigin::enable). Directories
+   *        that no other origin provides are removed from the tree
+   * @param originID id of the origin
+   */
+  void pruneOrigin(int originID);
+
   bool remove(const std::wstring &fileName, int *origin) {
-    auto iter = m_Files.find(ToLower(fileName));
-    if (iter != m_Files.end()) {
+    const FileEntry::Index *index = findFileIndex(fileName.c_str(), fileName.length());
+    if (index != nullptr) {
+      FileEntry::Index fileIndex = *index;
       if (origin != nullptr) {
-        FileEntry::Ptr entry = m_FileRegister->getFile(iter->second);
+        FileEntry::Ptr entry = m_FileRegister->getFile(fileIndex);
         if (entry.get() != nullptr) {
           bool ignore;
           *origin = entry->getOrigin(ignore);
         }
       }
-      return m_FileRegister->removeFile(iter->second);
+      return m_FileRegister->removeFile(fileIndex);
     } else {
       return false;
     }
   }
 
+  /**
+   * @brief test if an origin contributes to this directory
+   * @param originID id of the origin
+   * @return true if the origin provides files in this directory or below it, or if it has this
+   *         directory itself, even an empty one. Every origin that has the directory is recorded,
+   *         not only the one that created it, so the result doesn't depend on the order origins
+   *         were added in and pruneOrigin() only removes directories that no origin provides
+   */
   bool hasContentsFromOrigin(int originID) const;
 
   FilesOrigin &createOrigin(const std::wstring &originName, const std::wstring &directory, int priority);
 
+  /**
+   * @brief change the priorities of origins without rebuilding the tree. Only files of origins
+   *        that moved relative to other origins are re-sorted
+   * @param priorities new priority by origin id. Origins that aren't listed keep their priority
+   * @return ids of the origins that moved
+   */
+  std::vector<int> setOriginPriorities(const std::map<int, int> &priorities);
+
   void removeFiles(const std::set<FileEntry::Index> &indices);
 
 private:
@@ -301,25 +720,40 @@ private:
   DirectoryEntry(const DirectoryEntry &reference);
   DirectoryEntry &operator=(const DirectoryEntry &reference);
 
-  void insert(const std::wstring &fileName, FilesOrigin &origin, FILETIME fileTime, const std::wstring &archive, int order) {
-    std::wstring fileNameLower = ToLower(fileName);
-    auto iter = m_Files.find(fileNameLower);
+  // copy of reference and all directories below it, see clone
+  DirectoryEntry(const DirectoryEntry &reference, DirectoryEntry *parent,
+                 boost::shared_ptr<FileRegister> fileRegister,
+                 boost::shared_ptr<OriginConnection> originConnection,
+                 boost::shared_ptr<StringPool> stringPool);
+
+  void insert(const std::wstring &fileName, FilesOrigin &origin, FILETIME fileTime, StringPool::Handle archive, int order) {
+    const FileEntry::Index *index = findFileIndex(fileName.c_str(), fileName.length());
     FileEntry::Ptr file;
-    if (iter != m_Files.end()) {
-      file = m_FileRegister->getFile(iter->second);
+    if (index != nullptr) {
+      file = m_FileRegister->getFile(*index);
     } else {
-      file = m_FileRegister->createFile(fileName, this);
-      // TODO this has been observed to cause a crash, no clue why
-      m_Files[fileNameLower] = file->getIndex();
+      file = m_FileRegister->createFile(m_StringPool->intern(fileName), this);
+      m_Files.insert(fileName.c_str(), fileName.length(), file->getIndex());
     }
-    file->addOrigin(origin.getID(), fileTime, archive, order);
+    file->insertOrigin(origin.getID(), fileTime, archive, order);
     origin.addFile(file->getIndex());
   }
 
-  void addFiles(FilesOrigin &origin, wchar_t *buffer, int bufferOffset);
-  void addFiles(FilesOrigin &origin, BSA::Folder::Ptr archiveFolder, FILETIME &fileTime, const std::wstring &archiveName, int order);
+  const FileEntry::Index *findFileIndex(const wchar_t *name, size_t length) const;
+  PooledString fileName(FileEntry::Index index) const;
+
+  DirectoryEntry *findSubDirectory(const wchar_t *name, size_t length) const;
 
+  void addFiles(FilesOrigin &origin, const OriginScan &scan, StringPool::Handle archiveName, int order);
+
+  // true unless files of an archive by that name are in the tree already and the archive wasn't
+  // modified in the last few seconds
+  bool archiveNeedsUpdate(const std::wstring &fileName, FILETIME archiveTime);
+
+  // with create set, originID is recorded in the directory whether it exists already or not, see
+  // hasContentsFromOrigin
   DirectoryEntry *getSubDirectory(const std::wstring &name, bool create, int originID = -1);
+  DirectoryEntry *getSubDirectory(const wchar_t *name, size_t length, bool create, int originID = -1);
 
   DirectoryEntry *getSubDirectoryRecursive(const std::wstring &path, bool create, int originID = -1);
 
@@ -329,13 +763,18 @@ private:
 
   boost::shared_ptr<FileRegister> m_FileRegister;
   boost::shared_ptr<OriginConnection> m_OriginConnection;
+  boost::shared_ptr<StringPool> m_StringPool;
 
-  std::wstring m_Name;
-  std::map<std::wstring, FileEntry::Index> m_Files;
+  StringPool::Handle m_Name;
+  NameIndex<FileEntry::Index> m_Files;
+  // the vector determines the order in which subdirectories are listed, the index is used for lookups
   std::vector<DirectoryEntry*> m_SubDirectories;
+  NameIndex<DirectoryEntry*> m_SubDirectoryIndex;
 
   DirectoryEntry *m_Parent;
-  std::set<int> m_Origins;
+  unsigned long long m_PathHash;
+  StringPool::Handle m_RelativePath;
+  OriginSet m_Origins;
 
   bool m_Populated;
 
@@ -344,6 +783,20 @@ private:
 };
 
 
+template <typename Func>
+bool FilesOrigin::forEachFile(Func func) const
+{
+  boost::shared_ptr<FileRegister> fileRegister = m_FileRegister.lock();
+  for (FileEntry::Index index : m_Files) {
+    FileEntry::Ptr file = fileRegister->getFile(index);
+    if ((file.get() != nullptr) && !func(static_cast<const FileEntry&>(*file))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
 } // namespace MOShared
 
 #endif // DIRECTORYENTRY_H
@@ -0,0 +1,272 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+
+#include <vector>
+#include <string>
+#include "util.h"
+
+
+namespace MOShared {
+
+
+/**
+ * @brief hash table (open addressing, linear probing) from case-insensitive names to values
+ *
+ * The index doesn't store the names, only their case-folded hash. To resolve hash collisions
+ * the caller passes a functor that returns the name of a stored value, so names aren't duplicated.
+ * Lookups don't allocate.
+ */
+template <typename T>
+class NameIndex
+{
+
+public:
+
+  NameIndex()
+    : m_Size(0)
+  {
+  }
+
+  size_t size() const { return m_Size; }
+  bool empty() const { return m_Size == 0; }
+
+  void clear()
+  {
+    m_Slots.clear();
+    m_Size = 0;
+  }
+
+  /**
+   * @brief find the value stored for a name
+   * @param name the name to look up. doesn't have to be zero-terminated
+   * @param length length of the name
+   * @param nameOf functor returning the name (const std::wstring&) for a stored value
+   * @return pointer to the value or nullptr if the name isn't in the index
+   */
+  template <typename NameOf>
+  const T *find(const wchar_t *name, size_t length, NameOf nameOf) const
+  {
+    size_t pos = findSlot(CaseInsensitiveHash(name, length), [&] (const T &value) -> bool {
+      const auto &candidate = nameOf(value);
+      return CaseInsensitiveEqual(candidate.c_str(), candidate.length(), name, length);
+    });
+    return pos != NOT_FOUND ? &m_Slots[pos].value : nullptr;
+  }
+
+  /**
+   * @brief find a value with a custom comparison, i.e. for case-sensitive lookups.
+   *        The name only determines where to look
+   * @param predicate functor called with stored values that have a matching hash
+   * @return pointer to the first value the predicate accepts or nullptr
+   */
+  template <typename Predicate>
+  const T *findIf(const wchar_t *name, size_t length, Predicate predicate) const
+  {
+    size_t pos = findSlot(CaseInsensitiveHash(name, length), predicate);
+    return pos != NOT_FOUND ? &m_Slots[pos].value : nullptr;
+  }
+
+  /**
+   * @brief find a value by a hash the caller calculated, i.e. for keys that aren't stored in one piece
+   * @param hash CaseInsensitiveHash of the key
+   * @param predicate functor called with stored values that have a matching hash
+   * @return pointer to the first value the predicate accepts or nullptr
+   */
+  template <typename Predicate>
+  const T *findHashed(size_t hash, Predicate predicate) const
+  {
+    size_t pos = findSlot(hash, predicate);
+    return pos != NOT_FOUND ? &m_Slots[pos].value : nullptr;
+  }
+
+  /**
+   * @brief add a value to the index. Duplicates aren't detected, callers look up the name first
+   */
+  void insert(const wchar_t *name, size_t length, const T &value)
+  {
+    insertHashed(CaseInsensitiveHash(name, length), value);
+  }
+
+  void insertHashed(size_t hash, const T &value)
+  {
+    if ((m_Size + 1) * 4 > m_Slots.size() * 3) {
+      grow();
+    }
+    insertSlot(hash, value);
+    ++m_Size;
+  }
+
+  /**
+   * @brief remove the specified value, stored under the specified name
+   * @return true if the value was found
+   */
+  bool erase(const wchar_t *name, size_t length, const T &value)
+  {
+    return eraseHashed(CaseInsensitiveHash(name, length), value);
+  }
+
+  bool eraseHashed(size_t hash, const T &value)
+  {
+    size_t pos = findSlot(hash, [&] (const T &candidate) -> bool { return candidate == value; });
+    if (pos == NOT_FOUND) {
+      return false;
+    }
+    eraseSlot(pos);
+    return true;
+  }
+
+  /**
+   * @brief remove all values for which the predicate returns true
+   * @return number of values removed
+   */
+  template <typename Predicate>
+  size_t eraseIf(Predicate predicate)
+  {
+    std::vector<Slot> slots;
+    slots.swap(m_Slots);
+    size_t oldSize = m_Size;
+    m_Size = 0;
+    m_Slots.resize(slots.size());
+    for (const Slot &slot : slots) {
+      if (slot.used && !predicate(slot.value)) {
+        insertSlot(slot.hash, slot.value);
+        ++m_Size;
+      }
+    }
+    return oldSize - m_Size;
+  }
+
+  /**
+   * @brief call the functor for each value in the index, in no particular order
+   */
+  template <typename Func>
+  void forEach(Func func) const
+  {
+    for (const Slot &slot : m_Slots) {
+      if (slot.used) {
+        func(slot.value);
+      }
+    }
+  }
+
+  /**
+   * @brief call the functor for each value in the index, in no particular order, until it
+   *        returns false
+   * @return false if the iteration was stopped
+   */
+  template <typename Func>
+  bool forEachWhile(Func func) const
+  {
+    for (const Slot &slot : m_Slots) {
+      if (slot.used && !func(slot.value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+
+  static const size_t NOT_FOUND = static_cast<size_t>(-1);
+  static const size_t MIN_SLOTS = 8;
+
+  // only the low 32 bits of the hash are kept, they select the slot and filter candidates just as
+  // well and keep a slot with an 8 byte value at 16 bytes
+  struct Slot {
+    Slot() : hash(0), used(false), value() {}
+    unsigned int hash;
+    bool used;
+    T value;
+  };
+
+private:
+
+  template <typename Predicate>
+  size_t findSlot(size_t fullHash, Predicate predicate) const
+  {
+    if (m_Size == 0) {
+      return NOT_FOUND;
+    }
+    unsigned int hash = static_cast<unsigned int>(fullHash);
+    size_t mask = m_Slots.size() - 1;
+    for (size_t pos = hash & mask; m_Slots[pos].used; pos = (pos + 1) & mask) {
+      if ((m_Slots[pos].hash == hash) && predicate(m_Slots[pos].value)) {
+        return pos;
+      }
+    }
+    return NOT_FOUND;
+  }
+
+  void insertSlot(size_t fullHash, const T &value)
+  {
+    unsigned int hash = static_cast<unsigned int>(fullHash);
+    size_t mask = m_Slots.size() - 1;
+    size_t pos = hash & mask;
+    while (m_Slots[pos].used) {
+      pos = (pos + 1) & mask;
+    }
+    m_Slots[pos].hash = hash;
+    m_Slots[pos].value = value;
+    m_Slots[pos].used = true;
+  }
+
+  void eraseSlot(size_t pos)
+  {
+    // backward shift deletion: move following entries of the probe sequence into the gap so
+    // lookups never have to skip over tombstones
+    size_t mask = m_Slots.size() - 1;
+    size_t hole = pos;
+    for (size_t next = (hole + 1) & mask; m_Slots[next].used; next = (next + 1) & mask) {
+      size_t home = m_Slots[next].hash & mask;
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+        m_Slots[hole] = m_Slots[next];
+        hole = next;
+      }
+    }
+    m_Slots[hole] = Slot();
+    --m_Size;
+  }
+
+  void grow()
+  {
+    std::vector<Slot> slots;
+    slots.swap(m_Slots);
+    m_Slots.resize(slots.empty() ? MIN_SLOTS : slots.size() * 2);
+    for (const Slot &slot : slots) {
+      if (slot.used) {
+        insertSlot(slot.hash, slot.value);
+      }
+    }
+  }
+
+private:
+
+  std::vector<Slot> m_Slots;
+  size_t m_Size;
+
+};
+
+
+} // namespace MOShared
+
+#endif // NAMEINDEX_H
@@ -21,6 +21,9 @@ SOURCES += \
     windows_error.cpp \
     error_report.cpp \
     directoryentry.cpp \
+    stringpool.cpp \
+    casefold.cpp \
+    conflictgraph.cpp \
     util.cpp \
     appconfig.cpp \
     leaktrace.cpp \
@@ -31,6 +34,11 @@ HEADERS += \
     windows_error.h \
     error_report.h \
     directoryentry.h \
+    nameindex.h \
+    stringpool.h \
+    casefold.h \
+    conflictgraph.h \
+    smallvector.h \
     util.h \
     appconfig.h \
     appconfig.inc \
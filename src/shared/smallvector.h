@@ -0,0 +1,286 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+
+#include <cstddef>
+#include <climits>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+
+
+namespace MOShared {
+
+
+/**
+ * @brief read-only view of a contiguous range of elements. Doesn't own the elements, it becomes
+ *        invalid when the container it was taken from is modified
+ */
+template <typename T>
+class Span
+{
+
+public:
+
+  typedef T value_type;
+  typedef const T *const_iterator;
+  typedef const T *iterator;
+
+public:
+
+  Span() : m_Begin(nullptr), m_Size(0) {}
+  Span(const T *begin, size_t size) : m_Begin(begin), m_Size(size) {}
+
+  const T *begin() const { return m_Begin; }
+  const T *end() const { return m_Begin + m_Size; }
+
+  size_t size() const { return m_Size; }
+  bool empty() const { return m_Size == 0; }
+
+  const T &operator[](size_t index) const { return m_Begin[index]; }
+  const T &front() const { return m_Begin[0]; }
+  const T &back() const { return m_Begin[m_Size - 1]; }
+
+private:
+
+  const T *m_Begin;
+  size_t m_Size;
+
+};
+
+
+/**
+ * @brief vector that stores up to N elements in place and only allocates when it grows beyond that.
+ *
+ * Meant for the many small lists in the directory structure that usually hold one or two entries.
+ * Elements must be trivially destructible, they are moved around by assignment.
+ */
+template <typename T, unsigned short N>
+class SmallVector
+{
+
+  static_assert(std::is_trivially_destructible<T>::value, "SmallVector only supports trivially destructible types");
+  static_assert(N > 0, "SmallVector needs inline capacity");
+
+public:
+
+  typedef T value_type;
+  typedef T *iterator;
+  typedef const T *const_iterator;
+
+public:
+
+  SmallVector()
+    : m_Size(0), m_Capacity(N)
+  {
+  }
+
+  SmallVector(const SmallVector &reference)
+    : m_Size(0), m_Capacity(N)
+  {
+    assign(reference);
+  }
+
+  SmallVector(SmallVector &&reference)
+    : m_Size(0), m_Capacity(N)
+  {
+    takeFrom(reference);
+  }
+
+  ~SmallVector()
+  {
+    release();
+  }
+
+  SmallVector &operator=(const SmallVector &reference)
+  {
+    if (this != &reference) {
+      m_Size = 0;
+      assign(reference);
+    }
+    return *this;
+  }
+
+  SmallVector &operator=(SmallVector &&reference)
+  {
+    if (this != &reference) {
+      clear();
+      takeFrom(reference);
+    }
+    return *this;
+  }
+
+  Span<T> span() const { return Span<T>(data(), m_Size); }
+
+  size_t size() const { return m_Size; }
+  bool empty() const { return m_Size == 0; }
+  bool isInline() const { return m_Capacity == N; }
+
+  T *data() { return isInline() ? inlineData() : m_Storage.heap; }
+  const T *data() const { return isInline() ? inlineData() : m_Storage.heap; }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + m_Size; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + m_Size; }
+
+  T &operator[](size_t index) { return data()[index]; }
+  const T &operator[](size_t index) const { return data()[index]; }
+  T &back() { return data()[m_Size - 1]; }
+  const T &back() const { return data()[m_Size - 1]; }
+
+  void push_back(const T &value)
+  {
+    if (m_Size == m_Capacity) {
+      // the value may live in this vector, copy before growing
+      T temp(value);
+      grow();
+      new (data() + m_Size) T(temp);
+    } else {
+      new (data() + m_Size) T(value);
+    }
+    ++m_Size;
+  }
+
+  void pop_back()
+  {
+    --m_Size;
+  }
+
+  iterator insert(iterator pos, const T &value)
+  {
+    size_t offset = pos - begin();
+    T temp(value);
+    if (m_Size == m_Capacity) {
+      grow();
+    }
+    T *elements = data();
+    if (offset == m_Size) {
+      new (elements + m_Size) T(temp);
+    } else {
+      new (elements + m_Size) T(elements[m_Size - 1]);
+      std::copy_backward(elements + offset, elements + m_Size - 1, elements + m_Size);
+      elements[offset] = temp;
+    }
+    ++m_Size;
+    return elements + offset;
+  }
+
+  iterator erase(iterator first, iterator last)
+  {
+    iterator newEnd = std::copy(last, end(), first);
+    m_Size = static_cast<unsigned short>(newEnd - begin());
+    return first;
+  }
+
+  iterator erase(iterator pos)
+  {
+    return erase(pos, pos + 1);
+  }
+
+  /**
+   * @brief remove all elements and free memory allocated for them
+   */
+  void clear()
+  {
+    release();
+    m_Size = 0;
+    m_Capacity = N;
+  }
+
+private:
+
+  T *inlineData() { return reinterpret_cast<T*>(&m_Storage.local); }
+  const T *inlineData() const { return reinterpret_cast<const T*>(&m_Storage.local); }
+
+  void release()
+  {
+    if (!isInline()) {
+      ::operator delete(m_Storage.heap);
+    }
+  }
+
+  void reserve(size_t capacity)
+  {
+    if (capacity <= m_Capacity) {
+      return;
+    }
+    if (capacity > USHRT_MAX) {
+      throw std::length_error("SmallVector too long");
+    }
+    T *elements = static_cast<T*>(::operator new(capacity * sizeof(T)));
+    T *current = data();
+    for (unsigned short i = 0; i < m_Size; ++i) {
+      new (elements + i) T(current[i]);
+    }
+    release();
+    m_Storage.heap = elements;
+    m_Capacity = static_cast<unsigned short>(capacity);
+  }
+
+  void grow()
+  {
+    reserve(static_cast<size_t>(m_Capacity) * 2);
+  }
+
+  void assign(const SmallVector &reference)
+  {
+    reserve(reference.m_Size);
+    T *elements = data();
+    for (unsigned short i = 0; i < reference.m_Size; ++i) {
+      new (elements + i) T(reference.data()[i]);
+    }
+    m_Size = reference.m_Size;
+  }
+
+  void takeFrom(SmallVector &reference)
+  {
+    if (!reference.isInline()) {
+      // steal the allocation
+      release();
+      m_Storage.heap = reference.m_Storage.heap;
+      m_Capacity = reference.m_Capacity;
+      m_Size = reference.m_Size;
+      reference.m_Capacity = N;
+      reference.m_Size = 0;
+    } else {
+      assign(reference);
+      reference.m_Size = 0;
+    }
+  }
+
+private:
+
+  unsigned short m_Size;
+  unsigned short m_Capacity;
+  union Storage {
+    typename std::aligned_storage<sizeof(T) * N, std::alignment_of<T>::value>::type local;
+    T *heap;
+  } m_Storage;
+
+};
+
+
+} // namespace MOShared
+
+#endif // SMALLVECTOR_H
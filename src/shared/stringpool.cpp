@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stringpool.h"
+#include "util.h"
+#include <cwchar>
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace MOShared {
+
+
+StringPool::StringPool()
+  : m_BlockUsed(1)
+{
+  // the empty string, its terminating zero is the first character of the first block
+  m_Blocks.push_back(std::unique_ptr<wchar_t[]>(new wchar_t[BLOCK_SIZE]));
+  m_Blocks.back()[0] = L'\0';
+  m_Entries.push_back({ 0, 0 });
+}
+
+
+StringPool::StringPool(const StringPool &reference)
+  : m_BlockUsed(reference.m_BlockUsed), m_Entries(reference.m_Entries), m_Index(reference.m_Index)
+{
+  // names don't fill the blocks completely, only the characters in use are copied
+  std::vector<unsigned int> used(reference.m_Blocks.size(), 0);
+  for (const Entry &entry : m_Entries) {
+    unsigned int end = entry.offset % BLOCK_SIZE + entry.length + 1;
+    used[entry.offset / BLOCK_SIZE] = std::max(used[entry.offset / BLOCK_SIZE], end);
+  }
+  m_Blocks.reserve(reference.m_Blocks.size());
+  for (size_t i = 0; i < reference.m_Blocks.size(); ++i) {
+    m_Blocks.push_back(std::unique_ptr<wchar_t[]>(new wchar_t[BLOCK_SIZE]));
+    wmemcpy(m_Blocks.back().get(), reference.m_Blocks[i].get(), used[i]);
+  }
+}
+
+
+StringPool::Handle StringPool::find(const wchar_t *name, size_t length) const
+{
+  if (length == 0) {
+    return EMPTY;
+  }
+  const Handle *handle = m_Index.findIf(name, length, [&] (Handle candidate) -> bool {
+    PooledString candidateName = get(candidate);
+    return (candidateName.length() == length)
+        && (wmemcmp(candidateName.c_str(), name, length) == 0);
+  });
+  return handle != nullptr ? *handle : INVALID;
+}
+
+
+StringPool::Handle StringPool::intern(const wchar_t *name, size_t length)
+{
+  Handle handle = find(name, length);
+  if (handle != INVALID) {
+    return handle;
+  }
+
+  if (length >= BLOCK_SIZE) {
+    throw std::runtime_error("name too long");
+  }
+  if (m_Entries.size() >= INVALID) {
+    throw std::runtime_error("too many names");
+  }
+  if (m_Blocks.empty() || (m_BlockUsed + length + 1 > BLOCK_SIZE)) {
+    if (m_Blocks.size() >= UINT_MAX / BLOCK_SIZE) {
+      throw std::runtime_error("too many names");
+    }
+    m_Blocks.push_back(std::unique_ptr<wchar_t[]>(new wchar_t[BLOCK_SIZE]));
+    m_BlockUsed = 0;
+  }
+
+  wchar_t *characters = m_Blocks.back().get() + m_BlockUsed;
+  wmemcpy(characters, name, length);
+  characters[length] = L'\0';
+
+  Entry entry;
+  entry.offset = static_cast<unsigned int>(m_Blocks.size() - 1) * BLOCK_SIZE + m_BlockUsed;
+  entry.length = static_cast<unsigned int>(length);
+  m_BlockUsed += static_cast<unsigned int>(length) + 1;
+
+  handle = static_cast<Handle>(m_Entries.size());
+  m_Entries.push_back(entry);
+  m_Index.insert(name, length, handle);
+  return handle;
+}
+
+
+} // namespace MOShared
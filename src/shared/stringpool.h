@@ -0,0 +1,143 @@
+/*
+Copyright (C) 2012 Sebastian Herbord. All rights reserved.
+
+This file is part of Mod Organizer.
+
+Mod Organizer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Mod Organizer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <climits>
+#include "nameindex.h"
+
+
+namespace MOShared {
+
+
+/**
+ * @brief a name stored in a StringPool. The characters are zero-terminated and stay valid as
+ *        long as the pool does
+ */
+class PooledString
+{
+
+public:
+
+  PooledString() : m_Data(L""), m_Length(0) {}
+  PooledString(const wchar_t *data, size_t length) : m_Data(data), m_Length(length) {}
+
+  const wchar_t *c_str() const { return m_Data; }
+  const wchar_t *data() const { return m_Data; }
+  size_t length() const { return m_Length; }
+  size_t size() const { return m_Length; }
+  bool empty() const { return m_Length == 0; }
+  wchar_t operator[](size_t pos) const { return m_Data[pos]; }
+
+  std::wstring str() const { return std::wstring(m_Data, m_Length); }
+  operator std::wstring() const { return str(); }
+
+private:
+
+  const wchar_t *m_Data;
+  size_t m_Length;
+
+};
+
+
+/**
+ * @brief stores each distinct name once and hands out 32-bit handles to it
+ *
+ * The directory tree contains the same file, directory and archive names many times over
+ * (every mod ships a "textures" directory, thousands of files come from the same bsa). The pool
+ * keeps one copy of each name. The characters of all names are stored back to back in large blocks,
+ * a name is its offset and length in them. Names aren't folded, comparisons that ignore case fold
+ * as they go (see casefold.h). Entries are never removed, the pool lives as long as the directory
+ * structure it belongs to.
+ * Interning is not thread-safe, reading is as long as nobody interns concurrently.
+ */
+class StringPool
+{
+
+public:
+
+  typedef unsigned int Handle;
+
+  // handle of the empty string, always valid
+  static const Handle EMPTY = 0;
+  static const Handle INVALID = UINT_MAX;
+
+public:
+
+  StringPool();
+
+  // copies all names, handles of the copy refer to the same names
+  StringPool(const StringPool &reference);
+
+  /**
+   * @brief get the handle for a name, adding it to the pool if necessary. Names are case sensitive
+   */
+  Handle intern(const wchar_t *name, size_t length);
+  Handle intern(const std::wstring &name) { return intern(name.c_str(), name.length()); }
+
+  /**
+   * @brief look up the handle of a name without adding it
+   * @return the handle or INVALID if the name isn't in the pool
+   */
+  Handle find(const wchar_t *name, size_t length) const;
+  Handle find(const std::wstring &name) const { return find(name.c_str(), name.length()); }
+
+  PooledString get(Handle handle) const {
+    const Entry &entry = m_Entries[handle];
+    return PooledString(m_Blocks[entry.offset / BLOCK_SIZE].get() + entry.offset % BLOCK_SIZE, entry.length);
+  }
+
+  size_t size() const { return m_Entries.size(); }
+
+private:
+
+  StringPool &operator=(const StringPool &reference);
+
+private:
+
+  // characters per block. Names, including the terminating zero, don't span blocks. Paths in the
+  // structure are well below this
+  static const unsigned int BLOCK_SIZE = 1U << 16;
+
+  // position of the first character in all blocks and length
+  struct Entry {
+    unsigned int offset;
+    unsigned int length;
+  };
+
+private:
+
+  // blocks are never moved or freed so the characters of a name stay where they are
+  std::vector<std::unique_ptr<wchar_t[]>> m_Blocks;
+  // characters used in the last block
+  unsigned int m_BlockUsed;
+  std::vector<Entry> m_Entries;
+  NameIndex<Handle> m_Index;
+
+};
+
+
+} // namespace MOShared
+
+#endif // STRINGPOOL_H
@@ -18,6 +18,7 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "util.h"
+#include "casefold.h"
 #include "windows_error.h"
 #include "error_report.h"
 
@@ -97,10 +98,6 @@ std::wstring ToWString(const std::string &source, bool utf8)
 }
 
 static std::locale loc("");
-static auto locToLowerW = [] (wchar_t in) -> wchar_t {
-  return std::tolower(in, loc);
-};
-
 static auto locToLower = [] (char in) -> char {
   return std::tolower(in, loc);
 };
@@ -120,30 +117,54 @@ std::string ToLower(const std::string &text)
 
 std::wstring &ToLower(std::wstring &text)
 {
-  std::transform(text.begin(), text.end(), text.begin(), locToLowerW);
+  if (!text.empty()) {
+    FoldCase(&text[0], text.length());
+  }
   return text;
 }
 
 std::wstring ToLower(const std::wstring &text)
 {
   std::wstring result(text);
-  std::transform(result.begin(), result.end(), result.begin(), locToLowerW);
+  ToLower(result);
   return result;
 }
 
 bool CaseInsenstiveComparePred(wchar_t lhs, wchar_t rhs)
 {
-  return std::tolower(lhs, loc) == std::tolower(rhs, loc);
+  return FoldCase(lhs) == FoldCase(rhs);
 }
 
 bool CaseInsensitiveEqual(const std::wstring &lhs, const std::wstring &rhs)
 {
   return (lhs.length() == rhs.length())
-      && std::equal(lhs.begin(), lhs.end(),
-                    rhs.begin(),
-                    [] (wchar_t lhs, wchar_t rhs) -> bool {
-                      return std::tolower(lhs, loc) == std::tolower(rhs, loc);
-                    });
+      && FoldedEqual(lhs.c_str(), rhs.c_str(), lhs.length());
+}
+
+bool CaseInsensitiveEqual(const wchar_t *lhs, size_t lhsLength, const wchar_t *rhs, size_t rhsLength)
+{
+  return (lhsLength == rhsLength) && FoldedEqual(lhs, rhs, lhsLength);
+}
+
+bool CaseInsensitiveLess(const wchar_t *lhs, size_t lhsLength, const wchar_t *rhs, size_t rhsLength)
+{
+  return FoldedCompare(lhs, lhsLength, rhs, rhsLength) < 0;
+}
+
+size_t CaseInsensitiveHash(const wchar_t *text, size_t length)
+{
+  return CaseInsensitiveHashFinish(CaseInsensitiveHashAppend(CaseInsensitiveHashSeed, text, length));
+}
+
+unsigned long long CaseInsensitiveHashAppend(unsigned long long state, const wchar_t *text, size_t length)
+{
+  // FNV-1a over the lower case characters
+  return FoldedHashAppend(state, text, length);
+}
+
+size_t CaseInsensitiveHashFinish(unsigned long long state)
+{
+  return static_cast<size_t>(state ^ (state >> 32));
 }
 
 VS_FIXEDFILEINFO GetFileVersion(const std::wstring &fileName)
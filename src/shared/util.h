@@ -43,6 +43,19 @@ std::wstring &ToLower(std::wstring &text);
 std::wstring ToLower(const std::wstring &text);
 
 bool CaseInsensitiveEqual(const std::wstring &lhs, const std::wstring &rhs);
+bool CaseInsensitiveEqual(const wchar_t *lhs, size_t lhsLength, const wchar_t *rhs, size_t rhsLength);
+
+/// orders strings the same way as comparing their lower case versions would, without allocating
+bool CaseInsensitiveLess(const wchar_t *lhs, size_t lhsLength, const wchar_t *rhs, size_t rhsLength);
+
+/// hash that is identical for strings that compare equal with CaseInsensitiveEqual
+size_t CaseInsensitiveHash(const wchar_t *text, size_t length);
+
+/// state for calculating CaseInsensitiveHash of a string in pieces. Starting with
+/// CaseInsensitiveHashSeed, appending all pieces and finishing gives the hash of the whole string
+static const unsigned long long CaseInsensitiveHashSeed = 14695981039346656037ULL;
+unsigned long long CaseInsensitiveHashAppend(unsigned long long state, const wchar_t *text, size_t length);
+size_t CaseInsensitiveHashFinish(unsigned long long state);
 
 VS_FIXEDFILEINFO GetFileVersion(const std::wstring &fileName);
 